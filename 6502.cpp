@@ -7,29 +7,137 @@
 using namespace std::chrono;
 
 #include "ops.h"
+#include "reference.h"
+#include "profile.h"
+#include "gdb.h"
+#include "budget.h"
+#include "pool.h"
+#include "serve.h"
+#include "cache.h"
+#include "scan.h"
+#include "lanes.h"
+#include "fuzz.h"
+#include "multi.h"
+#include "aot.h"
+#include "io.h"
+#include "via.h"
+#include "fb.h"
+#include "disk.h"
+#include "hyper.h"
+#include "trace.h"
+#include "idle.h"
+#include "fuse.h"
+#include "conformance.h"
 
 #define VERSIONSTRING "v0.3.3-dev"
 
-// Function to get ascii representation of memory for printout
-string ascii(byte2 memaddr, int size) {
-    string out = "";
+// Run instructions from pc until something stops the loop, leaving at on the last one run, returns its move (--test runs through here too)
+byte run(byte2& at, int frequency) {
+    // Amount of bytes to move (0xFF means break)
+    byte mvbytes = 0;
+
+    steady_clock::time_point begin = steady_clock::now();
+    long i = 0;
+
+    while (mvbytes != BRK_MOVE && !broken) {
+        if (debugging && debug_break(at) && !gdb_break()) {
+            stop_reason = STOP_BREAKPOINT;
+            break;
+        }
+
+        at = pc;
+        byte opcode = memory[pc];
+        unsigned long long before = cycles;
+
+        // Print position and instruction before running (which might change program counter)
+        if (ins_print) {
+            char text[DISASM_MAX];
+
+            disasm(pc, text);
+            printf("%04X %02X %-14s - ", pc, opcode, text);
+        }
+
+        byte operands[2] = {memory[pc + 1], memory[pc + 2]};
+        mvbytes = instruction(opcode, operands);
+        cycles += op_cycles[opcode];
+
+        // Go straight on into a following branch or common instruction (see fuse.h)
+        if (fusing && fuse_first[opcode]) fuse_step(at, opcode, mvbytes);
+
+        if (ins_print) printf("A: %02X X: %02X Y: %02X S: %02X SR/NV-BDIZC: [%d%d%d%d%d%d%d%d]\n", a, x, y, sp, sr.n, sr.v, sr._, sr.b, sr.d, sr.i, sr.z, sr.c);
+
+        // Increment program counter
+        pc += mvbytes;
+
+        unsigned long long skipped = 0;
+
+        if (pc <= at) {
+            // Branch or jump to itself that nothing can interrupt, or a WAI nothing will wake (unless a debugger changes something)
+            if (pc == at && stuck(opcode) && !gdb_connected) {
+                stop_reason = STOP_HANG;
+                break;
+            }
+
+            // Skip the passes of a loop that can't change anything before the next event (see idle.h)
+            if (idling) skipped = idle_loop(at, frequency);
+        }
+
+        // Device events and IRQs (see io.h)
+        if (cycles >= next_event && mvbytes != BRK_MOVE) io_event();
+
+        if (lockstep && mvbytes != BRK_MOVE && !lockstep_step(at)) {
+            lockstep = false;
+            stop_reason = STOP_DIVERGENCE;
+            break;
+        }
+
+        if (profiling) profile_step(at, opcode, cycles - before);
+        if (tracing) trace_step(at, opcode);
 
-    for (int val = 0; val < size; val++) {
-        char memval = memory[memaddr + val];
-        if (memval >= 0x20 && memval <= 0x7e) { // From spacebar to tilde
-            out += memval;
-        } else {
-            out += '.'; // Period for other characters
+        if (budgeting && ++instructions >= budget_next && !budget_check()) break;
+
+        // Stop for an attached debugger (interrupted or single stepping)
+        if (gdb_attn.load(std::memory_order_relaxed)) gdb_interrupt();
+
+        #ifdef HOST_STATS
+        if (stats_interval) stats_line();
+        #endif
+        
+        // Delay to match input frequency if given (might want to clean up)
+        if (frequency) {
+            i += 1 + skipped;
+
+            if (frequency < 100 || i < 100 || skipped || !(i % (frequency / 100))) {
+                long long delay = (1000000000ll * i)/frequency - duration_cast<nanoseconds>(steady_clock::now() - begin).count();
+
+                #ifdef HOST_STATS
+                if (delay > 0) {
+                    steady_clock::time_point slept = steady_clock::now();
+
+                    std::this_thread::sleep_for(nanoseconds(delay));
+
+                    stat_sleeps++;
+                    stat_sleep_ns += delay;
+                    stat_slept_ns += duration_cast<nanoseconds>(steady_clock::now() - slept).count();
+                } else {
+                    stat_behind++;
+                }
+                #else
+                std::this_thread::sleep_for(nanoseconds(delay));
+                #endif
+            }
         }
     }
 
-    return out;
+    return mvbytes;
 }
 
 // TODO: Possible refactoring
 int main(int argc, char** argv) {
     // Handle options and file
     char* file = NULL;
+    string serve_path;
+    bool gdb_listening = false;
 
     int memstart = 0x0000;
     int rows = 8;
@@ -45,7 +153,7 @@ int main(int argc, char** argv) {
         if (argv[i][0] == '-') {
             if (argv[i] == string("-?")) {
                 printf(
-                    "6502 %s HELP\n"
+                    "6502 %s (" CPUSTRING ") HELP\n"
                     "  Usage:\n"
                     "    %s [-options | --flags] [-o code] [-f] {file}\n"
                     "\n"
@@ -63,13 +171,69 @@ int main(int argc, char** argv) {
                     "    -pa {x}   Set value of printing address. Prefix with \"0x\" for hex input (default 0xFFF9).\n"
                     "    -mf {x}   Set maximum operation frequency for emulator. Suffix with \"k\" or \"m\" for thousands or millions (default none).\n"
                     "    -o {x}    Directly input assembled machine code as string and ignore rest of input.\n"
-                    "    -f {x}    Explicitly select the input file to be executed and ignore rest of input (default last arg).\n",
+                    "    -f {x}    Explicitly select the input file to be executed and ignore rest of input (default last arg).\n"
+                    "    --profile Enable profiling of executed code, printing a report once stopped (default false).\n"
+                    "    -po {x}   Set the file to write collapsed profile stacks to (default profile.folded).\n"
+                    "    -hs {x}   Print host statistics every x seconds, needs a build with HOST_STATS defined (default none).\n"
+                    "    -bp {x}   Stop before executing at an address, optionally only on a condition (\"0x1020\" or \"0x1020:x==3\").\n"
+                    "    -bc {x}   Stop once a register condition is met (\"a>=0x80\", registers a, x, y, sp, sr, pc).\n"
+                    "    -wr {x}   Stop after a read of an address or range (\"0x0200\" or \"0x0200-0x02FF\").\n"
+                    "    -ww {x}   Stop after a write to an address or range.\n"
+                    "    -gd {x}   Accept GDB remote connections on a localhost TCP port or Unix socket path while running (default none).\n"
+                    "    -lk {x}   Run a reference core in lockstep, comparing state every x instructions and stopping on divergence, not with devices (default none).\n"
+                    "    --test    Run the instruction conformance programs and stop, reporting failures and speed.\n"
+                    "    --max-instructions {x}  Stop after x instructions. Suffix with \"k\" or \"m\" for thousands or millions (default none).\n"
+                    "    --max-cycles {x}        Stop once x cycles have run, suffixes as above (default none).\n"
+                    "    --timeout {x}           Stop after x seconds of wall clock time (default none).\n"
+                    "    --reason  Print why execution stopped to stderr (\"reason=max-cycles code=4 ...\"), the exit code is set either way.\n"
+                    "    --serve {x}  Keep running and take jobs on a Unix socket path (limits above apply to every job, see serve.h).\n"
+                    "    -sw {x}   Set the number of worker processes for --serve (default one per hardware thread).\n"
+                    "    -cd {x}   Cache results of runs in a directory, replaying repeated runs of the same image and options (default none).\n"
+                    "    -cs {x}   Set the size the cache is kept under. Suffix with \"k\" or \"m\" for thousands or millions of bytes (default 64m).\n"
+                    "    --nc      Bypass the cache for this run, neither reading nor storing a result (default false).\n"
+                    "    --dump {x}  Write all of memory to a binary file once stopped (such as a golden image for --diff).\n"
+                    "    --diff {x}  Compare memory with a binary image (loaded from 0x0000) once stopped, printing the ranges that differ.\n"
+                    "    --find {x}  Search memory for hex bytes once stopped, printing every address they are found at (\"A9 00\" or \"A900\").\n"
+                    "    -ln {x}   Run x instances of the program side by side on the lane engine, printing how each one stopped.\n"
+                    "    -lv {x}   Set an address (or register a, x or y) to the instance number in each lane, can be repeated.\n"
+                    "    --fuzz {x}  Fuzz the program, writing each input at address x with its length in x and y (works with afl-fuzz).\n"
+                    "    -fi {x}   Set the seed file or directory, new inputs are added to a directory (under afl-fuzz, the input file such as @@).\n"
+                    "    -fl {x}   Set the maximum length of an input (default 256).\n"
+                    "    -fn {x}   Set the amount of inputs to try without afl-fuzz. Suffix with \"k\" or \"m\" for thousands or millions (default 1m).\n"
+                    "    -cp {x}   Add a CPU running the image in file x (loaded at the same address), can be repeated.\n"
+                    "    -sh {x}   Share a region between the CPUs, covering whole 4 KiB pages (\"0x8000-0x8FFF\"), can be repeated.\n"
+                    "    -qt {x}   Set the quantum of cycles the CPUs run between meeting. Suffix with \"k\" or \"m\" (default 10k).\n"
+                    "    --det     Run the quanta of the CPUs one at a time in CPU order, so every run is the same (default false).\n"
+                    "    --ni      Disable fast-forwarding of idle loops, running every pass of them (default false).\n"
+                    "    --nf      Disable fusing common instruction pairs into one trip through the instruction loop (default false).\n"
+                    "    --recompile {x}  Write the code found from the reset vector to file x as C++, to build in with -DRECOMPILED='\"x\"'.\n"
+                    "    --disasm  Print a listing of the loaded program instead of running it (default false).\n"
+                    "    -vi {x}   Attach a 6522 VIA at address x, or repeated through a range (\"0x9000\" or \"0x9000-0x90FF\").\n"
+                    "    -fb {x}   Attach a framebuffer at address x, saving a frame whenever it is drawn on (such as 0x200).\n"
+                    "    -fs {x}   Set the framebuffer size in pixels (default \"32x32\").\n"
+                    "    -fm {x}   Set the framebuffer mode, \"palette\" (a byte per pixel, 16 colors) or \"bitmap\" (8 pixels per byte) (default palette).\n"
+                    "    -fr {x}   Set the cycles between frames. Suffix with \"k\" or \"m\" (default 20k).\n"
+                    "    -fo {x}   Set the directory frames are saved to as PPM files, or a file ending in \".raw\" (default \"frames\").\n"
+                    "    -bd {x}   Attach a block device on disk image file x, moving 512 byte sectors by DMA.\n"
+                    "    -ba {x}   Set the address of the block device's registers (default 0xFFE0).\n"
+                    "    -bl {x}   Set the cycles a block device transfer takes per sector. Suffix with \"k\" or \"m\" (default 512).\n"
+                    "    -hc {x}   Attach a hypercall port at address x, for copies, fills, formatted printing and file access done by the host.\n"
+                    "    -tr {x}   Write a compressed trace of every instruction run to file x.\n"
+                    "    -tc {x}   Set the instructions in each independently compressed chunk of a trace. Suffix with \"k\" or \"m\" (default 64k).\n"
+                    "    -ti {x}   Print the instructions of trace file x instead of running.\n"
+                    "    -tn {x}   Set the instruction of the trace to start printing from. Suffix with \"k\" or \"m\" (default 0).\n"
+                    "    -tl {x}   Set the number of instructions of the trace to print, 0 for all (default 20).\n"
+                    "    -tp {x}   Only print the instructions of the trace at an address or range (\"0x0600\" or \"0x0600-0x06FF\").\n",
                     VERSIONSTRING,
                     EXESTRING
                     );
                 return -1;
             }
 
+            else if (argv[i] == string("--test")) {
+                return conformance();
+            }
+
             else if (argv[i] == string("--m")) {
                 mem_print = false;
             }
@@ -90,6 +254,611 @@ int main(int argc, char** argv) {
                 brk_stop = true;
             }
 
+            else if (argv[i] == string("--profile")) {
+                profiling = true;
+            }
+
+            else if (argv[i] == string("-po")) {
+                if (argc == i + 1) {
+                    printf("-po requires an argument.\n");
+                    return 1;
+                }
+
+                profile_file = argv[i + 1];
+
+                i++;
+            }
+
+            else if (argv[i] == string("-hs")) {
+                if (argc == i + 1) {
+                    printf("-hs requires an argument.\n");
+                    return 1;
+                }
+
+                #ifdef HOST_STATS
+                std::stringstream val(argv[i + 1]);
+
+                val >> stats_interval;
+                #else
+                printf("Ignoring -hs, host statistics were not enabled at build time (define HOST_STATS).\n");
+                #endif
+
+                i++;
+            }
+
+            else if (argv[i] == string("-bp") || argv[i] == string("-bc") || argv[i] == string("-wr") || argv[i] == string("-ww")) {
+                if (argc == i + 1) {
+                    printf("%s requires an argument.\n", argv[i]);
+                    return 1;
+                }
+
+                bool valid;
+
+                if (argv[i] == string("-bp")) valid = add_breakpoint(argv[i + 1]);
+                else if (argv[i] == string("-bc")) valid = add_condition(argv[i + 1]);
+                else valid = add_watchpoint(argv[i + 1], argv[i] == string("-ww"));
+
+                if (!valid) {
+                    printf("Invalid argument for %s: \"%s\"\n", argv[i], argv[i + 1]);
+                    return 1;
+                }
+
+                i++;
+            }
+
+            else if (argv[i] == string("-gd")) {
+                if (argc == i + 1) {
+                    printf("-gd requires an argument.\n");
+                    return 1;
+                }
+
+                if (!gdb_listen(argv[i + 1])) {
+                    printf("Unable to listen for GDB on \"%s\".\n", argv[i + 1]);
+                    return 1;
+                }
+
+                gdb_listening = true;
+
+                i++;
+            }
+
+            else if (argv[i] == string("-lk")) {
+                if (argc == i + 1) {
+                    printf("-lk requires an argument.\n");
+                    return 1;
+                }
+
+                std::stringstream val(argv[i + 1]);
+
+                val >> lockstep_interval;
+
+                if (lockstep_interval < 1) {
+                    printf("-lk requires a positive interval.\n");
+                    return 1;
+                }
+
+                lockstep = true;
+
+                i++;
+            }
+
+            else if (argv[i] == string("--max-instructions") || argv[i] == string("--max-cycles")) {
+                if (argc == i + 1) {
+                    printf("%s requires an argument.\n", argv[i]);
+                    return 1;
+                }
+
+                unsigned long long& limit = argv[i] == string("--max-cycles") ? max_cycles : max_instructions;
+
+                if (!parse_count(argv[i + 1], limit) || !limit) {
+                    printf("Invalid argument for %s: \"%s\"\n", argv[i], argv[i + 1]);
+                    return 1;
+                }
+
+                budgeting = true;
+
+                i++;
+            }
+
+            else if (argv[i] == string("--timeout")) {
+                if (argc == i + 1) {
+                    printf("--timeout requires an argument.\n");
+                    return 1;
+                }
+
+                std::stringstream val(argv[i + 1]);
+
+                val >> max_seconds;
+
+                if (max_seconds <= 0) {
+                    printf("--timeout requires a positive number of seconds.\n");
+                    return 1;
+                }
+
+                budgeting = true;
+
+                i++;
+            }
+
+            else if (argv[i] == string("--serve")) {
+                if (argc == i + 1) {
+                    printf("--serve requires an argument.\n");
+                    return 1;
+                }
+
+                serve_path = argv[i + 1];
+
+                i++;
+            }
+
+            else if (argv[i] == string("-sw")) {
+                if (argc == i + 1) {
+                    printf("-sw requires an argument.\n");
+                    return 1;
+                }
+
+                std::stringstream val(argv[i + 1]);
+
+                val >> serve_workers;
+
+                i++;
+            }
+
+            else if (argv[i] == string("-cd")) {
+                if (argc == i + 1) {
+                    printf("-cd requires an argument.\n");
+                    return 1;
+                }
+
+                cache_dir = argv[i + 1];
+
+                i++;
+            }
+
+            else if (argv[i] == string("-cs")) {
+                if (argc == i + 1) {
+                    printf("-cs requires an argument.\n");
+                    return 1;
+                }
+
+                if (!parse_count(argv[i + 1], cache_limit)) {
+                    printf("Invalid argument for -cs: \"%s\"\n", argv[i + 1]);
+                    return 1;
+                }
+
+                i++;
+            }
+
+            else if (argv[i] == string("--nc")) {
+                cache_bypass = true;
+            }
+
+            else if (argv[i] == string("--dump")) {
+                if (argc == i + 1) {
+                    printf("--dump requires an argument.\n");
+                    return 1;
+                }
+
+                dump_file = argv[i + 1];
+
+                i++;
+            }
+
+            else if (argv[i] == string("--diff")) {
+                if (argc == i + 1) {
+                    printf("--diff requires an argument.\n");
+                    return 1;
+                }
+
+                std::ifstream golden(argv[i + 1], std::ios::binary);
+
+                if (!golden.good()) {
+                    printf("File \"%s\" not found.\n", argv[i + 1]);
+                    return 1;
+                }
+
+                std::stringstream buffer;
+                buffer << golden.rdbuf();
+
+                diff_file = argv[i + 1];
+                diff_image = buffer.str();
+
+                i++;
+            }
+
+            else if (argv[i] == string("--find")) {
+                if (argc == i + 1) {
+                    printf("--find requires an argument.\n");
+                    return 1;
+                }
+
+                if (!parse_hex(argv[i + 1], find_bytes)) {
+                    printf("Invalid argument for --find: \"%s\"\n", argv[i + 1]);
+                    return 1;
+                }
+
+                i++;
+            }
+
+            else if (argv[i] == string("-ln")) {
+                if (argc == i + 1) {
+                    printf("-ln requires an argument.\n");
+                    return 1;
+                }
+
+                std::stringstream val(argv[i + 1]);
+
+                val >> lane_instances;
+
+                i++;
+            }
+
+            else if (argv[i] == string("-lv")) {
+                if (argc == i + 1) {
+                    printf("-lv requires an argument.\n");
+                    return 1;
+                }
+
+                int addr;
+                string vary = argv[i + 1];
+
+                if (vary != "a" && vary != "x" && vary != "y" && (!parse_num(vary, addr) || addr > 0xFFFF)) {
+                    printf("Invalid argument for -lv: \"%s\"\n", argv[i + 1]);
+                    return 1;
+                }
+
+                lane_vary.push_back(vary);
+
+                i++;
+            }
+
+            else if (argv[i] == string("--fuzz")) {
+                if (argc == i + 1) {
+                    printf("--fuzz requires an argument.\n");
+                    return 1;
+                }
+
+                if (!parse_num(argv[i + 1], fuzz_addr) || fuzz_addr > 0xFFFF) {
+                    printf("Invalid argument for --fuzz: \"%s\"\n", argv[i + 1]);
+                    return 1;
+                }
+
+                i++;
+            }
+
+            else if (argv[i] == string("-fi")) {
+                if (argc == i + 1) {
+                    printf("-fi requires an argument.\n");
+                    return 1;
+                }
+
+                fuzz_inputs = argv[i + 1];
+
+                i++;
+            }
+
+            else if (argv[i] == string("-fl")) {
+                if (argc == i + 1) {
+                    printf("-fl requires an argument.\n");
+                    return 1;
+                }
+
+                if (!parse_num(argv[i + 1], fuzz_max_len) || fuzz_max_len < 1 || fuzz_max_len > 0x10000) {
+                    printf("Invalid argument for -fl: \"%s\"\n", argv[i + 1]);
+                    return 1;
+                }
+
+                i++;
+            }
+
+            else if (argv[i] == string("-fn")) {
+                if (argc == i + 1) {
+                    printf("-fn requires an argument.\n");
+                    return 1;
+                }
+
+                if (!parse_count(argv[i + 1], fuzz_execs)) {
+                    printf("Invalid argument for -fn: \"%s\"\n", argv[i + 1]);
+                    return 1;
+                }
+
+                i++;
+            }
+
+            else if (argv[i] == string("-cp")) {
+                if (argc == i + 1) {
+                    printf("-cp requires an argument.\n");
+                    return 1;
+                }
+
+                std::ifstream image(argv[i + 1], std::ios::binary);
+
+                if (!image.good()) {
+                    printf("File \"%s\" not found.\n", argv[i + 1]);
+                    return 1;
+                }
+
+                std::stringstream buffer;
+                buffer << image.rdbuf();
+
+                multi_images.push_back(buffer.str());
+
+                i++;
+            }
+
+            else if (argv[i] == string("-sh")) {
+                if (argc == i + 1) {
+                    printf("-sh requires an argument.\n");
+                    return 1;
+                }
+
+                if (!add_shared(argv[i + 1])) {
+                    printf("Invalid argument for -sh: \"%s\"\n", argv[i + 1]);
+                    return 1;
+                }
+
+                i++;
+            }
+
+            else if (argv[i] == string("-qt")) {
+                if (argc == i + 1) {
+                    printf("-qt requires an argument.\n");
+                    return 1;
+                }
+
+                if (!parse_count(argv[i + 1], multi_quantum) || !multi_quantum) {
+                    printf("Invalid argument for -qt: \"%s\"\n", argv[i + 1]);
+                    return 1;
+                }
+
+                i++;
+            }
+
+            else if (argv[i] == string("--det")) {
+                multi_deterministic = true;
+            }
+
+            else if (argv[i] == string("--recompile")) {
+                if (argc == i + 1) {
+                    printf("--recompile requires an argument.\n");
+                    return 1;
+                }
+
+                recompile_file = argv[i + 1];
+
+                i++;
+            }
+
+            else if (argv[i] == string("--disasm")) {
+                disasm_listing = true;
+            }
+
+            else if (argv[i] == string("-vi")) {
+                if (argc == i + 1) {
+                    printf("-vi requires an argument.\n");
+                    return 1;
+                }
+
+                if (!via_parse(argv[i + 1])) {
+                    printf("Invalid argument for -vi: \"%s\"\n", argv[i + 1]);
+                    return 1;
+                }
+
+                i++;
+            }
+
+            else if (argv[i] == string("-fb")) {
+                if (argc == i + 1) {
+                    printf("-fb requires an argument.\n");
+                    return 1;
+                }
+
+                if (!parse_num(argv[i + 1], fb_start) || fb_start < 0x200 || fb_start > 0xFFFF) {
+                    printf("Invalid argument for -fb: \"%s\"\n", argv[i + 1]);
+                    return 1;
+                }
+
+                i++;
+            }
+
+            else if (argv[i] == string("-fs")) {
+                if (argc == i + 1) {
+                    printf("-fs requires an argument.\n");
+                    return 1;
+                }
+
+                if (!fb_parse_size(argv[i + 1])) {
+                    printf("Invalid argument for -fs: \"%s\"\n", argv[i + 1]);
+                    return 1;
+                }
+
+                i++;
+            }
+
+            else if (argv[i] == string("-fm")) {
+                if (argc == i + 1) {
+                    printf("-fm requires an argument.\n");
+                    return 1;
+                }
+
+                if (argv[i + 1] != string("palette") && argv[i + 1] != string("bitmap")) {
+                    printf("Invalid argument for -fm: \"%s\"\n", argv[i + 1]);
+                    return 1;
+                }
+
+                fb_bitmap = argv[i + 1] == string("bitmap");
+
+                i++;
+            }
+
+            else if (argv[i] == string("-fr")) {
+                if (argc == i + 1) {
+                    printf("-fr requires an argument.\n");
+                    return 1;
+                }
+
+                if (!parse_count(argv[i + 1], fb_interval) || !fb_interval) {
+                    printf("Invalid argument for -fr: \"%s\"\n", argv[i + 1]);
+                    return 1;
+                }
+
+                i++;
+            }
+
+            else if (argv[i] == string("-fo")) {
+                if (argc == i + 1) {
+                    printf("-fo requires an argument.\n");
+                    return 1;
+                }
+
+                fb_out = argv[i + 1];
+
+                i++;
+            }
+
+            else if (argv[i] == string("-bd")) {
+                if (argc == i + 1) {
+                    printf("-bd requires an argument.\n");
+                    return 1;
+                }
+
+                disk_file = argv[i + 1];
+
+                i++;
+            }
+
+            else if (argv[i] == string("-ba")) {
+                if (argc == i + 1) {
+                    printf("-ba requires an argument.\n");
+                    return 1;
+                }
+
+                if (!parse_num(argv[i + 1], disk_start) || disk_start < 0x200 || disk_start > 0x10000 - 10) {
+                    printf("Invalid argument for -ba: \"%s\"\n", argv[i + 1]);
+                    return 1;
+                }
+
+                i++;
+            }
+
+            else if (argv[i] == string("-bl")) {
+                if (argc == i + 1) {
+                    printf("-bl requires an argument.\n");
+                    return 1;
+                }
+
+                if (!parse_count(argv[i + 1], disk_latency)) {
+                    printf("Invalid argument for -bl: \"%s\"\n", argv[i + 1]);
+                    return 1;
+                }
+
+                i++;
+            }
+
+            else if (argv[i] == string("-hc")) {
+                if (argc == i + 1) {
+                    printf("-hc requires an argument.\n");
+                    return 1;
+                }
+
+                if (!parse_num(argv[i + 1], hyper_start) || hyper_start < 0x200 || hyper_start > 0xFFFF) {
+                    printf("Invalid argument for -hc: \"%s\"\n", argv[i + 1]);
+                    return 1;
+                }
+
+                i++;
+            }
+
+            else if (argv[i] == string("-tr")) {
+                if (argc == i + 1) {
+                    printf("-tr requires an argument.\n");
+                    return 1;
+                }
+
+                trace_file = argv[i + 1];
+
+                i++;
+            }
+
+            else if (argv[i] == string("-tc")) {
+                if (argc == i + 1) {
+                    printf("-tc requires an argument.\n");
+                    return 1;
+                }
+
+                if (!parse_count(argv[i + 1], trace_chunk) || trace_chunk == 0) {
+                    printf("Invalid argument for -tc: \"%s\"\n", argv[i + 1]);
+                    return 1;
+                }
+
+                i++;
+            }
+
+            else if (argv[i] == string("-ti")) {
+                if (argc == i + 1) {
+                    printf("-ti requires an argument.\n");
+                    return 1;
+                }
+
+                trace_input = argv[i + 1];
+
+                i++;
+            }
+
+            else if (argv[i] == string("-tn")) {
+                if (argc == i + 1) {
+                    printf("-tn requires an argument.\n");
+                    return 1;
+                }
+
+                if (!parse_count(argv[i + 1], trace_start)) {
+                    printf("Invalid argument for -tn: \"%s\"\n", argv[i + 1]);
+                    return 1;
+                }
+
+                i++;
+            }
+
+            else if (argv[i] == string("-tl")) {
+                if (argc == i + 1) {
+                    printf("-tl requires an argument.\n");
+                    return 1;
+                }
+
+                if (!parse_count(argv[i + 1], trace_limit)) {
+                    printf("Invalid argument for -tl: \"%s\"\n", argv[i + 1]);
+                    return 1;
+                }
+
+                i++;
+            }
+
+            else if (argv[i] == string("-tp")) {
+                if (argc == i + 1) {
+                    printf("-tp requires an argument.\n");
+                    return 1;
+                }
+
+                if (!trace_parse_range(argv[i + 1])) {
+                    printf("Invalid argument for -tp: \"%s\"\n", argv[i + 1]);
+                    return 1;
+                }
+
+                i++;
+            }
+
+            else if (argv[i] == string("--ni")) {
+                idling = false;
+            }
+
+            else if (argv[i] == string("--nf")) {
+                fusing = false;
+            }
+
+            else if (argv[i] == string("--reason")) {
+                reason_print = true;
+            }
+
             else if (argv[i] == string("-sa")) {
                 if (argc == i + 1) {
                     printf("-sa requires an argument.\n");
@@ -263,6 +1032,12 @@ int main(int argc, char** argv) {
         }
     }
 
+    // The reference core only sees memory, not what devices put there or their IRQs
+    if (lockstep && (via_start >= 0 || !disk_file.empty() || hyper_start >= 0 || fb_start >= 0)) {
+        printf("-lk can't be used with devices (-vi, -bd, -hc or -fb).\n");
+        return 1;
+    }
+
     // Set keyboard interrupt handler
     #ifdef _WIN32
     if (!SetConsoleCtrlHandler(CtrlHandler, TRUE)) {
@@ -280,6 +1055,9 @@ int main(int argc, char** argv) {
     sigaction(SIGINT, &sigIntHandler, NULL);
     #endif
 
+    if (!serve_path.empty()) return serve(serve_path);
+    if (!trace_input.empty()) return trace_main();
+
     if (codestring.empty()) {
         if (file == NULL) {
             printf("You must input a file or code. Input \"-?\" for help.\n");
@@ -310,53 +1088,109 @@ int main(int argc, char** argv) {
         memory[romstart + i] = codestring[i];
     }
 
+    if (disasm_listing) {
+        disasm_print(romstart, romstart + codestring.length());
+        return 0;
+    }
+
+    if (lane_instances > 0) return lanes_main();
+    if (fuzz_addr >= 0) return fuzz_main();
+    if (!multi_images.empty()) return multi_main(romstart);
+    if (!recompile_file.empty()) return recompile(recompile_file);
+
+    // Replay a stored run, or capture this one to store it (not for runs that are debugged or measure the host)
+    #ifndef HOST_STATS
+    if (!cache_dir.empty() && !cache_bypass && !debugging && !profiling && !lockstep && !gdb_listening && dump_file.empty() && fb_start < 0 && disk_file.empty() && hyper_start < 0 && trace_file.empty()) {
+        std::stringstream key;
+
+        key << VERSIONSTRING << ' ' << cache_build_id() << ' ' << CPUSTRING << ' ' << romstart << ' ' << ins_print << mem_print << asc_print << print_out << brk_stop << reason_print << ' '
+            << print_ptr - memory << ' ' << memstart << ' ' << rows << ' ' << rowsize << ' ' << max_instructions << ' ' << max_cycles << ' '
+            << via_start << ' ' << via_end << ' ' << find_bytes.length() << ' ' << find_bytes << diff_image.length() << ' ' << diff_image << codestring;
+
+        int code;
+
+        if (cache_lookup(xxh64(key.str()), code)) return code;
+
+        cache_capture();
+    }
+    #endif
+
+    // Devices are only in the main run
+    if (via_start >= 0) via_attach();
+    if (!disk_file.empty() && !disk_attach()) return 1;
+    if (hyper_start >= 0 && !hyper_attach()) return 1;
+
     // Set program counter (reset vector)
     pc = 0x100 * memory[0xFFFD] + memory[0xFFFC];
 
     // Amount of bytes to move (0xFF means break)
     byte mvbytes = 0;
 
-    steady_clock::time_point begin = steady_clock::now();
-    long i = 0;
+    if (profiling) profile_start(pc);
+    if (lockstep) lockstep_start();
+    if (budgeting) budget_start();
+    if (!trace_file.empty() && !trace_open()) return 1;
+
+    // After everything else that can fail, as it starts the encoder thread (joined by fb_finish)
+    if (fb_start >= 0 && !fb_attach()) return 1;
+
+    // Idle loops can only be skipped when nothing needs to see every instruction
+    idling = idling && !ins_print && !debugging && !profiling && !lockstep && !gdb_listening && !tracing;
+
+    // Pairs can only be fused when nothing needs to see every instruction, pacing counts every one too
+    fusing = fusing && !ins_print && !debugging && !profiling && !lockstep && !gdb_listening && !tracing && !frequency;
+
+    if (fusing) fuse_init();
+
+    byte2 at = pc;
+
+    // Run on the recompiled code instead if built with it and nothing needs to see every instruction or device access (see aot.h)
+    bool recompiled = !ins_print && !debugging && !profiling && !lockstep && !gdb_listening && !tracing && !frequency && devices.empty() && aot_run(at, mvbytes);
 
     // Instruction loop
-    while (mvbytes != BRK_MOVE && !broken) {
-        if (ins_print) printf("%04X %02X - ", pc, memory[pc]); // Print position and instruction before running (which might change program counter)
+    if (!recompiled) mvbytes = run(at, frequency);
 
-        byte operands[2] = {memory[pc + 1], memory[pc + 2]};
-        mvbytes = instruction(memory[pc], operands);
+    if (gdb_connected) gdb_exit();
 
-        if (ins_print) printf("A: %02X X: %02X Y: %02X S: %02X SR/NV-BDIZC: [%d%d%d%d%d%d%d%d]\n", a, x, y, sp, sr.n, sr.v, sr._, sr.b, sr.d, sr.i, sr.z, sr.c);
+    if (broken) stop_reason = STOP_INTERRUPT;
+    else if (mvbytes == BRK_MOVE && memory[at] != 0x00) stop_reason = STOP_HALT;
 
-        // Increment program counter
-        pc += mvbytes;
-        
-        // Delay to match input frequency if given (might want to clean up)
-        if (frequency) {
-            i++;
+    stop_report(at);
 
-            if (frequency < 100 || i < 100 || !(i % (frequency / 100))) {
-                std::this_thread::sleep_for(nanoseconds((1000000000ll * i)/frequency - duration_cast<nanoseconds>(steady_clock::now() - begin).count()));
-            }
-        }
-    }
+    if (fb_start >= 0) fb_finish();
+    if (tracing) trace_finish();
+
+    if (lockstep) lockstep_finish(at, mvbytes == BRK_MOVE);
 
     if (mem_print) {
-        // Output of memory once finished (rows of 8 bytes)
-        for (int i = 0; i < rows && rowsize * (1 + i) + memstart <= 0x10000; i++) {
-            printf("\n%04X: ", rowsize * i + memstart);
+        // Output of memory once finished
+        dump_rows(memstart, rows, rowsize, asc_print);
 
-            for (int j = 0; j < rowsize; j++) {
-                printf("%02X ", memory[rowsize * i + j + memstart]);
-            }
+        printf("\n");
+    }
 
-            if (asc_print) std::cout << "| " + ascii(rowsize * i + memstart, rowsize);
-        }
+    if (!dump_file.empty()) {
+        std::ofstream out(dump_file, std::ios::binary);
 
-        printf("\n");
+        out.write((const char*)memory, MEMORY_SIZE);
+
+        if (!out) printf("Unable to write memory to \"%s\".\n", dump_file.c_str());
     }
 
+    if (!diff_file.empty()) diff_report(diff_file, diff_image);
+
+    if (!find_bytes.empty()) find_report(find_bytes);
+
     std::cout << endprint << '\n';
 
-    return 0;
+    #ifdef HOST_STATS
+    stats_report(cycles);
+    #endif
+
+    if (profiling) profile_report();
+
+    // Runs cut short by the clock or Ctrl+C might end differently next time
+    if (caching) cache_store(stop_reason, stop_reason != STOP_TIMEOUT && stop_reason != STOP_INTERRUPT);
+
+    return stop_reason;
 }
@@ -0,0 +1,356 @@
+#include <vector>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string_view>
+
+/* aot.h
+  Contains the static recompiler (--recompile), which follows the control flow of the loaded image from the reset vector
+  and writes every basic block found as C++ calling the instruction functions of ops.h. A build with RECOMPILED set to
+  the written file (e.g. -DRECOMPILED='"rom.h"') runs those blocks natively wherever the program counter lands on one.
+  Everything else runs in the interpreter: indirect jumps into code that wasn't found, BRK, undocumented opcodes,
+  code in the stack page (pushes aren't tracked as writes), and the blocks of a page whose bytes no longer match the ones recompiled.
+*/
+
+string recompile_file;
+
+// Bytes of recompiled instructions, compared with memory once their page has been written
+struct AotRun {
+    byte2 addr;
+    byte2 len;
+    const char* bytes;
+};
+
+// Whether an opcode is recompiled (the documented 6502 ones apart from BRK, whose functions are named as in op_info)
+bool aot_supported(byte opcode) {
+    return op_info[opcode].variant == V_6502 && !op_same(op_info[opcode].name, "BRK");
+}
+
+// Argument of an instruction function for an addressing mode, as in the mode macros of ops.h
+string aot_operand(OpMode mode, byte lo, byte hi) {
+    char out[64];
+
+    switch (mode) {
+        case O_ACC: return "a";
+        case O_IMM: snprintf(out, sizeof(out), "0x%02X", lo); break;
+        case O_REL: snprintf(out, sizeof(out), "(signed char)0x%02X", lo); break;
+        case O_ZP:  snprintf(out, sizeof(out), "zp(0x%02X)", lo); break;
+        case O_ZPX: snprintf(out, sizeof(out), "zp(0x%02X + x)", lo); break;
+        case O_ZPY: snprintf(out, sizeof(out), "zp(0x%02X + y)", lo); break;
+        case O_ABS: snprintf(out, sizeof(out), "memory[0x%02X%02X]", hi, lo); break;
+        case O_ABX: snprintf(out, sizeof(out), "memory[(byte2)(0x%02X%02X + x)]", hi, lo); break;
+        case O_ABY: snprintf(out, sizeof(out), "memory[(byte2)(0x%02X%02X + y)]", hi, lo); break;
+        case O_IZX: snprintf(out, sizeof(out), "memory[zp(0x%02X + x + 1) * 0x100 + zp(0x%02X + x)]", lo, lo); break;
+        case O_IZY: snprintf(out, sizeof(out), "memory[(byte2)(zp(0x%02X + 1) * 0x100 + y + zp(0x%02X))]", lo, lo); break;
+        default: return "";
+    }
+
+    return out;
+}
+
+// Recompile the loaded image from the reset vector into a C++ file, returns the exit code
+int recompile(const string& path) {
+    std::vector<bool> found(0x10000), leader(0x10000);
+    std::vector<byte> preds(0x10000);
+    std::vector<int> work = {0x100 * memory[0xFFFD] + memory[0xFFFC]};
+    bool code_page[0x100] = {};
+
+    if (brk_stop) work.push_back(0x100 * memory[0xFFFF] + memory[0xFFFE]);
+
+    for (int root : work) leader[root] = true;
+
+    // Follow branches, jumps and calls, stopping at anything left to the interpreter
+    while (!work.empty()) {
+        int at = work.back();
+        work.pop_back();
+
+        while (!found[at] && (at >> 8) != 0x01) {
+            byte opcode = memory[at];
+            const OpInfo& info = op_info[opcode];
+            int len = info.length;
+            int target = -1;
+
+            if (!aot_supported(opcode) || at + len > 0x10000) break;
+
+            if (info.mode == O_REL) target = (byte2)(at + 2 + (signed char)memory[at + 1]);
+            else if (op_same(info.name, "JSR") || (op_same(info.name, "JMP") && info.mode == O_ABS)) target = memory[at + 1] + 0x100 * memory[at + 2];
+
+            // A branch or jump to itself is left to the interpreter, which stops it as a hang
+            if (target == at) {
+                if (info.mode == O_REL) {
+                    leader[(at + 2) & 0xFFFF] = true;
+                    work.push_back((at + 2) & 0xFFFF);
+                }
+
+                break;
+            }
+
+            found[at] = true;
+
+            for (int i = 0; i < len; i++) code_page[(at + i) >> 8] = true;
+
+            if (target >= 0) {
+                leader[target] = true;
+                work.push_back(target);
+            }
+
+            if (op_is(info, {"JMP", "RTS", "RTI"})) break;
+
+            at = (at + len) & 0xFFFF;
+            preds[at]++;
+        }
+    }
+
+    std::vector<int> starts;
+
+    for (int at = 0; at < 0x10000; at++) {
+        if (found[at]) starts.push_back(at);
+    }
+
+    if (starts.empty()) {
+        printf("No code to recompile was found from the reset vector.\n");
+        return 1;
+    }
+
+    // Blocks also start after calls, branches and stores that might hit code (so a block never changes itself),
+    // where paths meet, and where the next instruction isn't the next one written out
+    for (size_t i = 0; i < starts.size(); i++) {
+        int at = starts[i];
+        const OpInfo& info = op_info[memory[at]];
+        int next = (at + info.length) & 0xFFFF;
+        bool store = op_is(info, {"STA", "STX", "STY"}) || (op_is(info, {"ASL", "LSR", "ROL", "ROR", "INC", "DEC"}) && info.mode != O_ACC);
+        bool hits_code = info.mode == O_ABS ? code_page[memory[at + 2]] : info.mode == O_ZP || info.mode == O_ZPX || info.mode == O_ZPY ? code_page[0] : true;
+
+        if (preds[at] > 1) leader[at] = true;
+        if (info.mode == O_REL || op_same(info.name, "JSR") || (store && hits_code)) leader[next] = true;
+        if (i + 1 == starts.size() || starts[i + 1] != next) leader[next] = true;
+    }
+
+    std::ofstream out(path);
+    char line[160];
+    int blocks = 0;
+
+    snprintf(line, sizeof(line), "// Recompiled by 6502 --recompile from an image with reset vector %02X%02X, see aot.h\n", memory[0xFFFD], memory[0xFFFC]);
+    out << line;
+    out << "static_assert(std::string_view(CPUSTRING) == \"" CPUSTRING "\", \"Recompiled for the " CPUSTRING ", build for the same CPU\");\n\n";
+
+    // Instruction bytes in runs that don't cross a page
+    out << "const AotRun aot_code[] = {\n";
+
+    for (size_t i = 0; i < starts.size();) {
+        int from = starts[i], to = from;
+
+        while (i < starts.size() && starts[i] <= to && (starts[i] >> 8) == (from >> 8)) {
+            to = std::max(to, starts[i] + op_info[memory[starts[i]]].length);
+            i++;
+        }
+
+        for (int start = from; start < to; start = (start & 0xFF00) + 0x100) {
+            int end = std::min(to, (start & 0xFF00) + 0x100);
+
+            snprintf(line, sizeof(line), "    {0x%04X, %d, \"", start, end - start);
+            out << line;
+
+            for (int at = start; at < end; at++) {
+                snprintf(line, sizeof(line), "\\x%02X", memory[at]);
+                out << line;
+            }
+
+            out << "\"},\n";
+        }
+    }
+
+    out << "};\n\n";
+
+    std::stringstream body;
+    bool dispatched = false; // Whether a return or indirect jump goes back through the switch
+
+    for (size_t i = 0; i < starts.size(); i++) {
+        int at = starts[i];
+        byte opcode = memory[at], lo = memory[(byte2)(at + 1)], hi = memory[(byte2)(at + 2)];
+        const OpInfo& info = op_info[opcode];
+        int len = info.length;
+        int next = (at + len) & 0xFFFF;
+
+        if (leader[at]) {
+            int count = 0, cost = 0, last = at;
+
+            // The block runs on until an instruction that leaves it or the next block
+            for (int ins = at; ; ) {
+                const OpInfo& step = op_info[memory[ins]];
+                int after = (ins + step.length) & 0xFFFF;
+
+                count++;
+                cost += op_cycles[memory[ins]];
+                last = ins + step.length - 1;
+
+                if (op_is(step, {"JMP", "RTS", "RTI"}) || !found[after] || leader[after]) break;
+
+                ins = after;
+            }
+
+            snprintf(line, sizeof(line), "\nb_%04X: AOT_BLOCK(0x%04X, %d, %d, 0x%02X, 0x%02X)\n", at, at, count, cost, at >> 8, last >> 8);
+            body << line;
+            blocks++;
+        }
+
+        // The instruction, with its address and bytes
+        string call;
+
+        if (op_same(info.name, "JMP") && info.mode == O_ABS) {
+            snprintf(line, sizeof(line), "pc = 0x%02X%02X;", hi, lo);
+            call = line;
+        } else if (op_same(info.name, "JMP")) {
+            snprintf(line, sizeof(line), "AOT_INSTRUCTION(0x%04X, 0x%02X, 0x%02X, 0x%02X)", at, opcode, lo, hi);
+            call = line;
+        } else if (info.mode == O_REL || op_is(info, {"JSR", "RTS", "RTI"})) {
+            snprintf(line, sizeof(line), "pc = 0x%04X; %s(%s); pc += %d;", at, info.name, aot_operand(info.mode, lo, hi).c_str(), len);
+            call = line;
+        } else {
+            call = string(info.name) + "(" + aot_operand(info.mode, lo, hi) + ");";
+        }
+
+        snprintf(line, sizeof(line), "    %-56s // %04X ", call.c_str(), at);
+        body << line;
+
+        for (int b = 0; b < len; b++) {
+            snprintf(line, sizeof(line), " %02X", memory[at + b]);
+            body << line;
+        }
+
+        body << "\n";
+
+        // Where it goes next
+        int target = info.mode == O_REL || op_is(info, {"JSR", "JMP"}) ? 0x100 * hi + lo : -1;
+
+        if (info.mode == O_REL) target = (byte2)(at + 2 + (signed char)lo);
+
+        if (op_is(info, {"RTS", "RTI"}) || (op_same(info.name, "JMP") && info.mode != O_ABS)) {
+            body << "    goto aot_dispatch;\n";
+            dispatched = true;
+            continue;
+        }
+
+        if (target >= 0) {
+            bool always = op_is(info, {"JSR", "JMP"});
+
+            if (always) snprintf(line, sizeof(line), found[target] ? "    goto b_%04X;\n" : "    return;\n", target);
+            else if (found[target]) snprintf(line, sizeof(line), "    if (pc == 0x%04X) goto b_%04X;\n", target, target);
+            else snprintf(line, sizeof(line), "    if (pc == 0x%04X) return;\n", target);
+
+            body << line;
+
+            if (always) continue;
+        }
+
+        if (!found[next]) snprintf(line, sizeof(line), "    pc = 0x%04X;\n    return;\n", next);
+        else if (i + 1 == starts.size() || starts[i + 1] != next) snprintf(line, sizeof(line), "    goto b_%04X;\n", next);
+        else continue;
+
+        body << line;
+    }
+
+    // Each block is entered through the switch or straight from the block before it
+    out << "void aot_blocks() {\n" << (dispatched ? "aot_dispatch:\n" : "") << "    switch (pc) {\n";
+
+    for (int at : starts) {
+        if (!leader[at]) continue;
+
+        snprintf(line, sizeof(line), "        case 0x%04X: goto b_%04X;\n", at, at);
+        out << line;
+    }
+
+    out << "    }\n\n    return;\n" << body.str();
+    out << "}\n";
+
+    if (!out) {
+        printf("Unable to write \"%s\".\n", path.c_str());
+        return 1;
+    }
+
+    printf("Recompiled %zu instructions in %d blocks to \"%s\".\n", starts.size(), blocks, path.c_str());
+
+    return 0;
+}
+
+#ifdef RECOMPILED
+bool aot_verify(int page);
+
+// Start of a recompiled block: back to the interpreter on Ctrl+C, when a limit check falls within the block,
+// or when a page it is in has been written and its code changed, otherwise the whole block is counted up front
+#define AOT_BLOCK(addr, count, cost, first, last) \
+    if (broken || instructions + count >= budget_next || (page_dirty[first] && !aot_verify(first)) || (page_dirty[last] && !aot_verify(last))) {\
+        pc = addr;\
+        return;\
+    }\
+    instructions += count;\
+    cycles += cost;
+
+// An instruction run through instruction() (indirect jumps, which differ between the CPUs)
+#define AOT_INSTRUCTION(at, opcode, lo, hi) {\
+        byte ops[2] = {lo, hi};\
+        pc = at;\
+        pc += instruction(opcode, ops);\
+    }
+
+#include RECOMPILED
+
+std::vector<const AotRun*> aot_page_runs[0x100];
+bool aot_stale[0x100];  // Pages whose code has changed, run in the interpreter from then on
+
+// Check the recompiled code of a written page against memory, returns whether it is unchanged
+bool aot_verify(int page) {
+    if (aot_stale[page]) return false;
+
+    for (const AotRun* run : aot_page_runs[page]) {
+        if (memcmp(&memory[run->addr], run->bytes, run->len)) {
+            aot_stale[page] = true;
+            return false;
+        }
+    }
+
+    page_dirty[page] = false;
+
+    return true;
+}
+
+// Run the program on the recompiled blocks, interpreting one instruction whenever pc leaves them
+bool aot_run(byte2& at, byte& mvbytes) {
+    // Every code page is checked against the image when first entered
+    for (const AotRun& run : aot_code) {
+        aot_page_runs[run.addr >> 8].push_back(&run);
+        page_dirty[run.addr >> 8] = true;
+    }
+
+    if (!budgeting) budget_next = ~0ull;
+
+    while (!broken) {
+        aot_blocks();
+
+        if (broken) break;
+
+        at = pc;
+        byte opcode = memory[pc];
+        byte operands[2] = {memory[(byte2)(pc + 1)], memory[(byte2)(pc + 2)]};
+        mvbytes = instruction(opcode, operands);
+        cycles += op_cycles[opcode];
+
+        if (mvbytes == BRK_MOVE) break;
+
+        pc += mvbytes;
+
+        if (pc == at && stuck(opcode)) {
+            stop_reason = STOP_HANG;
+            break;
+        }
+
+        if (++instructions >= budget_next && !budget_check()) break;
+    }
+
+    return true;
+}
+#else
+bool aot_run(byte2& at, byte& mvbytes) {
+    return false;
+}
+#endif
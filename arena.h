@@ -0,0 +1,28 @@
+#include <cstring>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+/* arena.h
+  Contains the memory arena, one 2 MiB aligned block holding the main machine's 64 KiB memory and the pristine image
+  it is reset from (pool.h). Each memory starts on a page boundary (so it shares no cache line with anything else),
+  and the block is advised as a huge page where the host has one, so both cost a single TLB entry.
+  The block is static, so the main machine's memory address is known when compiling.
+*/
+
+#define MEMORY_SIZE 0x10000
+#define ARENA_SIZE 0x200000
+
+alignas(ARENA_SIZE) byte arena[ARENA_SIZE];
+
+byte* const arena_pristine = arena + MEMORY_SIZE;
+
+// Advise the block as a huge page before anything touches it
+struct ArenaAdvice {
+    ArenaAdvice() {
+        #if !defined(_WIN32) && defined(MADV_HUGEPAGE)
+        madvise(arena, ARENA_SIZE, MADV_HUGEPAGE);
+        #endif
+    }
+} arena_advice;
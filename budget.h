@@ -0,0 +1,117 @@
+#include <chrono>
+#include <algorithm>
+
+/* budget.h
+  Contains the run budget (--max-instructions, --max-cycles, --timeout) and the reasons execution stops.
+*/
+
+// Why execution stopped, also used as the exit code
+enum StopReason {
+    STOP_BRK = 0,           // BRK with --b unset
+    STOP_ERROR = 1,         // Invalid options or input (never set by the loop)
+    STOP_INTERRUPT = 2,     // Ctrl+C or killed from the debugger
+    STOP_INSTRUCTIONS = 3,
+    STOP_CYCLES = 4,
+    STOP_TIMEOUT = 5,
+    STOP_HANG = 6,          // Branch or jump to itself with interrupts disabled
+    STOP_BREAKPOINT = 7,
+    STOP_DIVERGENCE = 8,    // Lockstep found a difference
+    STOP_HALT = 9           // Opcode that halts the processor
+};
+
+const char* stop_names[] = {
+    "brk", "error", "interrupt", "max-instructions", "max-cycles", "timeout", "hang", "breakpoint", "divergence", "halt"
+};
+
+StopReason stop_reason = STOP_BRK;
+bool reason_print = false;
+
+// Limits (0 for none)
+unsigned long long max_instructions = 0;
+unsigned long long max_cycles = 0;
+double max_seconds = 0;
+
+bool budgeting = false;
+unsigned long long instructions = 0;  // Executed so far (only counted when budgeting)
+unsigned long long budget_next = 0;   // Instruction count of the next check
+
+// Instructions between checks, and the most cycles one instruction can take (a taken branch crossing a page is 4)
+#define BUDGET_BLOCK 0x1000
+#define BUDGET_MAX_CYCLES 8
+
+std::chrono::steady_clock::time_point budget_begin;
+
+// Parse a count, suffix with "k" or "m" for thousands or millions
+bool parse_count(string arg, unsigned long long& out) {
+    unsigned long long scale = 1;
+    char last = arg.empty() ? 0 : arg.back();
+
+    if (last == 'k' || last == 'K') scale = 1000;
+    if (last == 'm' || last == 'M') scale = 1000000;
+
+    if (scale > 1) arg.pop_back();
+
+    try {
+        size_t end;
+        out = std::stoull(arg, &end) * scale;
+
+        return end == arg.length();
+    } catch (...) {
+        return false;
+    }
+}
+
+// Check the limits, returns false once one is reached (called when instructions reaches budget_next)
+bool budget_check() {
+    if (max_instructions && instructions >= max_instructions) {
+        stop_reason = STOP_INSTRUCTIONS;
+        return false;
+    }
+
+    if (max_cycles && cycles >= max_cycles) {
+        stop_reason = STOP_CYCLES;
+        return false;
+    }
+
+    if (max_seconds && std::chrono::duration<double>(std::chrono::steady_clock::now() - budget_begin).count() >= max_seconds) {
+        stop_reason = STOP_TIMEOUT;
+        return false;
+    }
+
+    // Space the next check so that neither count can go past its limit
+    unsigned long long block = BUDGET_BLOCK;
+
+    if (max_instructions) block = std::min(block, max_instructions - instructions);
+    if (max_cycles) block = std::min(block, (max_cycles - cycles + BUDGET_MAX_CYCLES - 1) / BUDGET_MAX_CYCLES);
+
+    budget_next = instructions + block;
+
+    return true;
+}
+
+void budget_start() {
+    budget_begin = std::chrono::steady_clock::now();
+    budget_check();
+}
+
+// Report why execution stopped (a limit or hang on stdout, everything on stderr with --reason)
+void stop_report(byte2 at) {
+    if (stop_reason == STOP_HANG && memory[at] == 0xCB) { // Only stuck on itself as WAI on the 65C02 (see stuck in ops.h)
+        printf("Stopped: WAI at %04X waits for an interrupt nothing will raise.\n", at);
+    } else if (stop_reason == STOP_HANG) {
+        printf("Stopped: the instruction at %04X loops to itself with interrupts disabled.\n", at);
+    } else if (stop_reason >= STOP_INSTRUCTIONS && stop_reason <= STOP_TIMEOUT) {
+        printf("Stopped: reached the %s limit at %04X.\n", stop_names[stop_reason], pc);
+    }
+
+    if (reason_print) {
+        // A stopping BRK moves pc past the instruction, so give its own address
+        byte2 where = stop_reason == STOP_BRK || stop_reason == STOP_HALT ? at : pc;
+
+        fprintf(stderr, "reason=%s code=%d pc=%04X cycles=%llu", stop_names[stop_reason], stop_reason, where, cycles);
+
+        if (budgeting) fprintf(stderr, " instructions=%llu", instructions);
+
+        fprintf(stderr, "\n");
+    }
+}
@@ -0,0 +1,248 @@
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+/* cache.h
+  Contains the on-disk result cache (-cd), keyed by an XXH64 hash of the image, load address and options.
+  A cached run replays the output and exit code of the run it was stored from.
+*/
+
+namespace fs = std::filesystem;
+
+string cache_dir;                                // Empty for no cache
+unsigned long long cache_limit = 64 * 1000000;   // Total size of entries kept
+bool cache_bypass = false;
+
+// Output of a captured run (stdout and stderr) waiting to be stored
+struct CacheStream {
+    FILE* target;
+    FILE* temp = NULL;
+    int saved = -1;
+};
+
+bool caching = false;
+string cache_file;
+CacheStream cache_streams[2] = {{stdout}, {stderr}};
+
+#define XXH_P1 11400714785074694791ull
+#define XXH_P2 14029467366897019727ull
+#define XXH_P3 1609587929392839161ull
+#define XXH_P4 9650029242287828579ull
+#define XXH_P5 2870177450012600261ull
+
+inline unsigned long long xxh_rotl(unsigned long long val, int bits) {
+    return val << bits | val >> (64 - bits);
+}
+
+inline unsigned long long xxh_round(unsigned long long acc, unsigned long long input) {
+    return xxh_rotl(acc + input * XXH_P2, 31) * XXH_P1;
+}
+
+inline unsigned long long xxh_merge(unsigned long long acc, unsigned long long val) {
+    return (acc ^ xxh_round(0, val)) * XXH_P1 + XXH_P4;
+}
+
+// XXH64 of a string (assumes a little endian host)
+unsigned long long xxh64(const string& data, unsigned long long seed = 0) {
+    const byte* p = (const byte*)data.data();
+    const byte* end = p + data.length();
+    unsigned long long hash, word;
+    unsigned int half;
+
+    if (data.length() >= 32) {
+        unsigned long long v[4] = {seed + XXH_P1 + XXH_P2, seed + XXH_P2, seed, seed - XXH_P1};
+
+        for (; p + 32 <= end; p += 32) {
+            for (int i = 0; i < 4; i++) {
+                memcpy(&word, p + 8 * i, 8);
+                v[i] = xxh_round(v[i], word);
+            }
+        }
+
+        hash = xxh_rotl(v[0], 1) + xxh_rotl(v[1], 7) + xxh_rotl(v[2], 12) + xxh_rotl(v[3], 18);
+
+        for (int i = 0; i < 4; i++) {
+            hash = xxh_merge(hash, v[i]);
+        }
+    } else {
+        hash = seed + XXH_P5;
+    }
+
+    hash += data.length();
+
+    for (; p + 8 <= end; p += 8) {
+        memcpy(&word, p, 8);
+        hash = xxh_rotl(hash ^ xxh_round(0, word), 27) * XXH_P1 + XXH_P4;
+    }
+
+    if (p + 4 <= end) {
+        memcpy(&half, p, 4);
+        hash = xxh_rotl(hash ^ half * XXH_P1, 23) * XXH_P2 + XXH_P3;
+        p += 4;
+    }
+
+    for (; p < end; p++) {
+        hash = xxh_rotl(hash ^ *p * XXH_P5, 11) * XXH_P1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= XXH_P2;
+    hash ^= hash >> 29;
+    hash *= XXH_P3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
+
+// Identify this build, so a build that changed the emulator's behavior doesn't replay runs stored by another
+string cache_build_id() {
+    std::ifstream exe("/proc/self/exe", std::ios::binary);
+    std::stringstream data;
+
+    if (exe) data << exe.rdbuf();
+
+    // Where the executable can't be read, every compile counts as a new build
+    if (data.str().empty()) return __DATE__ " " __TIME__;
+
+    return std::to_string(xxh64(data.str()));
+}
+
+// Replay a stored run, returns false if there is none
+bool cache_lookup(unsigned long long key, int& code) {
+    char name[24];
+    snprintf(name, sizeof(name), "%016llx.run", key);
+
+    cache_file = (fs::path(cache_dir) / name).string();
+
+    std::ifstream in(cache_file, std::ios::binary);
+    char magic[4];
+    unsigned int out_len;
+
+    if (!in.read(magic, 4) || memcmp(magic, "65RC", 4) || !in.read((char*)&code, sizeof(code)) || !in.read((char*)&out_len, 4)) return false;
+
+    std::stringstream rest;
+    rest << in.rdbuf();
+
+    string data = rest.str();
+
+    if (data.length() < out_len) return false;
+
+    fwrite(data.data(), 1, out_len, stdout);
+    fwrite(data.data() + out_len, 1, data.length() - out_len, stderr);
+
+    // Mark as recently used
+    std::error_code err;
+    fs::last_write_time(cache_file, fs::file_time_type::clock::now(), err);
+
+    return true;
+}
+
+// Remove the least recently used entries until the cache fits its limit
+void cache_evict() {
+    std::vector<std::pair<fs::file_time_type, fs::path>> entries;
+    unsigned long long total = 0;
+    std::error_code err;
+
+    for (const fs::directory_entry& entry : fs::directory_iterator(cache_dir, err)) {
+        if (entry.path().extension() != ".run") continue;
+
+        total += entry.file_size(err);
+        entries.push_back({entry.last_write_time(err), entry.path()});
+    }
+
+    std::sort(entries.begin(), entries.end());
+
+    for (size_t i = 0; i < entries.size() && total > cache_limit; i++) {
+        total -= fs::file_size(entries[i].second, err);
+        fs::remove(entries[i].second, err);
+    }
+}
+
+#ifndef _WIN32
+#include <unistd.h>
+
+// Send stdout and stderr to temporary files until the run is stored (so nothing shows until the run ends)
+bool cache_capture() {
+    for (CacheStream& stream : cache_streams) {
+        stream.temp = tmpfile();
+
+        if (stream.temp == NULL) return false;
+    }
+
+    for (CacheStream& stream : cache_streams) {
+        fflush(stream.target);
+        stream.saved = dup(fileno(stream.target));
+        dup2(fileno(stream.temp), fileno(stream.target));
+    }
+
+    return caching = true;
+}
+
+// Restore a stream, passing on what was written to it
+string cache_release(CacheStream& stream) {
+    fflush(stream.target);
+    dup2(stream.saved, fileno(stream.target));
+    close(stream.saved);
+
+    string data;
+    char chunk[0x1000];
+    size_t got;
+
+    rewind(stream.temp);
+
+    while ((got = fread(chunk, 1, sizeof(chunk), stream.temp)) > 0) {
+        data.append(chunk, got);
+    }
+
+    fclose(stream.temp);
+
+    fwrite(data.data(), 1, data.length(), stream.target);
+    fflush(stream.target);
+
+    return data;
+}
+
+// Stop capturing and store the run (unless it can't be repeated)
+void cache_store(int code, bool keep) {
+    string out = cache_release(cache_streams[0]);
+    string err_out = cache_release(cache_streams[1]);
+
+    caching = false;
+
+    if (!keep) return;
+
+    std::error_code err;
+    fs::create_directories(cache_dir, err);
+
+    // Write then rename, so concurrent runs never read a partial entry
+    string temp = cache_file + "." + std::to_string(getpid());
+    std::ofstream file(temp, std::ios::binary);
+
+    unsigned int out_len = out.length();
+
+    file.write("65RC", 4);
+    file.write((const char*)&code, sizeof(code));
+    file.write((const char*)&out_len, 4);
+    file << out << err_out;
+    file.close();
+
+    if (!file) {
+        fs::remove(temp, err);
+        return;
+    }
+
+    fs::rename(temp, cache_file, err);
+
+    cache_evict();
+}
+#else
+bool cache_capture() {
+    printf("The result cache is not supported on Windows, running without it.\n");
+    return false;
+}
+
+void cache_store(int code, bool keep) {}
+#endif
@@ -0,0 +1,1030 @@
+#include <vector>
+#include <cstring>
+#include <chrono>
+
+/* conformance.h
+  Contains the instruction conformance programs run by --test.
+  Each program checks its results with branches to itself ("BNE *"), so a failing check traps at its own address,
+  and passes by reaching the BRK at its done address. They run through the instruction loop like any program, once
+  per way through it (fusing pairs, skipping idle loops), which must all leave the same machine.
+*/
+
+byte run(byte2& at, int frequency);
+
+struct ConformanceTest {
+    const char* name;
+    byte2 origin;
+    byte2 done;
+    std::vector<byte> code;
+    bool via = false;       // Uses a VIA at CONFORMANCE_VIA
+};
+
+const std::vector<ConformanceTest> conformance_tests = {
+    {"Load addressing modes", 0x0400, 0x04B4, {
+        0xA2, 0x05,             // LDX #$05
+        0xA0, 0x10,             // LDY #$10
+        0xA9, 0x11,             // LDA #$11
+        0x85, 0x20,             // STA $20
+        0xA9, 0x22,             // LDA #$22
+        0x85, 0x25,             // STA $25
+        0xA9, 0x33,             // LDA #$33
+        0x8D, 0x00, 0x03,       // STA $0300
+        0xA9, 0x44,             // LDA #$44
+        0x8D, 0x05, 0x03,       // STA $0305
+        0xA9, 0x55,             // LDA #$55
+        0x8D, 0x10, 0x03,       // STA $0310
+        0xA9, 0x40,             // LDA #$40 ; Pointer at $35 to $0340
+        0x85, 0x35,             // STA $35
+        0xA9, 0x03,             // LDA #$03
+        0x85, 0x36,             // STA $36
+        0xA9, 0x66,             // LDA #$66
+        0x8D, 0x40, 0x03,       // STA $0340
+        0xA9, 0xF8,             // LDA #$F8 ; Pointer at $38 to $02F8 (indexed into the next page)
+        0x85, 0x38,             // STA $38
+        0xA9, 0x02,             // LDA #$02
+        0x85, 0x39,             // STA $39
+        0xA9, 0x77,             // LDA #$77
+        0x8D, 0x08, 0x03,       // STA $0308
+        0xA9, 0x42,             // LDA #$42
+        0xC9, 0x42,             // CMP #$42
+        0xD0, 0xFE,             // BNE *
+        0xA5, 0x20,             // LDA $20
+        0xC9, 0x11,             // CMP #$11
+        0xD0, 0xFE,             // BNE *
+        0xB5, 0x20,             // LDA $20,X
+        0xC9, 0x22,             // CMP #$22
+        0xD0, 0xFE,             // BNE *
+        0xAD, 0x00, 0x03,       // LDA $0300
+        0xC9, 0x33,             // CMP #$33
+        0xD0, 0xFE,             // BNE *
+        0xBD, 0x00, 0x03,       // LDA $0300,X
+        0xC9, 0x44,             // CMP #$44
+        0xD0, 0xFE,             // BNE *
+        0xB9, 0x00, 0x03,       // LDA $0300,Y
+        0xC9, 0x55,             // CMP #$55
+        0xD0, 0xFE,             // BNE *
+        0xA1, 0x30,             // LDA ($30,X)
+        0xC9, 0x66,             // CMP #$66
+        0xD0, 0xFE,             // BNE *
+        0xB1, 0x38,             // LDA ($38),Y
+        0xC9, 0x77,             // CMP #$77
+        0xD0, 0xFE,             // BNE *
+        // Zero page indexing wraps within page zero
+        0xA2, 0x30,             // LDX #$30
+        0xB5, 0xF5,             // LDA $F5,X
+        0xC9, 0x22,             // CMP #$22
+        0xD0, 0xFE,             // BNE *
+        // Absolute indexing crosses pages
+        0xA2, 0x15,             // LDX #$15
+        0xBD, 0xF0, 0x02,       // LDA $02F0,X
+        0xC9, 0x44,             // CMP #$44
+        0xD0, 0xFE,             // BNE *
+        // (IND, X) pointer wraps from $FF to $00
+        0xA9, 0x40,             // LDA #$40
+        0x85, 0xFF,             // STA $FF
+        0xA9, 0x03,             // LDA #$03
+        0x85, 0x00,             // STA $00
+        0xA2, 0x00,             // LDX #$00
+        0xA1, 0xFF,             // LDA ($FF,X)
+        0xC9, 0x66,             // CMP #$66
+        0xD0, 0xFE,             // BNE *
+        // LDX and LDY modes
+        0xA0, 0x05,             // LDY #$05
+        0xB6, 0x20,             // LDX $20,Y
+        0xE0, 0x22,             // CPX #$22
+        0xD0, 0xFE,             // BNE *
+        0xBE, 0x00, 0x03,       // LDX $0300,Y
+        0xE0, 0x44,             // CPX #$44
+        0xD0, 0xFE,             // BNE *
+        0xA2, 0x05,             // LDX #$05
+        0xB4, 0x20,             // LDY $20,X
+        0xC0, 0x22,             // CPY #$22
+        0xD0, 0xFE,             // BNE *
+        0xBC, 0x00, 0x03,       // LDY $0300,X
+        0xC0, 0x44,             // CPY #$44
+        0xD0, 0xFE,             // BNE *
+        0xAE, 0x00, 0x03,       // LDX $0300
+        0xE0, 0x33,             // CPX #$33
+        0xD0, 0xFE,             // BNE *
+        0xA4, 0x20,             // LDY $20
+        0xC0, 0x11,             // CPY #$11
+        0xD0, 0xFE,             // BNE *
+        // done:
+        0x00                    // BRK
+    }},
+
+    {"Store and read-modify-write addressing modes", 0x0400, 0x0525, {
+        0xA9, 0xA5,             // LDA #$A5
+        0xA2, 0x03,             // LDX #$03
+        0xA0, 0x07,             // LDY #$07
+        0x85, 0x40,             // STA $40
+        0x95, 0x40,             // STA $40,X
+        0x8D, 0x20, 0x03,       // STA $0320
+        0x9D, 0x20, 0x03,       // STA $0320,X
+        0x99, 0x20, 0x03,       // STA $0320,Y
+        0xA9, 0x50,             // LDA #$50 ; Pointer at $53 to $0350
+        0x85, 0x53,             // STA $53
+        0xA9, 0x03,             // LDA #$03
+        0x85, 0x54,             // STA $54
+        0xA9, 0x30,             // LDA #$30 ; Pointer at $56 to $0330
+        0x85, 0x56,             // STA $56
+        0xA9, 0x03,             // LDA #$03
+        0x85, 0x57,             // STA $57
+        0xA9, 0x5A,             // LDA #$5A
+        0x81, 0x50,             // STA ($50,X)
+        0x91, 0x56,             // STA ($56),Y
+        0x86, 0x44,             // STX $44
+        0x96, 0x44,             // STX $44,Y
+        0x8E, 0x40, 0x03,       // STX $0340
+        0x84, 0x45,             // STY $45
+        0x94, 0x45,             // STY $45,X
+        0x8C, 0x41, 0x03,       // STY $0341
+        0xA5, 0x40,             // LDA $40
+        0xC9, 0xA5,             // CMP #$A5
+        0xD0, 0xFE,             // BNE *
+        0xA5, 0x43,             // LDA $43
+        0xC9, 0xA5,             // CMP #$A5
+        0xD0, 0xFE,             // BNE *
+        0xAD, 0x20, 0x03,       // LDA $0320
+        0xC9, 0xA5,             // CMP #$A5
+        0xD0, 0xFE,             // BNE *
+        0xAD, 0x23, 0x03,       // LDA $0323
+        0xC9, 0xA5,             // CMP #$A5
+        0xD0, 0xFE,             // BNE *
+        0xAD, 0x27, 0x03,       // LDA $0327
+        0xC9, 0xA5,             // CMP #$A5
+        0xD0, 0xFE,             // BNE *
+        0xAD, 0x50, 0x03,       // LDA $0350
+        0xC9, 0x5A,             // CMP #$5A
+        0xD0, 0xFE,             // BNE *
+        0xAD, 0x37, 0x03,       // LDA $0337
+        0xC9, 0x5A,             // CMP #$5A
+        0xD0, 0xFE,             // BNE *
+        0xA5, 0x44,             // LDA $44
+        0xC9, 0x03,             // CMP #$03
+        0xD0, 0xFE,             // BNE *
+        0xA5, 0x4B,             // LDA $4B
+        0xC9, 0x03,             // CMP #$03
+        0xD0, 0xFE,             // BNE *
+        0xAD, 0x40, 0x03,       // LDA $0340
+        0xC9, 0x03,             // CMP #$03
+        0xD0, 0xFE,             // BNE *
+        0xA5, 0x45,             // LDA $45
+        0xC9, 0x07,             // CMP #$07
+        0xD0, 0xFE,             // BNE *
+        0xA5, 0x48,             // LDA $48
+        0xC9, 0x07,             // CMP #$07
+        0xD0, 0xFE,             // BNE *
+        0xAD, 0x41, 0x03,       // LDA $0341
+        0xC9, 0x07,             // CMP #$07
+        0xD0, 0xFE,             // BNE *
+        // Zero page stores wrap within page zero
+        0xA9, 0x99,             // LDA #$99
+        0xA2, 0xF0,             // LDX #$F0
+        0x95, 0x80,             // STA $80,X
+        0xA5, 0x70,             // LDA $70
+        0xC9, 0x99,             // CMP #$99
+        0xD0, 0xFE,             // BNE *
+        // Read-modify-write
+        0xA2, 0x03,             // LDX #$03
+        0xA9, 0x81,             // LDA #$81
+        0x85, 0x60,             // STA $60
+        0x85, 0x63,             // STA $63
+        0x8D, 0x60, 0x03,       // STA $0360
+        0x8D, 0x63, 0x03,       // STA $0363
+        0x06, 0x60,             // ASL $60
+        0x90, 0xFE,             // BCC *
+        0xA5, 0x60,             // LDA $60
+        0xC9, 0x02,             // CMP #$02
+        0xD0, 0xFE,             // BNE *
+        0x56, 0x60,             // LSR $60,X
+        0x90, 0xFE,             // BCC *
+        0xA5, 0x63,             // LDA $63
+        0xC9, 0x40,             // CMP #$40
+        0xD0, 0xFE,             // BNE *
+        0x18,                   // CLC
+        0x2E, 0x60, 0x03,       // ROL $0360
+        0x90, 0xFE,             // BCC *
+        0x7E, 0x60, 0x03,       // ROR $0360,X
+        0x90, 0xFE,             // BCC *
+        0xAD, 0x60, 0x03,       // LDA $0360
+        0xC9, 0x02,             // CMP #$02
+        0xD0, 0xFE,             // BNE *
+        0xAD, 0x63, 0x03,       // LDA $0363
+        0xC9, 0xC0,             // CMP #$C0
+        0xD0, 0xFE,             // BNE *
+        0xE6, 0x60,             // INC $60
+        0xD6, 0x60,             // DEC $60,X
+        0xEE, 0x60, 0x03,       // INC $0360
+        0xDE, 0x60, 0x03,       // DEC $0360,X
+        0xA5, 0x60,             // LDA $60
+        0xC9, 0x03,             // CMP #$03
+        0xD0, 0xFE,             // BNE *
+        0xA5, 0x63,             // LDA $63
+        0xC9, 0x3F,             // CMP #$3F
+        0xD0, 0xFE,             // BNE *
+        0xAD, 0x60, 0x03,       // LDA $0360
+        0xC9, 0x03,             // CMP #$03
+        0xD0, 0xFE,             // BNE *
+        0xAD, 0x63, 0x03,       // LDA $0363
+        0xC9, 0xBF,             // CMP #$BF
+        0xD0, 0xFE,             // BNE *
+        0xFE, 0x63, 0x03,       // INC $0363,X
+        0xC6, 0x60,             // DEC $60
+        0x16, 0x60,             // ASL $60,X
+        0x3E, 0x60, 0x03,       // ROL $0360,X
+        0x4E, 0x60, 0x03,       // LSR $0360
+        0x66, 0x60,             // ROR $60
+        0xAD, 0x66, 0x03,       // LDA $0366
+        0xC9, 0x01,             // CMP #$01
+        0xD0, 0xFE,             // BNE *
+        0xA5, 0x63,             // LDA $63
+        0xC9, 0x7E,             // CMP #$7E
+        0xD0, 0xFE,             // BNE *
+        // Accumulator
+        0xA9, 0x81,             // LDA #$81
+        0x0A,                   // ASL A
+        0x90, 0xFE,             // BCC *
+        0x6A,                   // ROR A
+        0xB0, 0xFE,             // BCS *
+        0x4A,                   // LSR A
+        0x90, 0xFE,             // BCC *
+        0x2A,                   // ROL A
+        0xB0, 0xFE,             // BCS *
+        0xC9, 0x81,             // CMP #$81
+        0xD0, 0xFE,             // BNE *
+        // done:
+        0x00                    // BRK
+    }},
+
+    {"ADC/SBC binary flags", 0x0400, 0x0464, {
+        0xD8,                   // CLD
+        0x18,                   // CLC
+        0xA9, 0x50,             // LDA #$50
+        0x69, 0x50,             // ADC #$50
+        0x50, 0xFE,             // BVC *
+        0xB0, 0xFE,             // BCS *
+        0x10, 0xFE,             // BPL *
+        0xC9, 0xA0,             // CMP #$A0
+        0xD0, 0xFE,             // BNE *
+        // Carry in causes the overflow
+        0x38,                   // SEC
+        0xA9, 0x7F,             // LDA #$7F
+        0x69, 0x00,             // ADC #$00
+        0x50, 0xFE,             // BVC *
+        0xC9, 0x80,             // CMP #$80
+        0xD0, 0xFE,             // BNE *
+        0x18,                   // CLC
+        0xA9, 0xFF,             // LDA #$FF
+        0x69, 0x01,             // ADC #$01
+        0xD0, 0xFE,             // BNE *
+        0x90, 0xFE,             // BCC *
+        0x70, 0xFE,             // BVS *
+        0x18,                   // CLC
+        0xA9, 0xD0,             // LDA #$D0
+        0x69, 0x90,             // ADC #$90
+        0x50, 0xFE,             // BVC *
+        0x90, 0xFE,             // BCC *
+        0xC9, 0x60,             // CMP #$60
+        0xD0, 0xFE,             // BNE *
+        0x38,                   // SEC
+        0xA9, 0x50,             // LDA #$50
+        0xE9, 0xB0,             // SBC #$B0
+        0x50, 0xFE,             // BVC *
+        0xB0, 0xFE,             // BCS *
+        0xC9, 0xA0,             // CMP #$A0
+        0xD0, 0xFE,             // BNE *
+        // Borrow in causes the overflow
+        0x18,                   // CLC
+        0xA9, 0x80,             // LDA #$80
+        0xE9, 0x00,             // SBC #$00
+        0x50, 0xFE,             // BVC *
+        0x90, 0xFE,             // BCC *
+        0xC9, 0x7F,             // CMP #$7F
+        0xD0, 0xFE,             // BNE *
+        0x38,                   // SEC
+        0xA9, 0x05,             // LDA #$05
+        0xE9, 0x05,             // SBC #$05
+        0xD0, 0xFE,             // BNE *
+        0x90, 0xFE,             // BCC *
+        0x70, 0xFE,             // BVS *
+        0x38,                   // SEC
+        0xA9, 0x05,             // LDA #$05
+        0xE9, 0x06,             // SBC #$06
+        0xB0, 0xFE,             // BCS *
+        0x10, 0xFE,             // BPL *
+        0xB8,                   // CLV
+        0x70, 0xFE,             // BVS *
+        // done:
+        0x00                    // BRK
+    }},
+
+    {"Compare, BIT, increment and transfer flags", 0x0400, 0x0480, {
+        0xA9, 0x40,             // LDA #$40
+        0xC9, 0x40,             // CMP #$40
+        0xD0, 0xFE,             // BNE *
+        0x90, 0xFE,             // BCC *
+        0xC9, 0x41,             // CMP #$41
+        0xB0, 0xFE,             // BCS *
+        0x10, 0xFE,             // BPL *
+        0xC9, 0x3F,             // CMP #$3F
+        0x90, 0xFE,             // BCC *
+        0xF0, 0xFE,             // BEQ *
+        0x30, 0xFE,             // BMI *
+        0xA2, 0x10,             // LDX #$10
+        0xE0, 0x20,             // CPX #$20
+        0xB0, 0xFE,             // BCS *
+        0x10, 0xFE,             // BPL *
+        0xA0, 0x80,             // LDY #$80
+        0xC0, 0x10,             // CPY #$10
+        0x90, 0xFE,             // BCC *
+        0x30, 0xFE,             // BMI *
+        0xA9, 0xC0,             // LDA #$C0
+        0x85, 0x10,             // STA $10
+        0xA9, 0x0F,             // LDA #$0F
+        0x24, 0x10,             // BIT $10
+        0x10, 0xFE,             // BPL *
+        0x50, 0xFE,             // BVC *
+        0xD0, 0xFE,             // BNE *
+        0xA9, 0x40,             // LDA #$40
+        0x8D, 0x10, 0x03,       // STA $0310
+        0x2C, 0x10, 0x03,       // BIT $0310
+        0x30, 0xFE,             // BMI *
+        0x50, 0xFE,             // BVC *
+        0xF0, 0xFE,             // BEQ *
+        0xA2, 0xFF,             // LDX #$FF
+        0xE8,                   // INX
+        0xD0, 0xFE,             // BNE *
+        0xCA,                   // DEX
+        0x10, 0xFE,             // BPL *
+        0xA0, 0x01,             // LDY #$01
+        0x88,                   // DEY
+        0xD0, 0xFE,             // BNE *
+        0xC8,                   // INY
+        0xF0, 0xFE,             // BEQ *
+        0xA9, 0x00,             // LDA #$00
+        0xAA,                   // TAX
+        0xD0, 0xFE,             // BNE *
+        0xA9, 0x80,             // LDA #$80
+        0xA8,                   // TAY
+        0x10, 0xFE,             // BPL *
+        0xA2, 0x00,             // LDX #$00
+        0x8A,                   // TXA
+        0xD0, 0xFE,             // BNE *
+        0x98,                   // TYA
+        0x10, 0xFE,             // BPL *
+        0xBA,                   // TSX
+        0x10, 0xFE,             // BPL *
+        // TXS leaves flags alone
+        0xA2, 0x00,             // LDX #$00
+        0x9A,                   // TXS
+        0xD0, 0xFE,             // BNE *
+        0xBA,                   // TSX
+        0xD0, 0xFE,             // BNE *
+        0xA2, 0xFF,             // LDX #$FF
+        0x9A,                   // TXS
+        0x38,                   // SEC
+        0xF8,                   // SED
+        0x78,                   // SEI
+        0x18,                   // CLC
+        0xB0, 0xFE,             // BCS *
+        0xD8,                   // CLD
+        0x58,                   // CLI
+        0x08,                   // PHP
+        0x68,                   // PLA
+        0x29, 0x0C,             // AND #$0C
+        0xD0, 0xFE,             // BNE *
+        // done:
+        0x00                    // BRK
+    }},
+
+    #ifndef CPU_2A03
+    {"Decimal mode", 0x0400, 0x0440, {
+        0xF8,                   // SED
+        0x18,                   // CLC
+        0xA9, 0x19,             // LDA #$19
+        0x69, 0x01,             // ADC #$01
+        0xB0, 0xFE,             // BCS *
+        0xC9, 0x20,             // CMP #$20
+        0xD0, 0xFE,             // BNE *
+        0x18,                   // CLC
+        0xA9, 0x99,             // LDA #$99
+        0x69, 0x01,             // ADC #$01
+        0x90, 0xFE,             // BCC *
+        0xC9, 0x00,             // CMP #$00
+        0xD0, 0xFE,             // BNE *
+        0x38,                   // SEC
+        0xA9, 0x25,             // LDA #$25
+        0x69, 0x48,             // ADC #$48
+        0xC9, 0x74,             // CMP #$74
+        0xD0, 0xFE,             // BNE *
+        0x38,                   // SEC
+        0xA9, 0x20,             // LDA #$20
+        0xE9, 0x01,             // SBC #$01
+        0x90, 0xFE,             // BCC *
+        0xC9, 0x19,             // CMP #$19
+        0xD0, 0xFE,             // BNE *
+        0x38,                   // SEC
+        0xA9, 0x00,             // LDA #$00
+        0xE9, 0x01,             // SBC #$01
+        0xB0, 0xFE,             // BCS *
+        0xC9, 0x99,             // CMP #$99
+        0xD0, 0xFE,             // BNE *
+        0x18,                   // CLC
+        0xA9, 0x50,             // LDA #$50
+        0xE9, 0x25,             // SBC #$25
+        0xC9, 0x24,             // CMP #$24
+        0xD0, 0xFE,             // BNE *
+        0xD8,                   // CLD
+        // done:
+        0x00                    // BRK
+    }},
+    #endif
+
+    {"Stack wraparound, JSR/RTS and PHP/PLP", 0x0400, 0x0452, {
+        0xA2, 0x01,             // LDX #$01
+        0x9A,                   // TXS
+        0xA9, 0x11,             // LDA #$11
+        0x48,                   // PHA
+        0xA9, 0x22,             // LDA #$22
+        0x48,                   // PHA
+        0xA9, 0x33,             // LDA #$33
+        0x48,                   // PHA
+        0xBA,                   // TSX
+        0xE0, 0xFE,             // CPX #$FE
+        0xD0, 0xFE,             // BNE *
+        0xAD, 0x01, 0x01,       // LDA $0101
+        0xC9, 0x11,             // CMP #$11
+        0xD0, 0xFE,             // BNE *
+        0xAD, 0x00, 0x01,       // LDA $0100
+        0xC9, 0x22,             // CMP #$22
+        0xD0, 0xFE,             // BNE *
+        0xAD, 0xFF, 0x01,       // LDA $01FF
+        0xC9, 0x33,             // CMP #$33
+        0xD0, 0xFE,             // BNE *
+        0x68,                   // PLA
+        0xC9, 0x33,             // CMP #$33
+        0xD0, 0xFE,             // BNE *
+        0x68,                   // PLA
+        0xC9, 0x22,             // CMP #$22
+        0xD0, 0xFE,             // BNE *
+        0x68,                   // PLA
+        0xC9, 0x11,             // CMP #$11
+        0xD0, 0xFE,             // BNE *
+        0xBA,                   // TSX
+        0xE0, 0x01,             // CPX #$01
+        0xD0, 0xFE,             // BNE *
+        // JSR pushing across the wrap
+        0xA2, 0x00,             // LDX #$00
+        0x9A,                   // TXS
+        0x20, 0x53, 0x04,       // JSR sub
+        0xBA,                   // TSX
+        0xE0, 0x00,             // CPX #$00
+        0xD0, 0xFE,             // BNE *
+        // PHP always pushes B and bit 5 set
+        0xA2, 0xFF,             // LDX #$FF
+        0x9A,                   // TXS
+        0xA9, 0x00,             // LDA #$00
+        0x48,                   // PHA
+        0x28,                   // PLP
+        0x08,                   // PHP
+        0x68,                   // PLA
+        0xC9, 0x30,             // CMP #$30
+        0xD0, 0xFE,             // BNE *
+        // done:
+        0x00,                   // BRK
+        // sub:
+        0xBA,                   // TSX
+        0xE0, 0xFE,             // CPX #$FE
+        0xD0, 0xFE,             // BNE *
+        0xAD, 0x00, 0x01,       // LDA $0100
+        0xC9, 0x04,             // CMP #>sub
+        0xD0, 0xFE,             // BNE *
+        0x60                    // RTS
+    }},
+
+    #ifndef CPU_65C02
+    {"JMP indirect page wrap and RTI", 0x0400, 0x0440, {
+        // The pointer's high byte comes from the start of the same page
+        0xA9, 0x15,             // LDA #<good
+        0x8D, 0xFF, 0x02,       // STA $02FF
+        0xA9, 0x04,             // LDA #>good
+        0x8D, 0x00, 0x02,       // STA $0200
+        0xA9, 0xEE,             // LDA #$EE
+        0x8D, 0x00, 0x03,       // STA $0300
+        0x6C, 0xFF, 0x02,       // JMP ($02FF)
+        0x4C, 0x12, 0x04,       // JMP *
+        // good:
+        0xA9, 0x25,             // LDA #<good2
+        0x8D, 0x10, 0x02,       // STA $0210
+        0xA9, 0x04,             // LDA #>good2
+        0x8D, 0x11, 0x02,       // STA $0211
+        0x6C, 0x10, 0x02,       // JMP ($0210)
+        0x4C, 0x22, 0x04,       // JMP *
+        // good2:
+        // RTI pulls the status then the return address
+        0xA9, 0x04,             // LDA #>good3
+        0x48,                   // PHA
+        0xA9, 0x32,             // LDA #<good3
+        0x48,                   // PHA
+        0xA9, 0xC3,             // LDA #$C3
+        0x48,                   // PHA
+        0x40,                   // RTI
+        0x4C, 0x2F, 0x04,       // JMP *
+        // good3:
+        0x10, 0xFE,             // BPL *
+        0x50, 0xFE,             // BVC *
+        0xD0, 0xFE,             // BNE *
+        0x90, 0xFE,             // BCC *
+        0x4C, 0x40, 0x04,       // JMP good4
+        0x4C, 0x3D, 0x04,       // JMP *
+        // good4:
+        // done:
+        0x00                    // BRK
+    }},
+    #endif
+
+    {"Branches", 0x0400, 0x0453, {
+        0xA9, 0x00,             // LDA #$00
+        0xD0, 0xFE,             // BNE *
+        0xF0, 0x03,             // BEQ b1
+        0x4C, 0x06, 0x04,       // JMP *
+        // b1:
+        0x30, 0xFE,             // BMI *
+        0x10, 0x03,             // BPL b2
+        0x4C, 0x0D, 0x04,       // JMP *
+        // b2:
+        0x38,                   // SEC
+        0x90, 0xFE,             // BCC *
+        0xB0, 0x03,             // BCS b3
+        0x4C, 0x15, 0x04,       // JMP *
+        // b3:
+        0xB8,                   // CLV
+        0x70, 0xFE,             // BVS *
+        0x50, 0x03,             // BVC b4
+        0x4C, 0x1D, 0x04,       // JMP *
+        // b4:
+        0xA9, 0x80,             // LDA #$80
+        0x10, 0xFE,             // BPL *
+        0x30, 0x03,             // BMI b5
+        0x4C, 0x26, 0x04,       // JMP *
+        // b5:
+        0x18,                   // CLC
+        0xB0, 0xFE,             // BCS *
+        0x90, 0x03,             // BCC b6
+        0x4C, 0x2E, 0x04,       // JMP *
+        // b6:
+        0xA9, 0x01,             // LDA #$01
+        0xF0, 0xFE,             // BEQ *
+        0xD0, 0x03,             // BNE b7
+        0x4C, 0x37, 0x04,       // JMP *
+        // b7:
+        0xA9, 0x40,             // LDA #$40
+        0x85, 0x10,             // STA $10
+        0x24, 0x10,             // BIT $10
+        0x50, 0xFE,             // BVC *
+        0x70, 0x03,             // BVS b8
+        0x4C, 0x44, 0x04,       // JMP *
+        // b8:
+        // Backward branches
+        0xA2, 0x05,             // LDX #$05
+        0xA0, 0x00,             // LDY #$00
+        // loop:
+        0xC8,                   // INY
+        0xCA,                   // DEX
+        0xD0, 0xFC,             // BNE loop
+        0xC0, 0x05,             // CPY #$05
+        0xD0, 0xFE,             // BNE *
+        // done:
+        0x00                    // BRK
+    }},
+
+    #ifndef CPU_65C02
+    {"Undocumented NMOS opcodes", 0x0400, 0x0494, {
+        0xA9, 0x5A,             // LDA #$5A
+        0x85, 0x20,             // STA $20
+        0xA7, 0x20,             // LAX $20
+        0xE0, 0x5A,             // CPX #$5A
+        0xD0, 0xFE,             // BNE *
+        0xC9, 0x5A,             // CMP #$5A
+        0xD0, 0xFE,             // BNE *
+        0xA9, 0xF0,             // LDA #$F0
+        0xA2, 0x3C,             // LDX #$3C
+        0x87, 0x21,             // SAX $21
+        0xA5, 0x21,             // LDA $21
+        0xC9, 0x30,             // CMP #$30
+        0xD0, 0xFE,             // BNE *
+        0xA9, 0x05,             // LDA #$05
+        0x85, 0x22,             // STA $22
+        0xA9, 0x04,             // LDA #$04
+        0xC7, 0x22,             // DCP $22
+        0xD0, 0xFE,             // BNE *
+        0x90, 0xFE,             // BCC *
+        0xA5, 0x22,             // LDA $22
+        0xC9, 0x04,             // CMP #$04
+        0xD0, 0xFE,             // BNE *
+        0xA9, 0x10,             // LDA #$10
+        0x85, 0x23,             // STA $23
+        0x38,                   // SEC
+        0xA9, 0x20,             // LDA #$20
+        0xE7, 0x23,             // ISC $23
+        0xC9, 0x0F,             // CMP #$0F
+        0xD0, 0xFE,             // BNE *
+        0xA9, 0x81,             // LDA #$81
+        0x85, 0x24,             // STA $24
+        0xA9, 0x02,             // LDA #$02
+        0x07, 0x24,             // SLO $24
+        0x90, 0xFE,             // BCC *
+        0xC9, 0x02,             // CMP #$02
+        0xD0, 0xFE,             // BNE *
+        0xA9, 0xC0,             // LDA #$C0
+        0x85, 0x25,             // STA $25
+        0x18,                   // CLC
+        0xA9, 0xFF,             // LDA #$FF
+        0x27, 0x25,             // RLA $25
+        0x90, 0xFE,             // BCC *
+        0xC9, 0x80,             // CMP #$80
+        0xD0, 0xFE,             // BNE *
+        0xA9, 0x03,             // LDA #$03
+        0x85, 0x26,             // STA $26
+        0xA9, 0xFF,             // LDA #$FF
+        0x47, 0x26,             // SRE $26
+        0x90, 0xFE,             // BCC *
+        0xC9, 0xFE,             // CMP #$FE
+        0xD0, 0xFE,             // BNE *
+        0xA9, 0x02,             // LDA #$02
+        0x85, 0x27,             // STA $27
+        0x38,                   // SEC
+        0xA9, 0x10,             // LDA #$10
+        0x67, 0x27,             // RRA $27
+        0xC9, 0x91,             // CMP #$91
+        0xD0, 0xFE,             // BNE *
+        0xA9, 0x81,             // LDA #$81
+        0x0B, 0x80,             // ANC #$80
+        0x90, 0xFE,             // BCC *
+        0xA9, 0x03,             // LDA #$03
+        0x4B, 0xFF,             // ALR #$FF
+        0x90, 0xFE,             // BCC *
+        0xC9, 0x01,             // CMP #$01
+        0xD0, 0xFE,             // BNE *
+        0xA9, 0x0F,             // LDA #$0F
+        0xA2, 0xFC,             // LDX #$FC
+        0xCB, 0x04,             // AXS #$04
+        0x90, 0xFE,             // BCC *
+        0xE0, 0x08,             // CPX #$08
+        0xD0, 0xFE,             // BNE *
+        // Undocumented NOPs still take their operands
+        0x80, 0xFF,             // NOP #$FF
+        0x04, 0x20,             // NOP $20
+        0x1C, 0x00, 0x03,       // NOP $0300,X
+        // done:
+        0x00                    // BRK
+    }},
+    #else
+    {"65C02 opcodes and (ZP) mode", 0x0400, 0x04B2, {
+        0xA9, 0x12,             // LDA #$12
+        0xA2, 0x34,             // LDX #$34
+        0xA0, 0x56,             // LDY #$56
+        0xDA,                   // PHX
+        0x5A,                   // PHY
+        0x48,                   // PHA
+        0xFA,                   // PLX
+        0x7A,                   // PLY
+        0xE0, 0x12,             // CPX #$12
+        0xD0, 0xFE,             // BNE *
+        0xC0, 0x56,             // CPY #$56
+        0xD0, 0xFE,             // BNE *
+        0x68,                   // PLA
+        0xC9, 0x34,             // CMP #$34
+        0xD0, 0xFE,             // BNE *
+        0xA9, 0xFF,             // LDA #$FF
+        0x85, 0x30,             // STA $30
+        0x8D, 0x30, 0x03,       // STA $0330
+        0x64, 0x30,             // STZ $30
+        0x9C, 0x30, 0x03,       // STZ $0330
+        0xA5, 0x30,             // LDA $30
+        0xD0, 0xFE,             // BNE *
+        0xAD, 0x30, 0x03,       // LDA $0330
+        0xD0, 0xFE,             // BNE *
+        // (ZP) mode
+        0xA9, 0x40,             // LDA #$40
+        0x85, 0x32,             // STA $32
+        0xA9, 0x03,             // LDA #$03
+        0x85, 0x33,             // STA $33
+        0xA9, 0x77,             // LDA #$77
+        0x92, 0x32,             // STA ($32)
+        0xA9, 0x00,             // LDA #$00
+        0xB2, 0x32,             // LDA ($32)
+        0xC9, 0x77,             // CMP #$77
+        0xD0, 0xFE,             // BNE *
+        0xA9, 0x0F,             // LDA #$0F
+        0x85, 0x34,             // STA $34
+        0xA9, 0x30,             // LDA #$30
+        0x04, 0x34,             // TSB $34
+        0xD0, 0xFE,             // BNE *
+        0xA9, 0x03,             // LDA #$03
+        0x14, 0x34,             // TRB $34
+        0xF0, 0xFE,             // BEQ *
+        0xA5, 0x34,             // LDA $34
+        0xC9, 0x3C,             // CMP #$3C
+        0xD0, 0xFE,             // BNE *
+        0xA9, 0x01,             // LDA #$01
+        0x1A,                   // INC A
+        0x3A,                   // DEC A
+        0x3A,                   // DEC A
+        0xD0, 0xFE,             // BNE *
+        // BIT immediate only sets Z
+        0xA9, 0x40,             // LDA #$40
+        0xB8,                   // CLV
+        0x89, 0xC0,             // BIT #$C0
+        0x70, 0xFE,             // BVS *
+        0x30, 0xFE,             // BMI *
+        0xF0, 0xFE,             // BEQ *
+        0xA9, 0x00,             // LDA #$00
+        0x85, 0x35,             // STA $35
+        0xB7, 0x35,             // SMB3 $35
+        0x3F, 0x35, 0xFD,       // BBR3 $35,*
+        0xBF, 0x35, 0x03,       // BBS3 $35,ok1
+        0x4C, 0x75, 0x04,       // JMP *
+        // ok1:
+        0x37, 0x35,             // RMB3 $35
+        0xBF, 0x35, 0xFD,       // BBS3 $35,*
+        0x80, 0x03,             // BRA ok2
+        0x4C, 0x7F, 0x04,       // JMP *
+        // ok2:
+        0xA9, 0x94,             // LDA #<ok3
+        0x8D, 0x52, 0x03,       // STA $0352
+        0xA9, 0x04,             // LDA #>ok3
+        0x8D, 0x53, 0x03,       // STA $0353
+        0xA2, 0x02,             // LDX #$02
+        0x7C, 0x50, 0x03,       // JMP ($0350,X)
+        0x4C, 0x91, 0x04,       // JMP *
+        // ok3:
+        // JMP ($xxFF) reads the high byte from the next page
+        0xA9, 0xA9,             // LDA #<ok4
+        0x8D, 0xFF, 0x02,       // STA $02FF
+        0xA9, 0x04,             // LDA #>ok4
+        0x8D, 0x00, 0x03,       // STA $0300
+        0xA9, 0xEE,             // LDA #$EE
+        0x8D, 0x00, 0x02,       // STA $0200
+        0x6C, 0xFF, 0x02,       // JMP ($02FF)
+        0x4C, 0xA6, 0x04,       // JMP *
+        // ok4:
+        // Decimal mode sets Z from the decimal result
+        0xF8,                   // SED
+        0x18,                   // CLC
+        0xA9, 0x99,             // LDA #$99
+        0x69, 0x01,             // ADC #$01
+        0xD0, 0xFE,             // BNE *
+        0xD8,                   // CLD
+        // done:
+        0x00                    // BRK
+    }},
+    #endif
+
+    // Through the devices and IRQs (see io.h)
+    {"Timer IRQ ending an idle loop", 0x0400, 0x0440, {
+        // Timer 1 one-shot with its IRQ on, the handler below sets $10 and counts itself in $11
+        0xA9, 0x41,             // LDA #<irq
+        0x8D, 0xFE, 0xFF,       // STA $FFFE
+        0xA9, 0x04,             // LDA #>irq
+        0x8D, 0xFF, 0xFF,       // STA $FFFF
+        0xA9, 0x00,             // LDA #$00
+        0x8D, 0x0B, 0x90,       // STA $900B
+        0xA9, 0xC0,             // LDA #$C0
+        0x8D, 0x0E, 0x90,       // STA $900E
+        // Fill $0300-$03FF meanwhile, through fused pairs
+        0xA2, 0x00,             // LDX #$00
+        // fill:
+        0x8A,                   // TXA
+        0x9D, 0x00, 0x03,       // STA $0300,X
+        0xE8,                   // INX
+        0xD0, 0xF9,             // BNE fill
+        // Start timer 1 at $4000 cycles and wait for it
+        0xA9, 0x00,             // LDA #$00
+        0x8D, 0x04, 0x90,       // STA $9004
+        0xA9, 0x40,             // LDA #$40
+        0x8D, 0x05, 0x90,       // STA $9005
+        0x58,                   // CLI
+        // poll:
+        0xA5, 0x10,             // LDA $10
+        0xF0, 0xFC,             // BEQ poll
+        0x78,                   // SEI
+        0xA5, 0x10,             // LDA $10
+        0xC9, 0x5A,             // CMP #$5A
+        0xD0, 0xFE,             // BNE *
+        0xA5, 0x11,             // LDA $11
+        0xC9, 0x01,             // CMP #$01
+        0xD0, 0xFE,             // BNE *
+        0xAD, 0x80, 0x03,       // LDA $0380
+        0xC9, 0x80,             // CMP #$80
+        0xD0, 0xFE,             // BNE *
+        // done:
+        0x00,                   // BRK
+        // irq:
+        0xAD, 0x04, 0x90,       // LDA $9004
+        0xE6, 0x11,             // INC $11
+        0xA9, 0x5A,             // LDA #$5A
+        0x85, 0x10,             // STA $10
+        0x40                    // RTI
+    }, true},
+
+    #ifdef CPU_65C02
+    {"Timer IRQ ending WAI", 0x0400, 0x043D, {
+        // Timer 1 one-shot with its IRQ on, the handler below sets $10 and counts itself in $11
+        0xA9, 0x3E,             // LDA #<irq
+        0x8D, 0xFE, 0xFF,       // STA $FFFE
+        0xA9, 0x04,             // LDA #>irq
+        0x8D, 0xFF, 0xFF,       // STA $FFFF
+        0xA9, 0x00,             // LDA #$00
+        0x8D, 0x0B, 0x90,       // STA $900B
+        0xA9, 0xC0,             // LDA #$C0
+        0x8D, 0x0E, 0x90,       // STA $900E
+        // Fill $0300-$03FF meanwhile, through fused pairs
+        0xA2, 0x00,             // LDX #$00
+        // fill:
+        0x8A,                   // TXA
+        0x9D, 0x00, 0x03,       // STA $0300,X
+        0xE8,                   // INX
+        0xD0, 0xF9,             // BNE fill
+        // Start timer 1 at $4000 cycles and wait for it
+        0xA9, 0x00,             // LDA #$00
+        0x8D, 0x04, 0x90,       // STA $9004
+        0xA9, 0x40,             // LDA #$40
+        0x8D, 0x05, 0x90,       // STA $9005
+        0x58,                   // CLI
+        0xCB,                   // WAI
+        0x78,                   // SEI
+        0xA5, 0x10,             // LDA $10
+        0xC9, 0x5A,             // CMP #$5A
+        0xD0, 0xFE,             // BNE *
+        0xA5, 0x11,             // LDA $11
+        0xC9, 0x01,             // CMP #$01
+        0xD0, 0xFE,             // BNE *
+        0xAD, 0x80, 0x03,       // LDA $0380
+        0xC9, 0x80,             // CMP #$80
+        0xD0, 0xFE,             // BNE *
+        // done:
+        0x00,                   // BRK
+        // irq:
+        0xAD, 0x04, 0x90,       // LDA $9004
+        0xE6, 0x11,             // INC $11
+        0xA9, 0x5A,             // LDA #$5A
+        0x85, 0x10,             // STA $10
+        0x40                    // RTI
+    }, true},
+    #endif
+};
+
+enum ConformanceResult { C_PASS, C_TRAP, C_BREAK, C_LIMIT, C_DIFFER };
+
+// VIA registers for the programs using one, and cycles any program ends well within
+#define CONFORMANCE_VIA 0x9000
+#define CONFORMANCE_CYCLES 10000000
+
+// Ways through the instruction loop, each must leave the same machine as the first (every instruction run on its own)
+struct ConformanceMode {
+    const char* name;
+    bool fuse, idle;
+};
+
+const ConformanceMode conformance_modes[] = {
+    {"neither", false, false},
+    {"fusion (without --nf)", true, false},
+    {"idle skipping (without --ni)", false, true},
+    {"fusion and idle skipping", true, true}
+};
+
+// Take the last program's devices off, and attach a VIA if this one uses it
+void conformance_devices(const ConformanceTest& test) {
+    devices.clear();
+    memset(io_pages, 0, sizeof(io_pages));
+    watching = false;
+    irq_sources = 0;
+    next_event = ~0ull;
+
+    if (test.via) {
+        via_start = CONFORMANCE_VIA;
+        via_end = CONFORMANCE_VIA + 0x10;
+        via_attach();
+    }
+}
+
+// Reset the machine and load a program
+void conformance_load(const ConformanceTest& test) {
+    memset(memory, 0, 0x10000);
+    memcpy(&memory[test.origin], test.code.data(), test.code.size());
+
+    a = x = y = 0;
+    sp = 0xFF;
+    sr = StatusRegister();
+    pc = test.origin;
+    cycles = 0;
+
+    conformance_devices(test);
+}
+
+// Run a loaded program through the instruction loop, leaving at where it stopped (instructions counts them)
+ConformanceResult conformance_run(const ConformanceTest& test, byte2& at) {
+    at = pc;
+    instructions = 0;
+    stop_reason = STOP_BRK;
+    budget_start();
+
+    if (run(at, 0) == BRK_MOVE) return at == test.done ? C_PASS : C_BREAK;
+
+    return stop_reason == STOP_HANG ? C_TRAP : C_LIMIT;
+}
+
+// What a program left: registers, counts and memory
+std::vector<byte> conformance_state() {
+    std::vector<byte> state = {a, x, y, sp, sr.val(), (byte)pc, (byte)(pc >> 8)};
+    unsigned long long counts[] = {cycles, instructions};
+
+    state.insert(state.end(), (byte*)counts, (byte*)(counts + 2));
+    state.insert(state.end(), memory, memory + 0x10000);
+
+    return state;
+}
+
+// Run every program, returns the amount that failed
+int conformance() {
+    const char* results[] = {"PASS", "FAIL", "FAIL", "FAIL", "FAIL"};
+    const char* reasons[] = {"", "trapped at", "BRK at", "no end at", "differs with"};
+    int failed = 0;
+
+    // Keep output of the programs quiet
+    ins_print = false;
+    print_out = false;
+    brk_stop = false;
+
+    // Stop programs that never end
+    budgeting = true;
+    max_instructions = 0;
+    max_cycles = CONFORMANCE_CYCLES;
+    max_seconds = 0;
+
+    fuse_init();
+
+    printf("Conformance tests:\n");
+
+    for (const ConformanceTest& test : conformance_tests) {
+        ConformanceResult result = C_PASS;
+        byte2 stopped = 0;
+        unsigned long long count = 0;
+        std::vector<byte> expected;
+        const char* differs = NULL;
+
+        for (const ConformanceMode& mode : conformance_modes) {
+            fusing = mode.fuse;
+            idling = mode.idle;
+
+            conformance_load(test);
+            ConformanceResult ran = conformance_run(test, stopped);
+
+            if (expected.empty()) {
+                result = ran;
+                count = instructions;
+                expected = conformance_state();
+
+                if (result != C_PASS) break;
+            } else if (ran != C_PASS || conformance_state() != expected) {
+                result = C_DIFFER;
+                differs = mode.name;
+                break;
+            }
+        }
+
+        // Repeat passing programs for a while to measure speed, putting back only the pages they wrote in between
+        unsigned long long total = 0;
+        double elapsed = 0;
+
+        if (result == C_PASS && !test.via) {
+            conformance_load(test);
+            machine_snapshot();
+
+            std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
+            while (elapsed < 0.02) {
+                machine_reset();
+                conformance_run(test, stopped);
+                total += instructions;
+
+                elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            }
+        }
+
+        printf("  %s  %-46s %6llu instructions", results[result], test.name, count);
+
+        if (result == C_DIFFER) printf("  %s %s\n", reasons[result], differs);
+        else if (result != C_PASS) printf("  %s %04X\n", reasons[result], stopped);
+        else if (total) printf("  %8.2f Mins/s\n", total / elapsed / 1e6);
+        else printf("\n");
+
+        failed += result != C_PASS;
+    }
+
+    printf("%d of %d passed.\n", (int)conformance_tests.size() - failed, (int)conformance_tests.size());
+
+    return failed;
+}
@@ -0,0 +1,293 @@
+#include <vector>
+
+/* debug.h
+  Contains breakpoints, watchpoints and register conditions.
+*/
+
+// Any breakpoint, watchpoint or condition set (checked once per instruction)
+bool debugging = false;
+// Any watchpoint, device or trace set (checked by the addressing modes)
+bool watching = false;
+bool watchpoints = false;   // Or a trace (both see every access through watch_check)
+
+void trace_access(byte2 addr, byte opcode);
+void trace_bulk(byte2 addr, int len);
+
+// Bitmaps over the address space
+unsigned long long break_bits[0x10000 / 64] = {};
+unsigned long long read_bits[0x10000 / 64] = {};
+unsigned long long write_bits[0x10000 / 64] = {};
+
+inline bool bit_test(unsigned long long* bits, byte2 addr) {
+    return bits[addr >> 6] >> (addr & 63) & 1;
+}
+
+inline void bit_set(unsigned long long* bits, byte2 addr) {
+    bits[addr >> 6] |= 1ull << (addr & 63);
+}
+
+inline void bit_clear(unsigned long long* bits, byte2 addr) {
+    bits[addr >> 6] &= ~(1ull << (addr & 63));
+}
+
+// Condition on a register value (such as "x==3" or "sr&0x80")
+struct Condition {
+    char reg;   // 'a', 'x', 'y', 's' (sp), 'p' (sr), 'c' (pc)
+    char op;    // '=', '!', '<', 'l' (<=), '>', 'g' (>=), '&'
+    int value;
+    string text;
+
+    bool test() {
+        int val = 0;
+
+        switch (reg) {
+            case 'a': val = a; break;
+            case 'x': val = x; break;
+            case 'y': val = y; break;
+            case 's': val = sp; break;
+            case 'p': val = sr.val(); break;
+            case 'c': val = pc; break;
+        }
+
+        switch (op) {
+            case '=': return val == value;
+            case '!': return val != value;
+            case '<': return val < value;
+            case 'l': return val <= value;
+            case '>': return val > value;
+            case 'g': return val >= value;
+            case '&': return val & value;
+        }
+
+        return false;
+    }
+};
+
+// Conditions for breakpoints on an address (none means always break)
+std::vector<std::pair<byte2, Condition>> break_conds;
+// Conditions checked on every instruction
+std::vector<Condition> global_conds;
+
+// Address whose breakpoint is let through on the next check (resuming from a stop there)
+int break_skip = -1;
+
+// Last watchpoint hit
+bool watch_hit = false;
+byte2 watch_addr;
+bool watch_write;
+
+// Parse number (prefix with "0x" for hex)
+bool parse_num(string str, int& out) {
+    try {
+        size_t end;
+
+        if (str.substr(0, 2) == "0x") out = std::stoul(str, &end, 16);
+        else out = std::stoul(str, &end, 10);
+
+        return end == str.length();
+    } catch (...) {
+        return false;
+    }
+}
+
+bool parse_cond(string str, Condition& cond) {
+    const char* tokens[] = {"==", "!=", "<=", ">=", "<", ">", "&"};
+    const char codes[] = {'=', '!', 'l', 'g', '<', '>', '&'};
+
+    for (int i = 0; i < 7; i++) {
+        size_t at = str.find(tokens[i]);
+
+        if (at == string::npos) continue;
+
+        string reg = str.substr(0, at);
+
+        if (reg == "a" || reg == "x" || reg == "y") cond.reg = reg[0];
+        else if (reg == "sp") cond.reg = 's';
+        else if (reg == "sr") cond.reg = 'p';
+        else if (reg == "pc") cond.reg = 'c';
+        else return false;
+
+        cond.op = codes[i];
+        cond.text = str;
+
+        return parse_num(str.substr(at + string(tokens[i]).length()), cond.value);
+    }
+
+    return false;
+}
+
+// Add a breakpoint from "addr" or "addr:condition"
+bool add_breakpoint(string str) {
+    size_t colon = str.find(':');
+    int addr;
+
+    if (!parse_num(str.substr(0, colon), addr) || addr > 0xFFFF) return false;
+
+    if (colon != string::npos) {
+        Condition cond;
+
+        if (!parse_cond(str.substr(colon + 1), cond)) return false;
+
+        break_conds.push_back({(byte2)addr, cond});
+    }
+
+    bit_set(break_bits, addr);
+    debugging = true;
+
+    return true;
+}
+
+bool add_condition(string str) {
+    Condition cond;
+
+    if (!parse_cond(str, cond)) return false;
+
+    global_conds.push_back(cond);
+    debugging = true;
+
+    return true;
+}
+
+// Add a watchpoint from "addr" or "start-end"
+bool add_watchpoint(string str, bool write) {
+    size_t dash = str.find('-');
+    int start, end;
+
+    if (!parse_num(str.substr(0, dash), start)) return false;
+
+    if (dash == string::npos) end = start;
+    else if (!parse_num(str.substr(dash + 1), end)) return false;
+
+    if (start > end || end > 0xFFFF) return false;
+
+    for (int addr = start; addr <= end; addr++) {
+        bit_set(write ? write_bits : read_bits, addr);
+    }
+
+    debugging = watching = watchpoints = true;
+
+    return true;
+}
+
+enum AccessKind { ACCESS_READ, ACCESS_WRITE, ACCESS_MODIFY, ACCESS_NONE };
+
+// How an opcode uses the memory its addressing mode gives
+AccessKind access_kind(byte opcode) {
+    switch (opcode) {
+        case 0x81: case 0x84: case 0x85: case 0x86: case 0x8C: case 0x8D: case 0x8E: // Stores
+        case 0x91: case 0x94: case 0x95: case 0x96: case 0x99: case 0x9D:
+        #if defined(CPU_65C02)
+        case 0x64: case 0x74: case 0x92: case 0x9C: case 0x9E:                         // STZ, STA (ZP)
+        #else
+        case 0x83: case 0x87: case 0x8F: case 0x97: case 0x93: case 0x9B: case 0x9C: case 0x9E: case 0x9F: // SAX, SHA, TAS, SHY, SHX
+        #endif
+            return ACCESS_WRITE;
+
+        case 0x06: case 0x0E: case 0x16: case 0x1E: case 0x26: case 0x2E: case 0x36: case 0x3E: // Read-modify-write
+        case 0x46: case 0x4E: case 0x56: case 0x5E: case 0x66: case 0x6E: case 0x76: case 0x7E:
+        case 0xC6: case 0xCE: case 0xD6: case 0xDE: case 0xE6: case 0xEE: case 0xF6: case 0xFE:
+        #if defined(CPU_65C02)
+        case 0x04: case 0x0C: case 0x14: case 0x1C:                                     // TSB, TRB
+        case 0x07: case 0x17: case 0x27: case 0x37: case 0x47: case 0x57: case 0x67: case 0x77: // RMB
+        case 0x87: case 0x97: case 0xA7: case 0xB7: case 0xC7: case 0xD7: case 0xE7: case 0xF7: // SMB
+        #else
+        case 0x03: case 0x07: case 0x0F: case 0x13: case 0x17: case 0x1B: case 0x1F:   // SLO
+        case 0x23: case 0x27: case 0x2F: case 0x33: case 0x37: case 0x3B: case 0x3F:   // RLA
+        case 0x43: case 0x47: case 0x4F: case 0x53: case 0x57: case 0x5B: case 0x5F:   // SRE
+        case 0x63: case 0x67: case 0x6F: case 0x73: case 0x77: case 0x7B: case 0x7F:   // RRA
+        case 0xC3: case 0xC7: case 0xCF: case 0xD3: case 0xD7: case 0xDB: case 0xDF:   // DCP
+        case 0xE3: case 0xE7: case 0xEF: case 0xF3: case 0xF7: case 0xFB: case 0xFF:   // ISC
+        #endif
+            return ACCESS_MODIFY;
+
+        case 0x20: // JSR only uses the address
+            return ACCESS_NONE;
+
+        default:
+            return ACCESS_READ;
+    }
+}
+
+void watch_check(byte2 addr, byte opcode) {
+    if (tracing) trace_access(addr, opcode);
+
+    switch (access_kind(opcode)) {
+        case ACCESS_WRITE:
+            if (bit_test(write_bits, addr)) watch_hit = watch_write = true;
+            break;
+
+        case ACCESS_MODIFY:
+            if (bit_test(write_bits, addr)) watch_hit = watch_write = true;
+            else if (bit_test(read_bits, addr)) watch_hit = true, watch_write = false;
+            break;
+
+        case ACCESS_READ:
+            if (bit_test(read_bits, addr)) watch_hit = true, watch_write = false;
+            break;
+
+        case ACCESS_NONE:
+            break;
+    }
+
+    if (watch_hit) watch_addr = addr;
+}
+
+// Check an access made through an addressing mode (device registers are brought up to date before being read)
+inline byte& watch_access(byte& ref, byte opcode) {
+    byte2 addr = &ref - memory;
+
+    if (io_pages[addr >> 8]) io_access(addr, opcode);
+    if (watchpoints) watch_check(addr, opcode);
+
+    return ref;
+}
+
+#define WATCH(ref) (watching ? watch_access(ref, opcode) : (ref))
+
+// Check whether to stop before executing the instruction at pc
+bool debug_break(byte2 last) {
+    int skip = break_skip;
+    break_skip = -1;
+
+    char text[DISASM_MAX];
+
+    if (watch_hit) {
+        watch_hit = false;
+
+        disasm(last, text);
+        printf("Watchpoint: %s of %04X by instruction at %04X (%s)\n", watch_write ? "write" : "read", watch_addr, last, text);
+        return true;
+    }
+
+    if (bit_test(break_bits, pc) && pc != skip) {
+        bool conditional = false;
+
+        for (std::pair<byte2, Condition>& cond : break_conds) {
+            if (cond.first != pc) continue;
+
+            conditional = true;
+
+            if (cond.second.test()) {
+                disasm(pc, text);
+                printf("Breakpoint at %04X: %s (%s)\n", pc, text, cond.second.text.c_str());
+                return true;
+            }
+        }
+
+        if (!conditional) {
+            disasm(pc, text);
+            printf("Breakpoint at %04X: %s\n", pc, text);
+            return true;
+        }
+    }
+
+    for (Condition& cond : global_conds) {
+        if (cond.test()) {
+            disasm(pc, text);
+            printf("Condition %s met at %04X: %s\n", cond.text.c_str(), pc, text);
+            return true;
+        }
+    }
+
+    return false;
+}
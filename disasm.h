@@ -0,0 +1,225 @@
+#include <array>
+#include <initializer_list>
+
+/* disasm.h
+  Contains the opcode table, which holds what is known about each opcode of the CPU built for (mnemonic, addressing
+  mode, length, base cycles, flags it changes and which CPUs have it) and is put together when compiling, and the
+  disassembler built on it, used by the instruction printout, breakpoints, the profile report and --disasm.
+*/
+
+enum OpMode { O_IMP, O_ACC, O_IMM, O_REL, O_ZP, O_ZPX, O_ZPY, O_ABS, O_ABX, O_ABY, O_IND, O_IZX, O_IZY, O_ZPI, O_IAX, O_ZPR, O_COUNT };
+
+// Which CPUs have an opcode: every 6502, added by the 65C02, undocumented (the NMOS opcodes and the 65C02's NOPs),
+// or none (stops the emulator)
+enum OpVariant { V_6502, V_65C02, V_UNDOC, V_NONE };
+
+// Status register bits (also used by the reference model)
+const byte F_N = 0x80, F_V = 0x40, F_U = 0x20, F_B = 0x10, F_D = 0x08, F_I = 0x04, F_Z = 0x02, F_C = 0x01;
+
+constexpr byte op_lengths[O_COUNT] = {1, 1, 2, 2, 2, 2, 2, 3, 3, 3, 3, 2, 2, 2, 3, 3};
+
+// Operand of each mode, given the operand value (the branch target for O_REL) and for O_ZPR the branch target
+const char* const op_formats[O_COUNT] = {
+    "", "A", "#$%02X", "$%04X", "$%02X", "$%02X,X", "$%02X,Y", "$%04X", "$%04X,X", "$%04X,Y", "($%04X)", "($%02X,X)",
+    "($%02X),Y", "($%02X)", "($%04X,X)", "$%02X,$%04X"
+};
+
+struct OpRow {
+    const char* name;
+    OpMode mode;
+    OpVariant variant;
+};
+
+// Mnemonic and mode of each opcode, as in the cases of instruction()
+#if defined(CPU_65C02)
+constexpr OpRow op_rows[0x100] = {
+    {"BRK", O_IMP, V_6502}, {"ORA", O_IZX, V_6502}, {"NOP", O_IMM, V_UNDOC}, {"NOP", O_IMP, V_UNDOC}, {"TSB", O_ZP, V_65C02}, {"ORA", O_ZP, V_6502}, {"ASL", O_ZP, V_6502}, {"RMB0", O_ZP, V_65C02}, // 00
+    {"PHP", O_IMP, V_6502}, {"ORA", O_IMM, V_6502}, {"ASL", O_ACC, V_6502}, {"NOP", O_IMP, V_UNDOC}, {"TSB", O_ABS, V_65C02}, {"ORA", O_ABS, V_6502}, {"ASL", O_ABS, V_6502}, {"BBR0", O_ZPR, V_65C02}, // 08
+    {"BPL", O_REL, V_6502}, {"ORA", O_IZY, V_6502}, {"ORA", O_ZPI, V_65C02}, {"NOP", O_IMP, V_UNDOC}, {"TRB", O_ZP, V_65C02}, {"ORA", O_ZPX, V_6502}, {"ASL", O_ZPX, V_6502}, {"RMB1", O_ZP, V_65C02}, // 10
+    {"CLC", O_IMP, V_6502}, {"ORA", O_ABY, V_6502}, {"INC", O_ACC, V_65C02}, {"NOP", O_IMP, V_UNDOC}, {"TRB", O_ABS, V_65C02}, {"ORA", O_ABX, V_6502}, {"ASL", O_ABX, V_6502}, {"BBR1", O_ZPR, V_65C02}, // 18
+    {"JSR", O_ABS, V_6502}, {"AND", O_IZX, V_6502}, {"NOP", O_IMM, V_UNDOC}, {"NOP", O_IMP, V_UNDOC}, {"BIT", O_ZP, V_6502}, {"AND", O_ZP, V_6502}, {"ROL", O_ZP, V_6502}, {"RMB2", O_ZP, V_65C02}, // 20
+    {"PLP", O_IMP, V_6502}, {"AND", O_IMM, V_6502}, {"ROL", O_ACC, V_6502}, {"NOP", O_IMP, V_UNDOC}, {"BIT", O_ABS, V_6502}, {"AND", O_ABS, V_6502}, {"ROL", O_ABS, V_6502}, {"BBR2", O_ZPR, V_65C02}, // 28
+    {"BMI", O_REL, V_6502}, {"AND", O_IZY, V_6502}, {"AND", O_ZPI, V_65C02}, {"NOP", O_IMP, V_UNDOC}, {"BIT", O_ZPX, V_65C02}, {"AND", O_ZPX, V_6502}, {"ROL", O_ZPX, V_6502}, {"RMB3", O_ZP, V_65C02}, // 30
+    {"SEC", O_IMP, V_6502}, {"AND", O_ABY, V_6502}, {"DEC", O_ACC, V_65C02}, {"NOP", O_IMP, V_UNDOC}, {"BIT", O_ABX, V_65C02}, {"AND", O_ABX, V_6502}, {"ROL", O_ABX, V_6502}, {"BBR3", O_ZPR, V_65C02}, // 38
+    {"RTI", O_IMP, V_6502}, {"EOR", O_IZX, V_6502}, {"NOP", O_IMM, V_UNDOC}, {"NOP", O_IMP, V_UNDOC}, {"NOP", O_ZP, V_UNDOC}, {"EOR", O_ZP, V_6502}, {"LSR", O_ZP, V_6502}, {"RMB4", O_ZP, V_65C02}, // 40
+    {"PHA", O_IMP, V_6502}, {"EOR", O_IMM, V_6502}, {"LSR", O_ACC, V_6502}, {"NOP", O_IMP, V_UNDOC}, {"JMP", O_ABS, V_6502}, {"EOR", O_ABS, V_6502}, {"LSR", O_ABS, V_6502}, {"BBR4", O_ZPR, V_65C02}, // 48
+    {"BVC", O_REL, V_6502}, {"EOR", O_IZY, V_6502}, {"EOR", O_ZPI, V_65C02}, {"NOP", O_IMP, V_UNDOC}, {"NOP", O_ZPX, V_UNDOC}, {"EOR", O_ZPX, V_6502}, {"LSR", O_ZPX, V_6502}, {"RMB5", O_ZP, V_65C02}, // 50
+    {"CLI", O_IMP, V_6502}, {"EOR", O_ABY, V_6502}, {"PHY", O_IMP, V_65C02}, {"NOP", O_IMP, V_UNDOC}, {"NOP", O_ABS, V_UNDOC}, {"EOR", O_ABX, V_6502}, {"LSR", O_ABX, V_6502}, {"BBR5", O_ZPR, V_65C02}, // 58
+    {"RTS", O_IMP, V_6502}, {"ADC", O_IZX, V_6502}, {"NOP", O_IMM, V_UNDOC}, {"NOP", O_IMP, V_UNDOC}, {"STZ", O_ZP, V_65C02}, {"ADC", O_ZP, V_6502}, {"ROR", O_ZP, V_6502}, {"RMB6", O_ZP, V_65C02}, // 60
+    {"PLA", O_IMP, V_6502}, {"ADC", O_IMM, V_6502}, {"ROR", O_ACC, V_6502}, {"NOP", O_IMP, V_UNDOC}, {"JMP", O_IND, V_6502}, {"ADC", O_ABS, V_6502}, {"ROR", O_ABS, V_6502}, {"BBR6", O_ZPR, V_65C02}, // 68
+    {"BVS", O_REL, V_6502}, {"ADC", O_IZY, V_6502}, {"ADC", O_ZPI, V_65C02}, {"NOP", O_IMP, V_UNDOC}, {"STZ", O_ZPX, V_65C02}, {"ADC", O_ZPX, V_6502}, {"ROR", O_ZPX, V_6502}, {"RMB7", O_ZP, V_65C02}, // 70
+    {"SEI", O_IMP, V_6502}, {"ADC", O_ABY, V_6502}, {"PLY", O_IMP, V_65C02}, {"NOP", O_IMP, V_UNDOC}, {"JMP", O_IAX, V_65C02}, {"ADC", O_ABX, V_6502}, {"ROR", O_ABX, V_6502}, {"BBR7", O_ZPR, V_65C02}, // 78
+    {"BRA", O_REL, V_65C02}, {"STA", O_IZX, V_6502}, {"NOP", O_IMM, V_UNDOC}, {"NOP", O_IMP, V_UNDOC}, {"STY", O_ZP, V_6502}, {"STA", O_ZP, V_6502}, {"STX", O_ZP, V_6502}, {"SMB0", O_ZP, V_65C02}, // 80
+    {"DEY", O_IMP, V_6502}, {"BIT", O_IMM, V_65C02}, {"TXA", O_IMP, V_6502}, {"NOP", O_IMP, V_UNDOC}, {"STY", O_ABS, V_6502}, {"STA", O_ABS, V_6502}, {"STX", O_ABS, V_6502}, {"BBS0", O_ZPR, V_65C02}, // 88
+    {"BCC", O_REL, V_6502}, {"STA", O_IZY, V_6502}, {"STA", O_ZPI, V_65C02}, {"NOP", O_IMP, V_UNDOC}, {"STY", O_ZPX, V_6502}, {"STA", O_ZPX, V_6502}, {"STX", O_ZPY, V_6502}, {"SMB1", O_ZP, V_65C02}, // 90
+    {"TYA", O_IMP, V_6502}, {"STA", O_ABY, V_6502}, {"TXS", O_IMP, V_6502}, {"NOP", O_IMP, V_UNDOC}, {"STZ", O_ABS, V_65C02}, {"STA", O_ABX, V_6502}, {"STZ", O_ABX, V_65C02}, {"BBS1", O_ZPR, V_65C02}, // 98
+    {"LDY", O_IMM, V_6502}, {"LDA", O_IZX, V_6502}, {"LDX", O_IMM, V_6502}, {"NOP", O_IMP, V_UNDOC}, {"LDY", O_ZP, V_6502}, {"LDA", O_ZP, V_6502}, {"LDX", O_ZP, V_6502}, {"SMB2", O_ZP, V_65C02}, // A0
+    {"TAY", O_IMP, V_6502}, {"LDA", O_IMM, V_6502}, {"TAX", O_IMP, V_6502}, {"NOP", O_IMP, V_UNDOC}, {"LDY", O_ABS, V_6502}, {"LDA", O_ABS, V_6502}, {"LDX", O_ABS, V_6502}, {"BBS2", O_ZPR, V_65C02}, // A8
+    {"BCS", O_REL, V_6502}, {"LDA", O_IZY, V_6502}, {"LDA", O_ZPI, V_65C02}, {"NOP", O_IMP, V_UNDOC}, {"LDY", O_ZPX, V_6502}, {"LDA", O_ZPX, V_6502}, {"LDX", O_ZPY, V_6502}, {"SMB3", O_ZP, V_65C02}, // B0
+    {"CLV", O_IMP, V_6502}, {"LDA", O_ABY, V_6502}, {"TSX", O_IMP, V_6502}, {"NOP", O_IMP, V_UNDOC}, {"LDY", O_ABX, V_6502}, {"LDA", O_ABX, V_6502}, {"LDX", O_ABY, V_6502}, {"BBS3", O_ZPR, V_65C02}, // B8
+    {"CPY", O_IMM, V_6502}, {"CMP", O_IZX, V_6502}, {"NOP", O_IMM, V_UNDOC}, {"NOP", O_IMP, V_UNDOC}, {"CPY", O_ZP, V_6502}, {"CMP", O_ZP, V_6502}, {"DEC", O_ZP, V_6502}, {"SMB4", O_ZP, V_65C02}, // C0
+    {"INY", O_IMP, V_6502}, {"CMP", O_IMM, V_6502}, {"DEX", O_IMP, V_6502}, {"WAI", O_IMP, V_65C02}, {"CPY", O_ABS, V_6502}, {"CMP", O_ABS, V_6502}, {"DEC", O_ABS, V_6502}, {"BBS4", O_ZPR, V_65C02}, // C8
+    {"BNE", O_REL, V_6502}, {"CMP", O_IZY, V_6502}, {"CMP", O_ZPI, V_65C02}, {"NOP", O_IMP, V_UNDOC}, {"NOP", O_ZPX, V_UNDOC}, {"CMP", O_ZPX, V_6502}, {"DEC", O_ZPX, V_6502}, {"SMB5", O_ZP, V_65C02}, // D0
+    {"CLD", O_IMP, V_6502}, {"CMP", O_ABY, V_6502}, {"PHX", O_IMP, V_65C02}, {"STP", O_IMP, V_65C02}, {"NOP", O_ABS, V_UNDOC}, {"CMP", O_ABX, V_6502}, {"DEC", O_ABX, V_6502}, {"BBS5", O_ZPR, V_65C02}, // D8
+    {"CPX", O_IMM, V_6502}, {"SBC", O_IZX, V_6502}, {"NOP", O_IMM, V_UNDOC}, {"NOP", O_IMP, V_UNDOC}, {"CPX", O_ZP, V_6502}, {"SBC", O_ZP, V_6502}, {"INC", O_ZP, V_6502}, {"SMB6", O_ZP, V_65C02}, // E0
+    {"INX", O_IMP, V_6502}, {"SBC", O_IMM, V_6502}, {"NOP", O_IMP, V_6502}, {"NOP", O_IMP, V_UNDOC}, {"CPX", O_ABS, V_6502}, {"SBC", O_ABS, V_6502}, {"INC", O_ABS, V_6502}, {"BBS6", O_ZPR, V_65C02}, // E8
+    {"BEQ", O_REL, V_6502}, {"SBC", O_IZY, V_6502}, {"SBC", O_ZPI, V_65C02}, {"NOP", O_IMP, V_UNDOC}, {"NOP", O_ZPX, V_UNDOC}, {"SBC", O_ZPX, V_6502}, {"INC", O_ZPX, V_6502}, {"SMB7", O_ZP, V_65C02}, // F0
+    {"SED", O_IMP, V_6502}, {"SBC", O_ABY, V_6502}, {"PLX", O_IMP, V_65C02}, {"NOP", O_IMP, V_UNDOC}, {"NOP", O_ABS, V_UNDOC}, {"SBC", O_ABX, V_6502}, {"INC", O_ABX, V_6502}, {"BBS7", O_ZPR, V_65C02}, // F8
+};
+#else
+constexpr OpRow op_rows[0x100] = {
+    {"BRK", O_IMP, V_6502}, {"ORA", O_IZX, V_6502}, {"???", O_IMP, V_NONE}, {"SLO", O_IZX, V_UNDOC}, {"NOP", O_ZP, V_UNDOC}, {"ORA", O_ZP, V_6502}, {"ASL", O_ZP, V_6502}, {"SLO", O_ZP, V_UNDOC}, // 00
+    {"PHP", O_IMP, V_6502}, {"ORA", O_IMM, V_6502}, {"ASL", O_ACC, V_6502}, {"ANC", O_IMM, V_UNDOC}, {"NOP", O_ABS, V_UNDOC}, {"ORA", O_ABS, V_6502}, {"ASL", O_ABS, V_6502}, {"SLO", O_ABS, V_UNDOC}, // 08
+    {"BPL", O_REL, V_6502}, {"ORA", O_IZY, V_6502}, {"???", O_IMP, V_NONE}, {"SLO", O_IZY, V_UNDOC}, {"NOP", O_ZPX, V_UNDOC}, {"ORA", O_ZPX, V_6502}, {"ASL", O_ZPX, V_6502}, {"SLO", O_ZPX, V_UNDOC}, // 10
+    {"CLC", O_IMP, V_6502}, {"ORA", O_ABY, V_6502}, {"NOP", O_IMP, V_UNDOC}, {"SLO", O_ABY, V_UNDOC}, {"NOP", O_ABX, V_UNDOC}, {"ORA", O_ABX, V_6502}, {"ASL", O_ABX, V_6502}, {"SLO", O_ABX, V_UNDOC}, // 18
+    {"JSR", O_ABS, V_6502}, {"AND", O_IZX, V_6502}, {"???", O_IMP, V_NONE}, {"RLA", O_IZX, V_UNDOC}, {"BIT", O_ZP, V_6502}, {"AND", O_ZP, V_6502}, {"ROL", O_ZP, V_6502}, {"RLA", O_ZP, V_UNDOC}, // 20
+    {"PLP", O_IMP, V_6502}, {"AND", O_IMM, V_6502}, {"ROL", O_ACC, V_6502}, {"ANC", O_IMM, V_UNDOC}, {"BIT", O_ABS, V_6502}, {"AND", O_ABS, V_6502}, {"ROL", O_ABS, V_6502}, {"RLA", O_ABS, V_UNDOC}, // 28
+    {"BMI", O_REL, V_6502}, {"AND", O_IZY, V_6502}, {"???", O_IMP, V_NONE}, {"RLA", O_IZY, V_UNDOC}, {"NOP", O_ZPX, V_UNDOC}, {"AND", O_ZPX, V_6502}, {"ROL", O_ZPX, V_6502}, {"RLA", O_ZPX, V_UNDOC}, // 30
+    {"SEC", O_IMP, V_6502}, {"AND", O_ABY, V_6502}, {"NOP", O_IMP, V_UNDOC}, {"RLA", O_ABY, V_UNDOC}, {"NOP", O_ABX, V_UNDOC}, {"AND", O_ABX, V_6502}, {"ROL", O_ABX, V_6502}, {"RLA", O_ABX, V_UNDOC}, // 38
+    {"RTI", O_IMP, V_6502}, {"EOR", O_IZX, V_6502}, {"???", O_IMP, V_NONE}, {"SRE", O_IZX, V_UNDOC}, {"NOP", O_ZP, V_UNDOC}, {"EOR", O_ZP, V_6502}, {"LSR", O_ZP, V_6502}, {"SRE", O_ZP, V_UNDOC}, // 40
+    {"PHA", O_IMP, V_6502}, {"EOR", O_IMM, V_6502}, {"LSR", O_ACC, V_6502}, {"ALR", O_IMM, V_UNDOC}, {"JMP", O_ABS, V_6502}, {"EOR", O_ABS, V_6502}, {"LSR", O_ABS, V_6502}, {"SRE", O_ABS, V_UNDOC}, // 48
+    {"BVC", O_REL, V_6502}, {"EOR", O_IZY, V_6502}, {"???", O_IMP, V_NONE}, {"SRE", O_IZY, V_UNDOC}, {"NOP", O_ZPX, V_UNDOC}, {"EOR", O_ZPX, V_6502}, {"LSR", O_ZPX, V_6502}, {"SRE", O_ZPX, V_UNDOC}, // 50
+    {"CLI", O_IMP, V_6502}, {"EOR", O_ABY, V_6502}, {"NOP", O_IMP, V_UNDOC}, {"SRE", O_ABY, V_UNDOC}, {"NOP", O_ABX, V_UNDOC}, {"EOR", O_ABX, V_6502}, {"LSR", O_ABX, V_6502}, {"SRE", O_ABX, V_UNDOC}, // 58
+    {"RTS", O_IMP, V_6502}, {"ADC", O_IZX, V_6502}, {"???", O_IMP, V_NONE}, {"RRA", O_IZX, V_UNDOC}, {"NOP", O_ZP, V_UNDOC}, {"ADC", O_ZP, V_6502}, {"ROR", O_ZP, V_6502}, {"RRA", O_ZP, V_UNDOC}, // 60
+    {"PLA", O_IMP, V_6502}, {"ADC", O_IMM, V_6502}, {"ROR", O_ACC, V_6502}, {"ARR", O_IMM, V_UNDOC}, {"JMP", O_IND, V_6502}, {"ADC", O_ABS, V_6502}, {"ROR", O_ABS, V_6502}, {"RRA", O_ABS, V_UNDOC}, // 68
+    {"BVS", O_REL, V_6502}, {"ADC", O_IZY, V_6502}, {"???", O_IMP, V_NONE}, {"RRA", O_IZY, V_UNDOC}, {"NOP", O_ZPX, V_UNDOC}, {"ADC", O_ZPX, V_6502}, {"ROR", O_ZPX, V_6502}, {"RRA", O_ZPX, V_UNDOC}, // 70
+    {"SEI", O_IMP, V_6502}, {"ADC", O_ABY, V_6502}, {"NOP", O_IMP, V_UNDOC}, {"RRA", O_ABY, V_UNDOC}, {"NOP", O_ABX, V_UNDOC}, {"ADC", O_ABX, V_6502}, {"ROR", O_ABX, V_6502}, {"RRA", O_ABX, V_UNDOC}, // 78
+    {"NOP", O_IMM, V_UNDOC}, {"STA", O_IZX, V_6502}, {"NOP", O_IMM, V_UNDOC}, {"SAX", O_IZX, V_UNDOC}, {"STY", O_ZP, V_6502}, {"STA", O_ZP, V_6502}, {"STX", O_ZP, V_6502}, {"SAX", O_ZP, V_UNDOC}, // 80
+    {"DEY", O_IMP, V_6502}, {"NOP", O_IMM, V_UNDOC}, {"TXA", O_IMP, V_6502}, {"XAA", O_IMM, V_UNDOC}, {"STY", O_ABS, V_6502}, {"STA", O_ABS, V_6502}, {"STX", O_ABS, V_6502}, {"SAX", O_ABS, V_UNDOC}, // 88
+    {"BCC", O_REL, V_6502}, {"STA", O_IZY, V_6502}, {"???", O_IMP, V_NONE}, {"SHA", O_IZY, V_UNDOC}, {"STY", O_ZPX, V_6502}, {"STA", O_ZPX, V_6502}, {"STX", O_ZPY, V_6502}, {"SAX", O_ZPY, V_UNDOC}, // 90
+    {"TYA", O_IMP, V_6502}, {"STA", O_ABY, V_6502}, {"TXS", O_IMP, V_6502}, {"TAS", O_ABY, V_UNDOC}, {"SHY", O_ABX, V_UNDOC}, {"STA", O_ABX, V_6502}, {"SHX", O_ABY, V_UNDOC}, {"SHA", O_ABY, V_UNDOC}, // 98
+    {"LDY", O_IMM, V_6502}, {"LDA", O_IZX, V_6502}, {"LDX", O_IMM, V_6502}, {"LAX", O_IZX, V_UNDOC}, {"LDY", O_ZP, V_6502}, {"LDA", O_ZP, V_6502}, {"LDX", O_ZP, V_6502}, {"LAX", O_ZP, V_UNDOC}, // A0
+    {"TAY", O_IMP, V_6502}, {"LDA", O_IMM, V_6502}, {"TAX", O_IMP, V_6502}, {"LXA", O_IMM, V_UNDOC}, {"LDY", O_ABS, V_6502}, {"LDA", O_ABS, V_6502}, {"LDX", O_ABS, V_6502}, {"LAX", O_ABS, V_UNDOC}, // A8
+    {"BCS", O_REL, V_6502}, {"LDA", O_IZY, V_6502}, {"???", O_IMP, V_NONE}, {"LAX", O_IZY, V_UNDOC}, {"LDY", O_ZPX, V_6502}, {"LDA", O_ZPX, V_6502}, {"LDX", O_ZPY, V_6502}, {"LAX", O_ZPY, V_UNDOC}, // B0
+    {"CLV", O_IMP, V_6502}, {"LDA", O_ABY, V_6502}, {"TSX", O_IMP, V_6502}, {"LAS", O_ABY, V_UNDOC}, {"LDY", O_ABX, V_6502}, {"LDA", O_ABX, V_6502}, {"LDX", O_ABY, V_6502}, {"LAX", O_ABY, V_UNDOC}, // B8
+    {"CPY", O_IMM, V_6502}, {"CMP", O_IZX, V_6502}, {"NOP", O_IMM, V_UNDOC}, {"DCP", O_IZX, V_UNDOC}, {"CPY", O_ZP, V_6502}, {"CMP", O_ZP, V_6502}, {"DEC", O_ZP, V_6502}, {"DCP", O_ZP, V_UNDOC}, // C0
+    {"INY", O_IMP, V_6502}, {"CMP", O_IMM, V_6502}, {"DEX", O_IMP, V_6502}, {"AXS", O_IMM, V_UNDOC}, {"CPY", O_ABS, V_6502}, {"CMP", O_ABS, V_6502}, {"DEC", O_ABS, V_6502}, {"DCP", O_ABS, V_UNDOC}, // C8
+    {"BNE", O_REL, V_6502}, {"CMP", O_IZY, V_6502}, {"???", O_IMP, V_NONE}, {"DCP", O_IZY, V_UNDOC}, {"NOP", O_ZPX, V_UNDOC}, {"CMP", O_ZPX, V_6502}, {"DEC", O_ZPX, V_6502}, {"DCP", O_ZPX, V_UNDOC}, // D0
+    {"CLD", O_IMP, V_6502}, {"CMP", O_ABY, V_6502}, {"NOP", O_IMP, V_UNDOC}, {"DCP", O_ABY, V_UNDOC}, {"NOP", O_ABX, V_UNDOC}, {"CMP", O_ABX, V_6502}, {"DEC", O_ABX, V_6502}, {"DCP", O_ABX, V_UNDOC}, // D8
+    {"CPX", O_IMM, V_6502}, {"SBC", O_IZX, V_6502}, {"NOP", O_IMM, V_UNDOC}, {"ISC", O_IZX, V_UNDOC}, {"CPX", O_ZP, V_6502}, {"SBC", O_ZP, V_6502}, {"INC", O_ZP, V_6502}, {"ISC", O_ZP, V_UNDOC}, // E0
+    {"INX", O_IMP, V_6502}, {"SBC", O_IMM, V_6502}, {"NOP", O_IMP, V_6502}, {"SBC", O_IMM, V_UNDOC}, {"CPX", O_ABS, V_6502}, {"SBC", O_ABS, V_6502}, {"INC", O_ABS, V_6502}, {"ISC", O_ABS, V_UNDOC}, // E8
+    {"BEQ", O_REL, V_6502}, {"SBC", O_IZY, V_6502}, {"???", O_IMP, V_NONE}, {"ISC", O_IZY, V_UNDOC}, {"NOP", O_ZPX, V_UNDOC}, {"SBC", O_ZPX, V_6502}, {"INC", O_ZPX, V_6502}, {"ISC", O_ZPX, V_UNDOC}, // F0
+    {"SED", O_IMP, V_6502}, {"SBC", O_ABY, V_6502}, {"NOP", O_IMP, V_UNDOC}, {"ISC", O_ABY, V_UNDOC}, {"NOP", O_ABX, V_UNDOC}, {"SBC", O_ABX, V_6502}, {"INC", O_ABX, V_6502}, {"ISC", O_ABX, V_UNDOC}, // F8
+};
+#endif
+
+struct OpFlagRow {
+    const char* name;
+    byte flags;
+};
+
+// Flags changed by each mnemonic (others change none)
+constexpr OpFlagRow op_flag_rows[] = {
+    {"ADC", F_N | F_V | F_Z | F_C}, {"SBC", F_N | F_V | F_Z | F_C}, {"AND", F_N | F_Z}, {"ORA", F_N | F_Z}, {"EOR", F_N | F_Z},
+    {"ASL", F_N | F_Z | F_C}, {"LSR", F_N | F_Z | F_C}, {"ROL", F_N | F_Z | F_C}, {"ROR", F_N | F_Z | F_C},
+    {"BIT", F_N | F_V | F_Z}, {"CMP", F_N | F_Z | F_C}, {"CPX", F_N | F_Z | F_C}, {"CPY", F_N | F_Z | F_C},
+    {"INC", F_N | F_Z}, {"DEC", F_N | F_Z}, {"INX", F_N | F_Z}, {"INY", F_N | F_Z}, {"DEX", F_N | F_Z}, {"DEY", F_N | F_Z},
+    {"LDA", F_N | F_Z}, {"LDX", F_N | F_Z}, {"LDY", F_N | F_Z}, {"TAX", F_N | F_Z}, {"TAY", F_N | F_Z}, {"TSX", F_N | F_Z},
+    {"TXA", F_N | F_Z}, {"TYA", F_N | F_Z}, {"PLA", F_N | F_Z}, {"PLX", F_N | F_Z}, {"PLY", F_N | F_Z},
+    {"PLP", F_N | F_V | F_D | F_I | F_Z | F_C}, {"RTI", F_N | F_V | F_D | F_I | F_Z | F_C},
+    {"CLC", F_C}, {"SEC", F_C}, {"CLD", F_D}, {"SED", F_D}, {"CLI", F_I}, {"SEI", F_I}, {"CLV", F_V}, {"TSB", F_Z}, {"TRB", F_Z},
+    #if defined(CPU_65C02)
+    {"BRK", F_I | F_D},
+    #else
+    {"BRK", F_I},
+    #endif
+    {"SLO", F_N | F_Z | F_C}, {"RLA", F_N | F_Z | F_C}, {"SRE", F_N | F_Z | F_C}, {"RRA", F_N | F_V | F_Z | F_C},
+    {"DCP", F_N | F_Z | F_C}, {"ISC", F_N | F_V | F_Z | F_C}, {"LAX", F_N | F_Z}, {"LAS", F_N | F_Z}, {"ANC", F_N | F_Z | F_C},
+    {"ALR", F_N | F_Z | F_C}, {"ARR", F_N | F_V | F_Z | F_C}, {"XAA", F_N | F_Z}, {"LXA", F_N | F_Z}, {"AXS", F_N | F_Z | F_C}
+};
+
+constexpr bool op_same(const char* l, const char* r) {
+    while (*l && *l == *r) {
+        l++;
+        r++;
+    }
+
+    return *l == *r;
+}
+
+constexpr byte op_flags(const OpRow& row) {
+    if (op_same(row.name, "BIT") && row.mode == O_IMM) return F_Z; // The 65C02's BIT #imm has no memory to take N and V from
+
+    for (const OpFlagRow& flag : op_flag_rows) {
+        if (op_same(flag.name, row.name)) return flag.flags;
+    }
+
+    return 0;
+}
+
+struct OpInfo {
+    const char* name;
+    OpMode mode;
+    byte length;
+    byte cycles;     // As op_cycles
+    byte flags;      // Status register bits it can change
+    OpVariant variant;
+};
+
+constexpr std::array<OpInfo, 0x100> op_build() {
+    std::array<OpInfo, 0x100> table = {};
+
+    for (int op = 0; op < 0x100; op++) {
+        const OpRow& row = op_rows[op];
+
+        table[op] = {row.name, row.mode, op_lengths[row.mode], op_cycles[op], op_flags(row), row.variant};
+    }
+
+    return table;
+}
+
+constexpr std::array<OpInfo, 0x100> op_info = op_build();
+
+static_assert(op_info[0xBD].length == 3 && op_info[0xBD].flags == (F_N | F_Z), "Opcode table out of line with the cases");
+
+// Whether an opcode's mnemonic is one of names (for code that treats instructions by what they do)
+constexpr bool op_is(const OpInfo& info, std::initializer_list<const char*> names) {
+    for (const char* name : names) {
+        if (op_same(info.name, name)) return true;
+    }
+
+    return false;
+}
+
+bool disasm_listing = false;    // List the program instead of running it (--disasm)
+
+#define DISASM_MAX 16   // Room for the longest instruction ("BBR0 $12,$3456") and its terminator
+
+// Write the instruction at addr as assembly ("LDA $1234,X", branches to their target), returns its length
+int disasm(byte2 addr, char* out) {
+    const OpInfo& info = op_info[memory[addr]];
+    byte lo = memory[(byte2)(addr + 1)], hi = memory[(byte2)(addr + 2)];
+    int operand = info.length == 3 && info.mode != O_ZPR ? hi * 0x100 + lo : lo;
+    int target = (byte2)(addr + info.length + (signed char)(info.mode == O_ZPR ? hi : lo));
+
+    if (info.mode == O_REL) operand = target;
+
+    int len = snprintf(out, DISASM_MAX, "%s", info.name);
+
+    if (info.mode != O_IMP) {
+        out[len++] = ' ';
+        snprintf(out + len, DISASM_MAX - len, op_formats[info.mode], operand, target);
+    }
+
+    return info.length;
+}
+
+// Print the instructions from start up to end as a listing, with their bytes
+void disasm_print(int start, int end) {
+    char text[DISASM_MAX];
+
+    for (int at = start; at < end;) {
+        int len = disasm(at, text);
+
+        printf("%04X ", at);
+
+        for (int i = 0; i < 3; i++) {
+            if (i < len) printf(" %02X", memory[(byte2)(at + i)]);
+            else printf("   ");
+        }
+
+        printf("  %s\n", text);
+
+        at += len;
+    }
+}
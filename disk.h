@@ -0,0 +1,163 @@
+/* disk.h
+  Contains the block device (-bd), which moves 512 byte sectors between a disk image and memory by DMA. The image
+  is mapped into the host's memory, so a transfer is one copy and writes go straight to the file.
+  Its registers are plain memory that the device reads when given a command and writes the status into, so reads
+  cost nothing. A store to the command or status register is taken at the end of the instruction (once the store
+  has landed), and a transfer completes -bl cycles per sector later as an event, setting the status and pulling the
+  IRQ line if enabled, until the status is acknowledged by a store to it.
+
+    +0  Command: 1 reads sectors into memory, 2 writes them from memory
+    +1  Status: bit 7 busy, bit 6 error, bit 0 done (a store clears done and error)
+    +2  Control: bit 7 enables the IRQ on completion
+    +3  Sector count (0 for 256)
+    +4  Buffer address (16 bits)
+    +6  Sector number (32 bits)
+*/
+
+string disk_file;
+int disk_start = 0xFFE0;
+unsigned long long disk_latency = 512;    // Cycles per sector
+
+#define DISK_SECTOR 512
+#define DISK_IRQ 0x02                     // Bit in irq_sources
+
+enum DiskStatus { DISK_DONE = 0x01, DISK_ERROR = 0x40, DISK_BUSY = 0x80 };
+
+byte* disk_image = NULL;
+size_t disk_size = 0;
+bool disk_writable = false;
+
+byte disk_status = 0;                         // Status register, copied to memory after each store (which would overwrite it)
+bool disk_command = false, disk_ack = false;  // Stores waiting for the end of the instruction
+unsigned long long disk_stored = ~0ull;       // Cycle of those stores
+unsigned long long disk_done = ~0ull;         // Cycle the transfer completes
+
+// The transfer in progress
+struct DiskTransfer {
+    byte command;
+    int count;
+    byte2 buffer;
+    unsigned long long sector;
+} disk_transfer;
+
+inline byte& disk_reg(int offset) {
+    return memory[disk_start + offset];
+}
+
+void disk_irq() {
+    if (disk_status & (DISK_DONE | DISK_ERROR) && disk_reg(2) & 0x80) irq_sources |= DISK_IRQ;
+    else irq_sources &= ~DISK_IRQ;
+}
+
+// Copy the sectors, returns false if they are outside the image or memory, or the image can't be written
+bool disk_copy(DiskTransfer& transfer) {
+    size_t len = transfer.count * DISK_SECTOR;
+    size_t at = transfer.sector * DISK_SECTOR;
+
+    if (transfer.sector >= disk_size / DISK_SECTOR || at + len > disk_size || transfer.buffer + len > 0x10000) return false;
+
+    if (transfer.command == 1) {
+        machine_write(transfer.buffer, &disk_image[at], len);
+    } else {
+        if (!disk_writable) return false;
+
+        memcpy(&disk_image[at], &memory[transfer.buffer], len);
+    }
+
+    return true;
+}
+
+void disk_start_command() {
+    if (disk_status & DISK_BUSY) return;
+
+    disk_transfer = {disk_reg(0), disk_reg(3) ? disk_reg(3) : 256, (byte2)(disk_reg(5) * 0x100 + disk_reg(4)),
+        (unsigned long long)disk_reg(9) << 24 | disk_reg(8) << 16 | disk_reg(7) << 8 | disk_reg(6)};
+
+    if (disk_transfer.command != 1 && disk_transfer.command != 2) {
+        disk_status = DISK_DONE | DISK_ERROR;
+        return;
+    }
+
+    disk_status = DISK_BUSY;
+    disk_done = cycles + disk_latency * disk_transfer.count;
+}
+
+void disk_write(byte2 addr, byte val) {
+    int offset = addr - disk_start;
+
+    if (offset == 0) disk_command = true;
+    else if (offset == 1) disk_ack = true;
+    else if (offset != 2) return; // Control changes whether the IRQ is pulled
+
+    disk_stored = cycles + 1; // Past the start of this instruction, so not before its store
+}
+
+unsigned long long disk_event() {
+    if (cycles >= disk_stored) {
+        disk_stored = ~0ull;
+
+        if (disk_ack) disk_status &= DISK_BUSY;
+        if (disk_command) disk_start_command();
+
+        disk_ack = disk_command = false;
+    }
+
+    if (cycles >= disk_done) {
+        disk_done = ~0ull;
+        disk_status = disk_copy(disk_transfer) ? DISK_DONE : DISK_DONE | DISK_ERROR;
+    }
+
+    disk_reg(1) = disk_status;
+    disk_irq();
+
+    return std::min(disk_stored, disk_done);
+}
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Map the image and attach, returns false if it can't be opened
+bool disk_attach() {
+    int fd = open(disk_file.c_str(), O_RDWR);
+
+    disk_writable = fd >= 0;
+
+    if (fd < 0) fd = open(disk_file.c_str(), O_RDONLY);
+
+    struct stat st;
+
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        printf("File \"%s\" not found.\n", disk_file.c_str());
+        return false;
+    }
+
+    disk_size = st.st_size;
+
+    if (disk_size >= DISK_SECTOR) {
+        void* mapped = mmap(NULL, disk_size, disk_writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+
+        if (mapped == MAP_FAILED) {
+            printf("Unable to map \"%s\".\n", disk_file.c_str());
+            close(fd);
+            return false;
+        }
+
+        disk_image = (byte*)mapped;
+    }
+
+    close(fd);
+
+    disk_reg(1) = disk_status = 0;
+    io_attach({disk_start, disk_start + 10, NULL, disk_write, NULL, disk_event});
+
+    return true;
+}
+#else
+bool disk_attach() {
+    printf("Block devices are not supported on Windows.\n");
+    return false;
+}
+#endif
@@ -0,0 +1,207 @@
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <fstream>
+#include <filesystem>
+
+/* fb.h
+  Contains the framebuffer (-fb), a device over memory that programs draw on by storing to it: a byte per pixel
+  holding a 16 color palette index (as on the 32x32 screen at $200 most 6502 graphics examples draw on), or a bitmap
+  of 8 pixels per byte. Stores mark their row dirty, and every -fr cycles the band of dirty rows is copied out for a
+  background thread, which brings its picture up to date from those rows only and writes the frame as a PPM file,
+  or appends the rows to a raw file. Nothing is copied or written for frames where nothing was drawn.
+
+  Raw files start with "FB65", the width and height (16 bits each), then a record per frame: the frame number
+  (32 bits), the first row and row count (16 bits each) and the RGB bytes of those rows, all little endian.
+*/
+
+int fb_start = -1;
+int fb_width = 32, fb_height = 32;
+bool fb_bitmap = false;
+unsigned long long fb_interval = 20000;   // Cycles between frames
+string fb_out = "frames";                 // Directory for PPM frames, or a file ending in ".raw"
+
+int fb_row_bytes;
+std::vector<byte> fb_dirty;               // Rows stored to since the last frame
+bool fb_drawn = false;
+unsigned long long fb_next;               // Cycle of the next frame
+
+// Easy6502's palette
+const byte fb_palette[16][3] = {
+    {0x00, 0x00, 0x00}, {0xFF, 0xFF, 0xFF}, {0x88, 0x00, 0x00}, {0xAA, 0xFF, 0xEE},
+    {0xCC, 0x44, 0xCC}, {0x00, 0xCC, 0x55}, {0x00, 0x00, 0xAA}, {0xEE, 0xEE, 0x77},
+    {0xDD, 0x88, 0x55}, {0x66, 0x44, 0x00}, {0xFF, 0x77, 0x77}, {0x33, 0x33, 0x33},
+    {0x77, 0x77, 0x77}, {0xAA, 0xFF, 0x66}, {0x00, 0x88, 0xFF}, {0xBB, 0xBB, 0xBB}
+};
+
+// Changed rows of a frame, for the encoder
+struct FbFrame {
+    unsigned long long number;
+    int first, count;
+    std::vector<byte> bytes;
+};
+
+std::deque<FbFrame> fb_queue;
+std::mutex fb_mutex;
+std::condition_variable fb_cv;
+bool fb_closing = false;
+std::thread fb_thread;
+std::ofstream fb_raw;
+
+// Parse the size ("64x48")
+bool fb_parse_size(string arg) {
+    size_t cross = arg.find('x');
+    int width, height;
+
+    if (cross == string::npos || !parse_num(arg.substr(0, cross), width) || !parse_num(arg.substr(cross + 1), height)) return false;
+    if (!width || !height || width > 0x1000 || height > 0x1000) return false;
+
+    fb_width = width;
+    fb_height = height;
+
+    return true;
+}
+
+void fb_put16(std::ofstream& out, unsigned int val) {
+    out.put(val & 0xFF).put(val >> 8 & 0xFF);
+}
+
+// Bring the picture up to date from a frame's rows and write it out (on the encoder thread)
+void fb_encode(FbFrame& frame, std::vector<byte>& picture) {
+    for (int row = 0; row < frame.count; row++) {
+        const byte* in = &frame.bytes[row * fb_row_bytes];
+        byte* out = &picture[(frame.first + row) * fb_width * 3];
+
+        for (int col = 0; col < fb_width; col++) {
+            byte val = fb_bitmap ? (in[col / 8] >> (7 - col % 8) & 1 ? 1 : 0) : in[col] & 0xF;
+
+            memcpy(&out[col * 3], fb_palette[val], 3);
+        }
+    }
+
+    if (fb_raw.is_open()) {
+        fb_put16(fb_raw, frame.number & 0xFFFF);
+        fb_put16(fb_raw, frame.number >> 16 & 0xFFFF);
+        fb_put16(fb_raw, frame.first);
+        fb_put16(fb_raw, frame.count);
+        fb_raw.write((const char*)&picture[frame.first * fb_width * 3], frame.count * fb_width * 3);
+        return;
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "frame-%06llu.ppm", frame.number);
+
+    std::ofstream out(fs::path(fb_out) / name, std::ios::binary);
+
+    out << "P6\n" << fb_width << ' ' << fb_height << "\n255\n";
+    out.write((const char*)picture.data(), picture.size());
+}
+
+void fb_encoder() {
+    std::vector<byte> picture(fb_width * fb_height * 3);
+
+    while (true) {
+        std::unique_lock<std::mutex> lock(fb_mutex);
+
+        fb_cv.wait(lock, [] { return !fb_queue.empty() || fb_closing; });
+
+        if (fb_queue.empty()) return;
+
+        FbFrame frame = std::move(fb_queue.front());
+        fb_queue.pop_front();
+
+        lock.unlock();
+
+        fb_encode(frame, picture);
+    }
+}
+
+// Hand the band of dirty rows to the encoder
+void fb_capture(unsigned long long number) {
+    if (!fb_drawn) return;
+
+    int first = 0, last = fb_height - 1;
+
+    while (!fb_dirty[first]) first++;
+    while (!fb_dirty[last]) last--;
+
+    FbFrame frame = {number, first, last - first + 1};
+    byte* rows = &memory[fb_start + first * fb_row_bytes];
+
+    frame.bytes.assign(rows, rows + frame.count * fb_row_bytes);
+
+    std::fill(fb_dirty.begin() + first, fb_dirty.begin() + last + 1, 0);
+    fb_drawn = false;
+
+    std::lock_guard<std::mutex> lock(fb_mutex);
+
+    fb_queue.push_back(std::move(frame));
+    fb_cv.notify_one();
+}
+
+void fb_write(byte2 addr, byte val) {
+    fb_dirty[(addr - fb_start) / fb_row_bytes] = true;
+    fb_drawn = true;
+}
+
+unsigned long long fb_event() {
+    if (cycles >= fb_next) {
+        fb_capture(fb_next / fb_interval);
+        fb_next = (cycles / fb_interval + 1) * fb_interval;
+    }
+
+    return fb_next;
+}
+
+// Open the output and attach, returns false if the framebuffer doesn't fit or the output can't be written
+bool fb_attach() {
+    fb_row_bytes = fb_bitmap ? (fb_width + 7) / 8 : fb_width;
+
+    if (fb_start + fb_row_bytes * fb_height > 0x10000) {
+        printf("The framebuffer goes past the maximum memory address (0xFFFF).\n");
+        return false;
+    }
+
+    std::error_code err;
+
+    if (fb_out.size() > 4 && fb_out.substr(fb_out.size() - 4) == ".raw") {
+        fb_raw.open(fb_out, std::ios::binary);
+
+        if (fb_raw.good()) {
+            fb_raw << "FB65";
+            fb_put16(fb_raw, fb_width);
+            fb_put16(fb_raw, fb_height);
+        }
+    } else {
+        fs::create_directories(fb_out, err);
+    }
+
+    if (fb_raw.is_open() ? !fb_raw.good() : !fs::is_directory(fb_out, err)) {
+        printf("Unable to write frames to \"%s\".\n", fb_out.c_str());
+        return false;
+    }
+
+    fb_dirty.assign(fb_height, 0);
+    fb_next = fb_interval;
+    fb_thread = std::thread(fb_encoder);
+
+    io_attach({fb_start, fb_start + fb_row_bytes * fb_height, NULL, fb_write, NULL, fb_event});
+
+    return true;
+}
+
+// Write the last frame and wait for the encoder
+void fb_finish() {
+    fb_capture(fb_next / fb_interval);
+
+    {
+        std::lock_guard<std::mutex> lock(fb_mutex);
+
+        fb_closing = true;
+        fb_cv.notify_one();
+    }
+
+    fb_thread.join();
+}
@@ -0,0 +1,93 @@
+/* fuse.h
+  Contains instruction fusion, which runs common pairs and triples (CMP #imm / BNE, DEX / BNE, INX / CPX #imm / BNE,
+  LDA abs,X / STA abs, ...) in one trip through the instruction loop. After a compare, count or load, if the next
+  instruction is a branch or one of the other opcodes chosen from the pairs --profile reports most often, it runs
+  straight away from a small switch of its own, with the same cases as instruction(). Nothing the loop would
+  have done in between is skipped: a pair is only fused when no limit check or device event falls between the two,
+  and fusion is off whenever something sees every instruction.
+*/
+
+bool fusing = true;         // Off with --nf, or when something sees every instruction
+
+#define FUSE_MAX 2          // Instructions run after the first (so up to triples)
+
+// Left to the compiler, the call keeps the instruction loop's at, opcode and mvbytes out of registers
+#if defined(__GNUC__)
+#define FUSE_INLINE __attribute__((always_inline)) inline
+#else
+#define FUSE_INLINE inline
+#endif
+
+bool fuse_first[0x100];     // Opcodes fused with what follows them (see fuse_init)
+bool fuse_second[0x100];    // Opcodes run straight after one of those (the cases of fuse_instruction)
+
+// Branches, then the most common followers in the examples and test programs
+const byte fuse_ops[] = {
+    0x10, 0x30, 0x50, 0x70, 0x90, 0xB0, 0xD0, 0xF0,
+    0xE8, 0xC8, 0xCA, 0x88,     // INX, INY, DEX, DEY
+    0xC9, 0xE0, 0xC0, 0xDD,     // CMP #imm, CPX #imm, CPY #imm, CMP abs,X
+    0x8D, 0x8C, 0x85            // STA abs, STY abs, STA zp
+};
+
+// Compares, counting and loads, which are what the pairs start with (checking after everything costs more than it saves)
+const char* const fuse_leads[] = {"CMP", "CPX", "CPY", "INX", "INY", "DEX", "DEY", "INC", "DEC", "BIT", "LDA", "LDX", "LDY"};
+
+void fuse_init() {
+    for (int op = 0; op < 0x100; op++) {
+        for (const char* lead : fuse_leads) {
+            if (op_same(op_info[op].name, lead)) fuse_first[op] = true;
+        }
+    }
+
+    for (byte op : fuse_ops) {
+        fuse_second[op] = true;
+    }
+}
+
+// Run one of fuse_ops, as instruction() does
+FUSE_INLINE byte fuse_instruction(byte opcode, byte ops[]) {
+    switch (opcode) {
+        case 0x10: BPL Relative
+        case 0x30: BMI Relative
+        case 0x50: BVC Relative
+        case 0x70: BVS Relative
+        case 0x90: BCC Relative
+        case 0xB0: BCS Relative
+        case 0xD0: BNE Relative
+        case 0xF0: BEQ Relative
+        case 0xE8: INX Implied
+        case 0xC8: INY Implied
+        case 0xCA: DEX Implied
+        case 0x88: DEY Implied
+        case 0xC9: CMP IMM
+        case 0xE0: CPX IMM
+        case 0xC0: CPY IMM
+        case 0xDD: CMP ABS_X
+        case 0x8D: STA ABS
+        case 0x8C: STY ABS
+        case 0x85: STA ZP
+    }
+
+    return 0;
+}
+
+// Called after an instruction in fuse_first has run (pc still on it), runs up to FUSE_MAX more, leaving at, opcode
+// and mvbytes as the instruction loop had them for the last
+FUSE_INLINE void fuse_step(byte2& at, byte& opcode, byte& mvbytes) {
+    for (int n = 0; n < FUSE_MAX && fuse_first[opcode]; n++) {
+        byte2 next = pc + mvbytes;
+        byte second = memory[next];
+
+        if (!fuse_second[second] || cycles >= next_event || (budgeting && instructions + 1 >= budget_next)) return;
+
+        if (budgeting) instructions++;
+        STAT(stat_fused++;)
+
+        pc = at = next;
+        opcode = second;
+
+        byte operands[2] = {memory[(byte2)(next + 1)], memory[(byte2)(next + 2)]};
+        mvbytes = fuse_instruction(second, operands);
+        cycles += op_cycles[second];
+    }
+}
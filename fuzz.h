@@ -0,0 +1,320 @@
+#include <vector>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <random>
+#include <filesystem>
+
+/* fuzz.h
+  Contains the fuzzing mode (--fuzz), which writes each input into memory and runs it from a snapshot of the loaded program.
+  Edges between blocks (taken or not taken branches, jumps, calls and returns) are counted in a 64 KiB map laid out like AFL's.
+  Started by afl-fuzz (__AFL_SHM_ID set and the fork server pipes open) the map is shared and inputs come from AFL,
+  otherwise a small built-in mutator works from the seeds. A halting opcode counts as a crash.
+*/
+
+int fuzz_addr = -1;                        // Where inputs are written, -1 when not fuzzing
+int fuzz_max_len = 0x100;
+string fuzz_inputs;                        // Seed file or directory (the input file under afl-fuzz, stdin if empty)
+unsigned long long fuzz_execs = 1000000;   // Inputs tried by the built-in mutator
+
+#define FUZZ_MAP_SIZE 0x10000
+#define FUZZ_CYCLES 100000                 // Budget per input without --max-cycles
+#define FUZZ_FORKSRV_FD 198                // AFL's control pipe, status is the next fd
+
+byte fuzz_local_map[FUZZ_MAP_SIZE];
+byte* fuzz_map = fuzz_local_map;
+
+// Map entries hit by the last input, so only those are checked and cleared
+byte2 fuzz_touched[FUZZ_MAP_SIZE];
+int fuzz_touched_count = 0;
+
+bool fuzz_edge[0x100];                     // Opcodes that end a block
+
+void fuzz_init() {
+    for (int op = 0; op < 0x100; op++) {
+        const OpInfo& info = op_info[op];
+
+        // Branches (with BRA, BBR and BBS on the 65C02), jumps, calls and returns
+        fuzz_edge[op] = info.mode == O_REL || info.mode == O_ZPR || op_is(info, {"JMP", "JSR", "RTS", "RTI", "BRK"});
+    }
+
+    fuzz_max_len = std::min(fuzz_max_len, 0x10000 - fuzz_addr);
+
+    // The loaded program is restored before every input (see pool.h)
+    pc = 0x100 * memory[0xFFFD] + memory[0xFFFC];
+    machine_snapshot();
+
+    // Output isn't wanted for every input
+    print_out = false;
+    halt_print = false;
+}
+
+// Run one input from the snapshot (length in x and y), counting edges in the map
+StopReason fuzz_run(const string& input) {
+    int len = std::min((int)input.length(), fuzz_max_len);
+
+    machine_reset();
+    machine_write(fuzz_addr, input.data(), len);
+
+    x = len % 0x100;
+    y = len / 0x100;
+
+    unsigned long long limit = max_cycles ? max_cycles : FUZZ_CYCLES;
+    byte2 prev = 0;
+
+    while (cycles < limit) {
+        byte2 at = pc;
+        byte opcode = memory[pc];
+        byte operands[2] = {memory[(byte2)(pc + 1)], memory[(byte2)(pc + 2)]};
+        byte mvbytes = instruction(opcode, operands);
+
+        cycles += op_cycles[opcode];
+
+        if (mvbytes == BRK_MOVE) return opcode == 0x00 ? STOP_BRK : STOP_HALT;
+
+        pc += mvbytes;
+
+        if (fuzz_edge[opcode]) {
+            // Block ids are a bijective hash of the address, shifted so A to B and B to A differ
+            byte2 cur = pc * 40503u;
+            byte2 edge = cur ^ prev;
+
+            if (!fuzz_map[edge]++) fuzz_touched[fuzz_touched_count++] = edge;
+            if (!fuzz_map[edge]) fuzz_map[edge] = 0xFF;
+
+            prev = cur >> 1;
+        }
+
+        if (pc == at && stuck(opcode)) return STOP_HANG;
+    }
+
+    return STOP_CYCLES;
+}
+
+// AFL's hit count buckets (1, 2, 3, 4-7, 8-15, 16-31, 32-127, 128+)
+inline byte fuzz_bucket(byte hits) {
+    return hits >= 128 ? 0x80 : hits >= 32 ? 0x40 : hits >= 16 ? 0x20 : hits >= 8 ? 0x10 : hits >= 4 ? 8 : hits >= 3 ? 4 : hits;
+}
+
+// Add the last input's edges to a map of buckets seen, clearing them, returns whether any were new
+bool fuzz_collect(std::vector<byte>& seen) {
+    bool fresh = false;
+
+    for (int i = 0; i < fuzz_touched_count; i++) {
+        byte2 edge = fuzz_touched[i];
+        byte bucket = fuzz_bucket(fuzz_map[edge]);
+
+        if (!(seen[edge] & bucket)) {
+            seen[edge] |= bucket;
+            fresh = true;
+        }
+
+        fuzz_map[edge] = 0;
+    }
+
+    fuzz_touched_count = 0;
+
+    return fresh;
+}
+
+// One to four random changes (AFL's havoc stage, cut down)
+void fuzz_mutate(string& input, std::mt19937_64& rng) {
+    static const byte interesting[] = {0x00, 0x01, 0x10, 0x20, 0x7F, 0x80, 0xFE, 0xFF};
+
+    for (int count = 1 + rng() % 4; count > 0; count--) {
+        int at = input.empty() ? 0 : rng() % input.length();
+
+        switch (input.empty() ? 4 : rng() % 6) {
+            case 0: input[at] ^= 1 << rng() % 8; break;
+            case 1: input[at] = rng(); break;
+            case 2: input[at] = interesting[rng() % sizeof(interesting)]; break;
+            case 3: input[at] += (int)(rng() % 33) - 16; break;
+
+            case 4:
+                if ((int)input.length() < fuzz_max_len) input.insert(input.begin() + rng() % (input.length() + 1), (char)rng());
+                break;
+
+            case 5:
+                if (input.length() > 1) input.erase(at, 1);
+                break;
+        }
+    }
+}
+
+string fuzz_read(const fs::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream buffer;
+
+    buffer << file.rdbuf();
+
+    return buffer.str().substr(0, fuzz_max_len);
+}
+
+void fuzz_write(const fs::path& path, const string& input) {
+    std::ofstream file(path, std::ios::binary);
+
+    file << input;
+}
+
+// Mutate the seeds without afl-fuzz, keeping inputs that reach new edges, returns the exit code (halt if anything crashed)
+int fuzz_local() {
+    std::vector<string> corpus;
+    std::vector<byte> seen(FUZZ_MAP_SIZE), crash_seen(FUZZ_MAP_SIZE);
+    std::error_code err;
+    bool queue = !fuzz_inputs.empty() && fs::is_directory(fuzz_inputs, err); // New inputs are written back to a seed directory
+
+    if (queue) {
+        for (const fs::directory_entry& entry : fs::directory_iterator(fuzz_inputs, err)) {
+            if (entry.is_regular_file(err)) corpus.push_back(fuzz_read(entry.path()));
+        }
+    } else if (!fuzz_inputs.empty()) {
+        if (!fs::exists(fuzz_inputs, err)) {
+            printf("File \"%s\" not found.\n", fuzz_inputs.c_str());
+            return STOP_ERROR;
+        }
+
+        corpus.push_back(fuzz_read(fuzz_inputs));
+    }
+
+    if (corpus.empty()) corpus.push_back(string(1, '\0'));
+
+    std::mt19937_64 rng(1);
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now(), last = begin;
+    unsigned long long execs = 0, timeouts = 0;
+    int crashes = 0, edges = 0;
+    size_t seeds = corpus.size();
+
+    for (; execs < fuzz_execs && !broken; execs++) {
+        // Seeds run once as they are first
+        string input = corpus[execs % corpus.size()];
+
+        if (execs >= seeds) fuzz_mutate(input, rng);
+
+        StopReason reason = fuzz_run(input);
+
+        if (reason == STOP_HALT) {
+            if (fuzz_collect(crash_seen)) {
+                char name[32];
+                snprintf(name, sizeof(name), "crash-%016llx", xxh64(input));
+
+                fuzz_write(name, input);
+                printf("Crash: halted at %04X, input saved as \"%s\"\n", pc, name);
+            }
+
+            crashes++;
+            continue;
+        }
+
+        if (reason == STOP_CYCLES) timeouts++;
+
+        if (fuzz_collect(seen)) {
+            if (execs >= seeds) {
+                corpus.push_back(input);
+
+                if (queue) {
+                    char name[24];
+                    snprintf(name, sizeof(name), "%016llx", xxh64(input));
+
+                    fuzz_write(fs::path(fuzz_inputs) / name, input);
+                }
+            }
+        }
+
+        // Status once a second
+        if (!(execs & 0xFFF) && std::chrono::steady_clock::now() - last >= std::chrono::seconds(1)) {
+            last = std::chrono::steady_clock::now();
+            edges = std::count_if(seen.begin(), seen.end(), [](byte b) { return b != 0; });
+
+            printf("#%llu  edges: %d  inputs: %zu  crashes: %d  execs/s: %.0f\n", execs, edges, corpus.size(), crashes,
+                execs / std::chrono::duration<double>(last - begin).count());
+            fflush(stdout);
+        }
+
+        if (max_seconds && !(execs & 0xFFF) && std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count() >= max_seconds) break;
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    edges = std::count_if(seen.begin(), seen.end(), [](byte b) { return b != 0; });
+
+    printf("Fuzzed %llu inputs in %.2f s (%.0f execs/s): %d edges, %zu inputs kept, %d crashes, %llu out of cycles.\n",
+        execs, elapsed, execs / elapsed, edges, corpus.size(), crashes, timeouts);
+
+    return crashes ? STOP_HALT : STOP_BRK;
+}
+
+#ifndef _WIN32
+#include <sys/shm.h>
+#include <unistd.h>
+#include <signal.h>
+
+// Read the current input from AFL (a file given with -fi, which AFL rewrites each time, or stdin)
+string fuzz_afl_input() {
+    if (!fuzz_inputs.empty()) return fuzz_read(fuzz_inputs);
+
+    string input(fuzz_max_len, '\0');
+    ssize_t got, len = 0;
+
+    lseek(0, 0, SEEK_SET);
+
+    while (len < fuzz_max_len && (got = read(0, &input[len], fuzz_max_len - len)) > 0) {
+        len += got;
+    }
+
+    input.resize(len);
+
+    return input;
+}
+
+// Serve afl-fuzz as a persistent mode fork server that never forks, returns false if not started by afl-fuzz
+bool fuzz_afl(int& code) {
+    const char* id = getenv("__AFL_SHM_ID");
+    unsigned int hello = 0;
+
+    if (id == NULL) return false;
+
+    void* shared = shmat(atoi(id), NULL, 0);
+
+    if (shared == (void*)-1) return false;
+
+    if (write(FUZZ_FORKSRV_FD + 1, &hello, 4) != 4) {
+        shmdt(shared);
+        return false;
+    }
+
+    fuzz_map = (byte*)shared;
+
+    // AFL clears the map before each run and reads the status of the "child", which is this process
+    unsigned int was_killed;
+    int pid = getpid();
+
+    while (!broken && read(FUZZ_FORKSRV_FD, &was_killed, 4) == 4) {
+        if (write(FUZZ_FORKSRV_FD + 1, &pid, 4) != 4) break;
+
+        StopReason reason = fuzz_run(fuzz_afl_input());
+        int status = reason == STOP_HALT ? SIGILL : reason << 8; // Crashes look like a signal, the rest like an exit code
+
+        fuzz_touched_count = 0;
+
+        if (write(FUZZ_FORKSRV_FD + 1, &status, 4) != 4) break;
+    }
+
+    code = 0;
+    return true;
+}
+#else
+bool fuzz_afl(int& code) {
+    return false;
+}
+#endif
+
+// Fuzz the loaded program, returns the exit code
+int fuzz_main() {
+    int code;
+
+    fuzz_init();
+
+    if (fuzz_afl(code)) return code;
+
+    return fuzz_local();
+}
@@ -0,0 +1,427 @@
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstring>
+
+/* gdb.h
+  Contains a GDB remote serial protocol stub (enabled with -gd).
+  Registers are sent in the order a, x, y, sp, sr (one byte each) then pc (two bytes, little endian).
+*/
+
+// Set by the stub when the emulator should stop after the current instruction
+std::atomic<bool> gdb_attn(false);
+std::atomic<bool> gdb_connected(false);
+
+enum GdbState { GDB_RUNNING, GDB_STOPPED, GDB_EXITED };
+
+std::mutex gdb_mutex;
+std::condition_variable gdb_cv;
+GdbState gdb_state = GDB_RUNNING;
+int gdb_signal = 0;
+bool gdb_step = false;
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <poll.h>
+
+// Stop the emulator and wait until the debugger resumes it (called from the instruction loop)
+void gdb_stop(int sig) {
+    std::unique_lock<std::mutex> lock(gdb_mutex);
+
+    gdb_attn = false;
+    watch_hit = false;
+    gdb_signal = sig;
+    gdb_state = GDB_STOPPED;
+    gdb_cv.notify_all();
+
+    gdb_cv.wait(lock, [] { return gdb_state != GDB_STOPPED; });
+
+    break_skip = pc;
+}
+
+// Tell the debugger that execution finished, giving it a moment to receive that
+void gdb_exit() {
+    std::unique_lock<std::mutex> lock(gdb_mutex);
+
+    gdb_state = GDB_EXITED;
+    gdb_cv.notify_all();
+
+    gdb_cv.wait_for(lock, std::chrono::seconds(1), [] { return !gdb_connected; });
+}
+
+// Stop after a single step or an interrupt from the debugger
+void gdb_interrupt() {
+    gdb_stop(gdb_step ? 5 : 2);
+}
+
+// Handle a breakpoint or watchpoint, returns false if nothing is attached to handle it
+bool gdb_break() {
+    if (!gdb_connected) return false;
+
+    gdb_stop(5);
+    return true;
+}
+
+string gdb_hex(const byte* data, int len) {
+    string out;
+    char digits[3];
+
+    for (int i = 0; i < len; i++) {
+        snprintf(digits, sizeof(digits), "%02x", data[i]);
+        out += digits;
+    }
+
+    return out;
+}
+
+byte gdb_unhex(const string& str, size_t at) {
+    return std::stoul(str.substr(at, 2), nullptr, 16);
+}
+
+bool gdb_send(int fd, const string& data) {
+    byte sum = 0;
+
+    for (char c : data) {
+        sum += c;
+    }
+
+    char end[4];
+    snprintf(end, sizeof(end), "#%02x", sum);
+
+    string packet = "$" + data + end;
+
+    return send(fd, packet.data(), packet.length(), 0) == (ssize_t)packet.length();
+}
+
+// Read a packet, returning false once disconnected (an interrupt is returned as "\x03")
+bool gdb_recv(int fd, string& packet) {
+    packet.clear();
+
+    char c;
+    bool inside = false;
+
+    while (recv(fd, &c, 1, 0) == 1) {
+        if (!inside) {
+            if (c == 0x03) {
+                packet = "\x03";
+                return true;
+            }
+
+            inside = c == '$';
+        } else if (c == '#') {
+            char sum[2];
+
+            if (recv(fd, sum, 2, MSG_WAITALL) != 2) return false;
+
+            send(fd, "+", 1, 0);
+            return true;
+        } else {
+            packet += c;
+        }
+    }
+
+    return false;
+}
+
+// Let the emulator run until it stops, forwarding interrupts from the debugger
+string gdb_resume(int fd, bool step) {
+    {
+        std::lock_guard<std::mutex> lock(gdb_mutex);
+
+        gdb_attn = gdb_step = step;
+        gdb_state = GDB_RUNNING;
+        gdb_cv.notify_all();
+    }
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(gdb_mutex);
+
+            gdb_cv.wait_for(lock, std::chrono::milliseconds(10), [] { return gdb_state != GDB_RUNNING; });
+
+            if (gdb_state == GDB_EXITED) return "W00";
+
+            if (gdb_state == GDB_STOPPED) {
+                char reply[4];
+                snprintf(reply, sizeof(reply), "S%02x", gdb_signal);
+                return reply;
+            }
+        }
+
+        pollfd waiting = {fd, POLLIN, 0};
+
+        if (poll(&waiting, 1, 0) > 0) {
+            char c;
+
+            if (recv(fd, &c, 1, 0) != 1) return "";
+
+            if (c == 0x03) gdb_attn = true;
+        }
+    }
+}
+
+// Handle one command packet while the emulator is stopped
+string gdb_command(int fd, const string& packet, bool& done) {
+    switch (packet[0]) {
+        case '?': {
+            char reply[4];
+            snprintf(reply, sizeof(reply), "S%02x", gdb_signal);
+            return reply;
+        }
+
+        case 'g': {
+            byte regs[7] = {a, x, y, sp, sr.val(), (byte)(pc % 0x100), (byte)(pc / 0x100)};
+            return gdb_hex(regs, 7);
+        }
+
+        case 'G': {
+            if (packet.length() < 15) return "E01";
+
+            a = gdb_unhex(packet, 1);
+            x = gdb_unhex(packet, 3);
+            y = gdb_unhex(packet, 5);
+            sp = gdb_unhex(packet, 7);
+            sr.set(gdb_unhex(packet, 9));
+            pc = gdb_unhex(packet, 11) + 0x100 * gdb_unhex(packet, 13);
+
+            return "OK";
+        }
+
+        case 'p': {
+            int reg = std::stoul(packet.substr(1), nullptr, 16);
+            byte regs[7] = {a, x, y, sp, sr.val(), (byte)(pc % 0x100), (byte)(pc / 0x100)};
+
+            if (reg < 5) return gdb_hex(&regs[reg], 1);
+            if (reg == 5) return gdb_hex(&regs[5], 2);
+
+            return "E01";
+        }
+
+        case 'P': {
+            size_t eq = packet.find('=');
+
+            if (eq == string::npos) return "E01";
+
+            int reg = std::stoul(packet.substr(1, eq - 1), nullptr, 16);
+            byte val = gdb_unhex(packet, eq + 1);
+
+            switch (reg) {
+                case 0: a = val; break;
+                case 1: x = val; break;
+                case 2: y = val; break;
+                case 3: sp = val; break;
+                case 4: sr.set(val); break;
+                case 5: pc = val + (packet.length() >= eq + 5 ? 0x100 * gdb_unhex(packet, eq + 3) : 0); break;
+                default: return "E01";
+            }
+
+            return "OK";
+        }
+
+        case 'm':
+        case 'M': {
+            size_t comma = packet.find(',');
+
+            if (comma == string::npos) return "E01";
+
+            int addr = std::stoul(packet.substr(1, comma - 1), nullptr, 16);
+            int len = std::stoul(packet.substr(comma + 1), nullptr, 16);
+
+            if (addr + len > 0x10000) return "E01";
+
+            if (packet[0] == 'm') return gdb_hex(&memory[addr], len);
+
+            size_t colon = packet.find(':');
+
+            if (colon == string::npos || packet.length() < colon + 1 + 2 * len) return "E01";
+
+            for (int i = 0; i < len; i++) {
+                memory[addr + i] = gdb_unhex(packet, colon + 1 + 2 * i);
+            }
+
+            return "OK";
+        }
+
+        case 'Z':
+        case 'z': {
+            // Z0/Z1 breakpoint, Z2 write, Z3 read, Z4 access watchpoint ("Ztype,addr,kind")
+            size_t first = packet.find(',');
+            size_t second = packet.find(',', first + 1);
+
+            if (first == string::npos) return "E01";
+
+            int type = packet[1] - '0';
+            int addr = std::stoul(packet.substr(first + 1, second - first - 1), nullptr, 16);
+            int len = second == string::npos ? 1 : std::stoul(packet.substr(second + 1), nullptr, 16);
+
+            if (type > 4 || addr > 0xFFFF) return "";
+
+            for (int i = addr; i < addr + (type < 2 ? 1 : len) && i <= 0xFFFF; i++) {
+                if (type < 2) {
+                    if (packet[0] == 'Z') bit_set(break_bits, i);
+                    else bit_clear(break_bits, i);
+                }
+
+                if (type == 2 || type == 4) {
+                    if (packet[0] == 'Z') bit_set(write_bits, i);
+                    else bit_clear(write_bits, i);
+                }
+
+                if (type == 3 || type == 4) {
+                    if (packet[0] == 'Z') bit_set(read_bits, i);
+                    else bit_clear(read_bits, i);
+                }
+            }
+
+            if (packet[0] == 'Z') {
+                debugging = true;
+                watching |= type > 1;
+                watchpoints |= type > 1;
+            }
+
+            return "OK";
+        }
+
+        case 'c':
+        case 's':
+            if (packet.length() > 1) pc = std::stoul(packet.substr(1), nullptr, 16);
+
+            return gdb_resume(fd, packet[0] == 's');
+
+        case 'D':
+            done = true;
+            return "OK";
+
+        case 'k':
+            broken = true;
+            done = true;
+            return "";
+
+        case 'H':
+            return "OK";
+
+        case 'q':
+            if (packet.substr(0, 10) == "qSupported") return "PacketSize=1000";
+            if (packet == "qAttached") return "1";
+            if (packet == "qC") return "QC1";
+            if (packet == "qfThreadInfo") return "m1";
+            if (packet == "qsThreadInfo") return "l";
+
+            return "";
+    }
+
+    return "";
+}
+
+// Serve debugger connections (runs on its own thread)
+void gdb_serve(int listener) {
+    while (true) {
+        int fd = accept(listener, NULL, NULL);
+
+        if (fd < 0) continue;
+
+        // Wait for the emulator to stop before taking commands
+        {
+            std::unique_lock<std::mutex> lock(gdb_mutex);
+
+            gdb_connected = true;
+            gdb_attn = true;
+
+            gdb_cv.wait(lock, [] { return gdb_state != GDB_RUNNING; });
+        }
+
+        string packet;
+        bool done = false;
+
+        while (!done && gdb_recv(fd, packet)) {
+            if (packet == "\x03") continue;
+
+            string reply;
+
+            try {
+                reply = gdb_command(fd, packet, done);
+            } catch (...) {
+                reply = "E01";
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(gdb_mutex);
+
+                if (gdb_state == GDB_EXITED) reply = "W00";
+            }
+
+            if (!gdb_send(fd, reply)) break;
+
+            if (reply == "W00") break;
+        }
+
+        close(fd);
+
+        // Let the emulator continue without a debugger
+        std::lock_guard<std::mutex> lock(gdb_mutex);
+
+        gdb_connected = false;
+        gdb_attn = false;
+
+        if (gdb_state == GDB_STOPPED) gdb_state = GDB_RUNNING;
+        gdb_cv.notify_all();
+    }
+}
+
+// Start listening on a TCP port on localhost, or a Unix socket path
+bool gdb_listen(string where) {
+    int listener;
+    bool port = where.find_first_not_of("0123456789") == string::npos;
+
+    if (port) {
+        sockaddr_in addr = {};
+        int number;
+
+        if (where.length() > 5 || !parse_num(where, number) || number < 1 || number > 0xFFFF) return false;
+
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(number);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+
+        if (listener < 0) return false;
+
+        int reuse = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        if (bind(listener, (sockaddr*)&addr, sizeof(addr)) < 0) return false;
+    } else {
+        sockaddr_un addr = {};
+
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, where.c_str(), sizeof(addr.sun_path) - 1);
+
+        unlink(where.c_str());
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        if (listener < 0 || bind(listener, (sockaddr*)&addr, sizeof(addr)) < 0) return false;
+    }
+
+    if (listen(listener, 1) < 0) return false;
+
+    std::thread(gdb_serve, listener).detach();
+
+    return true;
+}
+#else
+void gdb_stop(int sig) {}
+void gdb_interrupt() {}
+void gdb_exit() {}
+bool gdb_break() { return false; }
+
+bool gdb_listen(string where) {
+    printf("The GDB stub is not supported on Windows.\n");
+    return false;
+}
+#endif
@@ -0,0 +1,224 @@
+#include <vector>
+#include <cctype>
+
+/* hyper.h
+  Contains the hypercall port (-hc), through which a program has the host do work that would take it a long loop:
+  copying and filling memory, formatted printing and file reads and writes. Like the block device's, its registers
+  are plain memory. The program puts the arguments in them and stores the call number to +0, and the call is done
+  within that store, taking no cycles of its own, with the status and result in place for the next instruction.
+
+    +0  Call: 1 copy, 2 fill, 3 print, 4 open, 5 close, 6 read, 7 write
+    +1  Status: 0 done, 1 failed
+    +2  First argument (16 bits)
+    +4  Second argument (16 bits)
+    +6  Third argument (16 bits)
+    +8  Result (16 bits)
+
+  Copy: to the first from the second, the third bytes (overlapping is fine). Fill: the first, with the low byte of
+  the second, the third bytes. Print: the zero terminated format at the first like printf (%d %u %x %X %c %s %%, with
+  flags, a width and l for 32 bits), taking the arguments from the list at the second (16 bits each, 32 with l, and
+  for %s the address of a zero terminated string). Open: the file named at the first, for reading (second 0),
+  writing (1) or appending (2), the result is the handle. Close: the handle in the first. Read and write: with the
+  handle in the first, to or from the second, the third bytes, the result is the bytes moved.
+*/
+
+int hyper_start = -1;
+
+#define HYPER_TEXT 0x1000      // Longest string read from memory, or text printed by a call
+
+enum HyperCall { HC_COPY = 1, HC_FILL, HC_PRINT, HC_OPEN, HC_CLOSE, HC_READ, HC_WRITE };
+
+std::vector<FILE*> hyper_files;  // Open files, the handle is the index plus one
+
+inline byte& hyper_reg(int offset) {
+    return memory[hyper_start + offset];
+}
+
+inline int hyper_arg(int n) {
+    return hyper_reg(2 + n * 2) | hyper_reg(3 + n * 2) << 8;
+}
+
+// Read a zero terminated string, returns false if it is longer than HYPER_TEXT
+bool hyper_string(byte2 addr, string& out) {
+    for (out.clear(); memory[addr]; addr++) {
+        if (out.size() == HYPER_TEXT) return false;
+
+        out += (char)memory[addr];
+    }
+
+    return true;
+}
+
+// Format the string at fmt with the arguments at args, returns false on a bad conversion or a runaway string
+bool hyper_format(byte2 fmt, byte2 args, string& out) {
+    string text;
+
+    if (!hyper_string(fmt, text)) return false;
+
+    for (size_t i = 0; i < text.size(); i++) {
+        if (out.size() > HYPER_TEXT) return false;
+
+        if (text[i] != '%') {
+            out += text[i];
+            continue;
+        }
+
+        string spec = "%";
+        int width = 0;
+
+        while (++i < text.size() && strchr("-+ 0#", text[i])) spec += text[i];
+        for (; i < text.size() && isdigit((byte)text[i]); i++) {
+            width = width * 10 + text[i] - '0';
+            spec += text[i];
+        }
+
+        bool wide = i < text.size() && text[i] == 'l';
+
+        if (wide) i++;
+        if (i == text.size() || width > 64) return false;
+
+        char conv = text[i];
+        unsigned long val = memory[args] | memory[(byte2)(args + 1)] << 8;
+
+        if (wide) val |= (unsigned long)(memory[(byte2)(args + 2)] | memory[(byte2)(args + 3)] << 8) << 16;
+
+        char buf[80];
+
+        switch (conv) {
+            case '%':
+                out += '%';
+                continue;
+            case 'd':
+                snprintf(buf, sizeof(buf), (spec + "ld").c_str(), wide ? (long)(int32_t)val : (long)(int16_t)val);
+                break;
+            case 'u': case 'x': case 'X':
+                snprintf(buf, sizeof(buf), (spec + 'l' + conv).c_str(), val);
+                break;
+            case 'c':
+                snprintf(buf, sizeof(buf), (spec + 'c').c_str(), (int)(byte)val);
+                break;
+            case 's': {
+                string str;
+
+                if (!hyper_string(val, str)) return false;
+
+                string pad(std::max(width - (int)str.size(), 0), ' ');
+
+                out += spec.find('-') != string::npos ? str + pad : pad + str;
+                args += 2;
+                continue;
+            }
+            default:
+                return false;
+        }
+
+        out += buf;
+        args += wide ? 4 : 2;
+    }
+
+    return true;
+}
+
+FILE* hyper_file(int handle) {
+    return handle >= 1 && handle <= (int)hyper_files.size() ? hyper_files[handle - 1] : NULL;
+}
+
+// Run a call, returns false if it failed
+bool hyper_call(byte call) {
+    int first = hyper_arg(0), second = hyper_arg(1), len = hyper_arg(2);
+    string text;
+
+    switch (call) {
+        case HC_COPY: {
+            if (first + len > 0x10000 || second + len > 0x10000) return false;
+
+            std::vector<byte> bytes(&memory[second], &memory[second] + len);
+            machine_write(first, bytes.data(), len);
+            return true;
+        }
+
+        case HC_FILL: {
+            if (first + len > 0x10000) return false;
+
+            std::vector<byte> bytes(len, second & 0xFF);
+            machine_write(first, bytes.data(), len);
+            return true;
+        }
+
+        case HC_PRINT:
+            if (!hyper_format(first, second, text)) return false;
+
+            print_text(text);
+            return true;
+
+        case HC_OPEN: {
+            const char* modes[] = {"rb", "wb", "ab"};
+
+            if (second > 2 || !hyper_string(first, text)) return false;
+
+            FILE* file = fopen(text.c_str(), modes[second]);
+
+            if (file == NULL) return false;
+
+            hyper_files.push_back(file);
+            hyper_reg(8) = hyper_files.size() & 0xFF;
+            hyper_reg(9) = hyper_files.size() >> 8;
+            return true;
+        }
+
+        case HC_CLOSE: {
+            FILE* file = hyper_file(first);
+
+            if (file == NULL) return false;
+
+            fclose(file);
+            hyper_files[first - 1] = NULL;
+            return true;
+        }
+
+        case HC_READ: case HC_WRITE: {
+            FILE* file = hyper_file(first);
+
+            if (file == NULL || second + len > 0x10000) return false;
+
+            size_t moved;
+
+            if (call == HC_READ) {
+                std::vector<byte> bytes(len);
+
+                moved = fread(bytes.data(), 1, len, file);
+                machine_write(second, bytes.data(), moved);
+            } else {
+                moved = fwrite(&memory[second], 1, len, file);
+            }
+
+            hyper_reg(8) = moved & 0xFF;
+            hyper_reg(9) = moved >> 8;
+            return moved == (size_t)len || (call == HC_READ && feof(file));
+        }
+    }
+
+    return false;
+}
+
+void hyper_write(byte2 addr, byte val) {
+    if (addr != hyper_start) return;
+
+    hyper_reg(1) = hyper_call(val) ? 0 : 1;
+}
+
+unsigned long long hyper_event() {
+    return ~0ull;
+}
+
+// Attach the port, returns false if its registers go past the end of memory
+bool hyper_attach() {
+    if (hyper_start + 10 > 0x10000) {
+        printf("The hypercall port goes past the maximum memory address (0xFFFF).\n");
+        return false;
+    }
+
+    io_attach({hyper_start, hyper_start + 10, NULL, hyper_write, NULL, hyper_event});
+
+    return true;
+}
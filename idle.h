@@ -0,0 +1,142 @@
+#include <chrono>
+#include <thread>
+
+/* idle.h
+  Contains the idle loop fast-forward, which skips a polling loop (such as LDA status / BEQ loop or JMP *) once it
+  can no longer change anything. When a loop comes back to its start with the same registers and its body writes
+  nothing, every further pass is the same pass, so the passes up to the next event (a limit, or a scheduled device
+  event in next_event) are added to the counts at once and the last ones are run, keeping counts and stops exact.
+*/
+
+bool idling = true; // Fast-forward idle loops (off with --ni, or when something sees every instruction)
+
+#define IDLE_BODY 32        // Most bytes in a loop body
+#define IDLE_WAIT 10        // Milliseconds between checks while waiting on a loop nothing can end
+#define IDLE_SAMPLE 64      // Backward jumps between looking for an idle loop
+
+// Registers when a loop last came back to its start
+struct IdlePass {
+    byte2 head, at;
+    byte a, x, y, sp, status;
+    unsigned long long cycles, events;
+} idle_last;
+
+byte2 idle_rejected = 0xFFFF;  // Backward jump whose loop body last failed the check
+
+// Loops are sampled every so many backward jumps, then each pass is compared with the one before while they repeat
+int idle_countdown = IDLE_SAMPLE;
+bool idle_comparing = false;
+
+// Whether an instruction's read gives the same value until the next event (device registers may not)
+bool idle_read_stable(int ins, OpMode mode) {
+    byte2 addr = memory[(byte2)(ins + 2)] * 0x100 + memory[(byte2)(ins + 1)];
+
+    switch (mode) {
+        case O_ABS: return io_stable(addr);
+        case O_ABX: case O_ABY: return !io_pages[addr >> 8] && !io_pages[(byte2)(addr + 0xFF) >> 8];
+        case O_IZX: case O_IZY: return devices.empty();
+        default: return true;
+    }
+}
+
+// Instructions in one pass of the loop from head to the jump back at, or 0 if a pass could write memory or the stack
+int idle_body(byte2 head, byte2 at) {
+    int count = 0;
+
+    if (at < head || at - head >= IDLE_BODY) return 0;
+
+    for (int ins = head; ins <= at; ) {
+        byte opcode = memory[ins];
+        const OpInfo& info = op_info[opcode];
+
+        // Only the documented 6502 opcodes are looked at, and none that write memory or the stack
+        if (info.variant != V_6502 || op_is(info, {"BRK", "JSR", "RTS", "RTI", "PHA", "PHP", "PLA", "PLP", "STA", "STX", "STY"})) return 0;
+
+        if (op_is(info, {"ASL", "LSR", "ROL", "ROR", "INC", "DEC"})) {
+            if (info.mode != O_ACC) return 0;
+        } else if (op_same(info.name, "JMP")) {
+            if (ins != at || info.mode != O_ABS) return 0;
+        } else {
+            // Branches out of the loop aren't taken once it idles, any others would change the pass
+            if (info.mode == O_REL && ins != at && (byte2)(ins + 2 + (signed char)memory[(byte2)(ins + 1)]) <= at) return 0;
+            if (!idle_read_stable(ins, info.mode)) return 0;
+        }
+
+        count++;
+
+        if (ins == at) return count;
+
+        ins += info.length;
+    }
+
+    return 0;
+}
+
+// Wait on a loop that no limit or event ends, until Ctrl+C or the timeout
+void idle_wait() {
+    while (!broken) {
+        if (max_seconds && std::chrono::duration<double>(std::chrono::steady_clock::now() - budget_begin).count() >= max_seconds) {
+            budget_next = instructions; // Checked after the next instruction
+            return;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(IDLE_WAIT));
+    }
+}
+
+// Compare a pass of a loop with the pass before, returns the instructions skipped
+unsigned long long idle_check(byte2 at, int frequency) {
+    IdlePass last = idle_last;
+
+    idle_last = {pc, at, a, x, y, sp, sr.val(), cycles, io_events};
+    idle_countdown = 1;
+
+    if (!idle_comparing) {
+        idle_comparing = true;
+        return 0;
+    }
+
+    bool same = last.head == pc && last.at == at && last.a == a && last.x == x && last.y == y && last.sp == sp && last.status == idle_last.status && last.events == io_events;
+    int count = same && at != idle_rejected ? idle_body(pc, at) : 0;
+
+    if (!count) {
+        if (same) idle_rejected = at;
+
+        idle_comparing = false;
+        idle_countdown = IDLE_SAMPLE;
+        return 0;
+    }
+
+    // Passes before the next limit or event, leaving the last to run so it stops where it would have
+    unsigned long long pass = cycles - last.cycles, passes = ~0ull;
+
+    if (max_cycles) passes = std::min(passes, max_cycles > cycles ? (max_cycles - cycles) / pass : 0);
+    if (max_instructions) passes = std::min(passes, max_instructions > instructions ? (max_instructions - instructions) / count : 0);
+    if (next_event != ~0ull) passes = std::min(passes, next_event > cycles ? (next_event - cycles) / pass : 0);
+
+    if (passes == ~0ull) {
+        if (!frequency) {
+            idle_wait();
+            return 0;
+        }
+
+        passes = std::max(1ull, (unsigned long long)frequency / 100 / count); // About 10 ms at a time
+    } else {
+        passes = passes > 1 ? passes - 1 : 0;
+    }
+
+    cycles += passes * pass;
+    idle_last.cycles = cycles;
+
+    if (budgeting) instructions += passes * count;
+
+    return passes * count;
+}
+
+// Called after a jump or taken branch backwards from at, returns the instructions skipped by fast-forwarding
+// (with -mf passes are skipped about 10 ms at a time, and slept through by the pacing)
+inline unsigned long long idle_loop(byte2 at, int frequency) {
+    if (--idle_countdown) return 0;
+
+    return idle_check(at, frequency);
+}
@@ -0,0 +1,97 @@
+#include <vector>
+#include <algorithm>
+
+/* io.h
+  Contains the memory mapped devices. Their registers are bytes of memory: reads through the addressing modes have
+  the device put the register's value in place first (watch_access in debug.h), and stores reach it from st_print
+  (or rmw_store, with the value a read-modify-write instruction leaves).
+  Devices don't run alongside the CPU. They work their state out from the cycle count when a register is used, and
+  anything they do on their own (a timer running out) is an event, with next_event holding the earliest, so the
+  instruction loop only compares the cycle count with it. IRQs are taken at the first instruction boundary once a
+  device pulls the line (irq_sources) and interrupts are enabled.
+*/
+
+struct Device {
+    int start, end;                         // Registers (end exclusive)
+    void (*read)(byte2 addr);               // Put a register's value in memory before it is read (NULL if memory holds it)
+    void (*write)(byte2 addr, byte val);    // Take a store to a register
+    bool (*stable)(byte2 addr);             // Whether reading a register has no effect and gives the same value until the next event (NULL if always)
+    unsigned long long (*event)();          // Catch up to the cycle count, returns the cycle of the next event (~0 for none)
+};
+
+std::vector<Device> devices;
+unsigned long long io_events = 0;           // Events handled, so an idle loop can tell one happened during a pass
+
+void io_attach(Device device) {
+    devices.push_back(device);
+
+    for (int page = device.start >> 8; page <= (device.end - 1) >> 8; page++) {
+        io_pages[page] = true;
+    }
+
+    // Reads only need the addressing modes to check for devices that answer them
+    if (device.read != NULL) watching = true;
+}
+
+Device* io_find(byte2 addr) {
+    for (Device& device : devices) {
+        if (addr >= device.start && addr < device.end) return &device;
+    }
+
+    return NULL;
+}
+
+// Bring every device up to date and find the next event (now, if an IRQ can be taken)
+void io_schedule() {
+    next_event = ~0ull;
+
+    for (Device& device : devices) {
+        next_event = std::min(next_event, device.event());
+    }
+
+    if (irq_sources && !sr.i) next_event = 0;
+}
+
+void io_access(byte2 addr, byte opcode) {
+    Device* device = io_find(addr);
+    AccessKind kind = access_kind(opcode);
+
+    if (device == NULL || device->read == NULL || kind == ACCESS_WRITE || kind == ACCESS_NONE) return;
+
+    STAT(stat_io_hits++;)
+
+    device->read(addr);
+    io_schedule();
+}
+
+// Send a store to the device whose register it is, returns false if there is none
+bool io_write(byte2 addr, byte val) {
+    Device* device = io_find(addr);
+
+    if (device == NULL) return false;
+
+    STAT(stat_io_hits++;)
+
+    device->write(addr, val);
+    io_schedule();
+
+    return true;
+}
+
+// Called between instructions once the cycle count reaches next_event
+void io_event() {
+    io_events++;
+    io_schedule();
+
+    if (irq_sources && !sr.i) {
+        interrupt();
+        io_schedule();
+    }
+}
+
+// Whether reading an address gives the same value with no effect until the next event (true for memory)
+bool io_stable(byte2 addr) {
+    Device* device = io_pages[addr >> 8] ? io_find(addr) : NULL;
+
+    return device == NULL || device->stable == NULL || device->stable(addr);
+}
@@ -0,0 +1,660 @@
+#include <vector>
+#include <cstring>
+#include <chrono>
+
+/* lanes.h
+  Contains the lane engine (-ln), which runs many copies of a program side by side.
+  Registers and memory are kept in structure of arrays layout (lane_mem[addr] holds that byte of every lane).
+  Lanes at the same pc with the same instruction and addresses run it together on vectors, other lanes run it
+  one at a time through the instruction functions in ops.h. Only the documented opcodes are supported, a lane stops at any other.
+*/
+
+std::vector<string> lane_vary; // Addresses or registers set to the instance number in each lane
+int lane_instances = 0;
+
+#if defined(__GNUC__)
+// Nothing here crosses a library boundary, so the vector ABI notes don't matter
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+// A vector holds one byte of every lane (32 with AVX2, 16 with SSE2)
+#if defined(__AVX2__)
+#define LANES 32
+#else
+#define LANES 16
+#endif
+
+typedef byte LaneVec __attribute__((vector_size(LANES)));
+typedef signed char LaneMask __attribute__((vector_size(LANES)));
+typedef unsigned short LanePc __attribute__((vector_size(LANES * 2)));
+typedef short LaneMask16 __attribute__((vector_size(LANES * 2)));
+typedef unsigned long long LaneCount __attribute__((vector_size(LANES * 8)));
+typedef long long LaneMask64 __attribute__((vector_size(LANES * 8)));
+
+struct Lanes {
+    LaneVec a, x, y, sp, p;
+    LanePc pc;
+    LaneCount cycles, count;
+    LaneVec running;          // 0xFF while the lane runs
+    byte reason[LANES];       // StopReason once stopped
+    string out[LANES];        // Written to the printing address
+};
+
+Lanes lanes;
+LaneVec lane_mem[0x10000];
+
+// Instructions run together and alone
+unsigned long long lane_vector_ins = 0;
+unsigned long long lane_scalar_ins = 0;
+
+inline byte& lane_byte(byte2 addr, int lane) {
+    return ((byte*)&lane_mem[addr])[lane];
+}
+
+inline bool lane_all(LaneVec mask) {
+    unsigned long long words[LANES / 8];
+    unsigned long long all = ~0ull;
+
+    memcpy(words, &mask, LANES);
+
+    for (int i = 0; i < LANES / 8; i++) {
+        all &= words[i];
+    }
+
+    return all == ~0ull;
+}
+
+inline bool lane_any(LaneVec mask) {
+    unsigned long long words[LANES / 8];
+    unsigned long long any = 0;
+
+    memcpy(words, &mask, LANES);
+
+    for (int i = 0; i < LANES / 8; i++) {
+        any |= words[i];
+    }
+
+    return any;
+}
+
+inline LaneVec lane_blend(LaneVec mask, LaneVec yes, LaneVec no) {
+    return (yes & mask) | (no & ~mask);
+}
+
+// Widen a lane mask for the pc and counters
+inline LanePc lane_mask16(LaneVec mask) {
+    return (LanePc)__builtin_convertvector((LaneMask)mask, LaneMask16);
+}
+
+inline LaneCount lane_mask64(LaneVec mask) {
+    return (LaneCount)__builtin_convertvector((LaneMask)mask, LaneMask64);
+}
+
+inline LanePc lane_blend16(const LanePc& mask, const LanePc& yes, const LanePc& no) {
+    return (yes & mask) | (no & ~mask);
+}
+
+inline int lane_count(LaneVec mask) {
+    unsigned long long words[LANES / 8];
+    int count = 0;
+
+    memcpy(words, &mask, LANES);
+
+    for (int i = 0; i < LANES / 8; i++) {
+        count += __builtin_popcountll(words[i]) / 8;
+    }
+
+    return count;
+}
+
+inline LaneVec lane_nz(LaneVec p, LaneVec val) {
+    return (p & (byte)~(F_N | F_Z)) | (val & F_N) | ((LaneVec)(val == 0) & F_Z);
+}
+
+void lane_stop(int lane, StopReason reason) {
+    lanes.running[lane] = 0;
+    lanes.reason[lane] = reason;
+}
+
+// Put every lane at power on state with the contents of memory
+void lanes_load(int first) {
+    for (int addr = 0; addr < 0x10000; addr++) {
+        lane_mem[addr] = (LaneVec){} + memory[addr];
+    }
+
+    lanes.a = lanes.x = lanes.y = (LaneVec){};
+    lanes.sp = (LaneVec){} + 0xFF;
+    lanes.p = (LaneVec){} + StatusRegister().val();
+    lanes.pc = (LanePc){} + (byte2)(0x100 * memory[0xFFFD] + memory[0xFFFC]);
+    lanes.cycles = lanes.count = (LaneCount){};
+    lanes.running = (LaneVec){} + 0xFF;
+
+    for (int lane = 0; lane < LANES; lane++) {
+        lanes.out[lane].clear();
+
+        if (first + lane >= lane_instances) lane_stop(lane, STOP_BRK);
+
+        for (string& vary : lane_vary) {
+            byte val = first + lane;
+            int addr;
+
+            if (vary == "a") lanes.a[lane] = val;
+            else if (vary == "x") lanes.x[lane] = val;
+            else if (vary == "y") lanes.y[lane] = val;
+            else if (parse_num(vary, addr)) lane_byte(addr, lane) = val;
+        }
+    }
+}
+
+byte lane_pull(int lane) {
+    return lane_byte(0x100 + ++sp, lane);
+}
+
+void lane_push(int lane, byte val) {
+    lane_byte(0x100 + sp--, lane) = val;
+}
+
+// Run the instruction at a lane's pc through the functions in ops.h, with that lane's registers swapped in
+void lanes_scalar(int lane) {
+    a = lanes.a[lane];
+    x = lanes.x[lane];
+    y = lanes.y[lane];
+    sp = lanes.sp[lane];
+    sr.set(lanes.p[lane]);
+    pc = lanes.pc[lane];
+    cycles = lanes.cycles[lane];
+
+    byte2 at = pc;
+    byte opcode = lane_byte(pc, lane);
+    byte o1 = lane_byte(pc + 1, lane), o2 = lane_byte(pc + 2, lane);
+    byte2 abs = o1 + 0x100 * o2;
+    byte2 addr = 0;
+    const RefEntry& ins = ref_table[opcode];
+
+    switch (ins.mode) {
+        case M_IMM: addr = pc + 1; break;
+        case M_ZP: addr = o1; break;
+        case M_ZPX: addr = (byte)(o1 + x); break;
+        case M_ZPY: addr = (byte)(o1 + y); break;
+        case M_ABS: addr = abs; break;
+        case M_ABX: addr = abs + x; break;
+        case M_ABY: addr = abs + y; break;
+        #if defined(CPU_65C02)
+        case M_IND: addr = lane_byte(abs, lane) + 0x100 * lane_byte(abs + 1, lane); break;
+        #else
+        case M_IND: addr = lane_byte(abs, lane) + 0x100 * lane_byte((abs & 0xFF00) | (byte)(abs + 1), lane); break;
+        #endif
+        case M_IZX: addr = lane_byte((byte)(o1 + x), lane) + 0x100 * lane_byte((byte)(o1 + x + 1), lane); break;
+        case M_IZY: addr = lane_byte(o1, lane) + 0x100 * lane_byte((byte)(o1 + 1), lane) + y; break;
+        default: break;
+    }
+
+    byte& ref = ins.mode == M_ACC ? a : lane_byte(addr, lane);
+    bool jumped = false;
+    bool stored = false;    // By a store instruction, which prints (as st_print does, read-modify-writes don't)
+
+    switch (ins.op) {
+        case R_XXX: lane_stop(lane, STOP_HALT); return;
+
+        case R_BRK:
+            lane_push(lane, (pc + 2) / 0x100);
+            lane_push(lane, (pc + 2) % 0x100);
+            lane_push(lane, sr.val() | 0b00110000);
+            sr.i = true;
+            #if defined(CPU_65C02)
+            sr.d = false;
+            #endif
+
+            // Stays on the BRK unless continuing from the IRQ vector
+            if (brk_stop) pc = lane_byte(0xFFFE, lane) + 0x100 * lane_byte(0xFFFF, lane);
+            else lane_stop(lane, STOP_BRK);
+
+            jumped = true;
+            break;
+
+        case R_ADC: ADC(ref); break;
+        case R_SBC: SBC(ref); break;
+        case R_AND: AND(ref); break;
+        case R_ORA: ORA(ref); break;
+        case R_EOR: EOR(ref); break;
+        case R_BIT: BIT(ref); break;
+        case R_CMP: CMP(ref); break;
+        case R_CPX: CPX(ref); break;
+        case R_CPY: CPY(ref); break;
+        case R_LDA: LDA(ref); break;
+        case R_LDX: LDX(ref); break;
+        case R_LDY: LDY(ref); break;
+
+        case R_ASL: ASL(ref); break;
+        case R_LSR: LSR(ref); break;
+        case R_ROL: ROL(ref); break;
+        case R_ROR: ROR(ref); break;
+        case R_INC: INC(ref); break;
+        case R_DEC: DEC(ref); break;
+        case R_STA: STA(ref); stored = true; break;
+        case R_STX: STX(ref); stored = true; break;
+        case R_STY: STY(ref); stored = true; break;
+
+        case R_INX: INX(); break;
+        case R_INY: INY(); break;
+        case R_DEX: DEX(); break;
+        case R_DEY: DEY(); break;
+        case R_TAX: TAX(); break;
+        case R_TAY: TAY(); break;
+        case R_TXA: TXA(); break;
+        case R_TYA: TYA(); break;
+        case R_TSX: TSX(); break;
+        case R_TXS: TXS(); break;
+        case R_CLC: CLC(); break;
+        case R_SEC: SEC(); break;
+        case R_CLI: CLI(); break;
+        case R_SEI: SEI(); break;
+        case R_CLD: CLD(); break;
+        case R_SED: SED(); break;
+        case R_CLV: CLV(); break;
+        case R_NOP: NOP(); break;
+
+        case R_BPL: BPL(o1); break;
+        case R_BMI: BMI(o1); break;
+        case R_BVC: BVC(o1); break;
+        case R_BVS: BVS(o1); break;
+        case R_BCC: BCC(o1); break;
+        case R_BCS: BCS(o1); break;
+        case R_BNE: BNE(o1); break;
+        case R_BEQ: BEQ(o1); break;
+
+        // The stack lives in lane memory, so these can't use the functions in ops.h
+        case R_PHA: lane_push(lane, a); break;
+        case R_PHP: lane_push(lane, sr.val() | 0b00110000); break;
+        case R_PLA: set_nz(a = lane_pull(lane)); break;
+        case R_PLP: sr.set(lane_pull(lane) | 0b00110000); break;
+
+        case R_JMP:
+            pc = addr;
+            jumped = true;
+            break;
+
+        case R_JSR:
+            lane_push(lane, (pc + 2) / 0x100);
+            lane_push(lane, (pc + 2) % 0x100);
+            pc = abs;
+            jumped = true;
+            break;
+
+        case R_RTI:
+            sr.set(lane_pull(lane) | 0b00110000);
+            pc = lane_pull(lane);
+            pc += 0x100 * lane_pull(lane);
+            jumped = true;
+            break;
+
+        case R_RTS:
+            pc = lane_pull(lane);
+            pc += 0x100 * lane_pull(lane) + 1;
+            jumped = true;
+            break;
+    }
+
+    if (stored && print_out && addr == print_ptr - memory) lanes.out[lane] += (char)ref;
+
+    if (!jumped) pc += ref_lengths[ins.mode];
+
+    cycles += op_cycles[opcode];
+    lane_scalar_ins++;
+
+    lanes.a[lane] = a;
+    lanes.x[lane] = x;
+    lanes.y[lane] = y;
+    lanes.sp[lane] = sp;
+    lanes.p[lane] = sr.val();
+    lanes.pc[lane] = pc;
+    lanes.cycles[lane] = cycles;
+    lanes.count[lane]++;
+
+    if (pc == at && sr.i && lanes.running[lane]) lane_stop(lane, STOP_HANG);
+}
+
+// Whether a register holds the same value in every lane of the group
+inline bool lane_uniform(LaneVec mask, LaneVec reg, byte val) {
+    return lane_all(~mask | (LaneVec)(reg == val));
+}
+
+// Run the instruction for every lane in the group on vectors, returns false if it has to run lane by lane
+bool lanes_vector(LaneVec mask, int lead, byte2 at) {
+    byte opcode = lane_byte(at, lead);
+    byte o1 = lane_byte(at + 1, lead), o2 = lane_byte(at + 2, lead);
+    byte2 abs = o1 + 0x100 * o2;
+    const RefEntry& ins = ref_table[opcode];
+
+    LaneVec A = lanes.a, X = lanes.x, Y = lanes.y, S = lanes.sp, P = lanes.p;
+    byte x0 = X[lead], y0 = Y[lead], s0 = S[lead];
+
+    // Effective address, which has to be the same for every lane
+    int addr = -1;
+
+    switch (ins.mode) {
+        case M_ZP: addr = o1; break;
+        case M_ABS: addr = abs; break;
+
+        case M_ZPX: case M_ABX: case M_IZX:
+            if (!lane_uniform(mask, X, x0)) return false;
+
+            addr = ins.mode == M_ZPX ? (byte)(o1 + x0) : ins.mode == M_ABX ? (byte2)(abs + x0) : -2;
+            break;
+
+        case M_ZPY: case M_ABY: case M_IZY:
+            if (!lane_uniform(mask, Y, y0)) return false;
+
+            addr = ins.mode == M_ZPY ? (byte)(o1 + y0) : ins.mode == M_ABY ? (byte2)(abs + y0) : -2;
+            break;
+
+        case M_IND: return false;
+        default: break;
+    }
+
+    // Indirect modes also need the same pointer in every lane
+    if (addr == -2) {
+        byte ptr = ins.mode == M_IZX ? o1 + x0 : o1;
+        byte lo = lane_byte(ptr, lead), hi = lane_byte((byte)(ptr + 1), lead);
+
+        if (!lane_uniform(mask, lane_mem[ptr], lo) || !lane_uniform(mask, lane_mem[(byte)(ptr + 1)], hi)) return false;
+
+        addr = (byte2)(lo + 0x100 * hi + (ins.mode == M_IZY ? y0 : 0));
+    }
+
+    LaneVec val = ins.mode == M_IMM ? (LaneVec){} + o1 : ins.mode == M_ACC ? A : addr >= 0 ? lane_mem[addr] : (LaneVec){};
+    LaneVec res = val;
+
+    int write = -1;        // Address written
+    int target = -1;       // New pc when jumping
+    LaneVec taken = {};    // Lanes taking a branch
+
+    switch (ins.op) {
+        case R_ADC: case R_SBC: {
+            if (lane_any(mask & P & F_D)) return false; // Decimal mode is left to ops.h
+
+            if (ins.op == R_SBC) val = ~val;
+
+            LaneVec sum = A + val + (P & F_C);
+            LaneVec carry = ((A & val) | ((A | val) & ~sum)) >> 7;
+            LaneVec overflow = (~(A ^ val) & (A ^ sum) & 0x80) >> 1;
+
+            P = lane_nz((P & (byte)~(F_C | F_V)) | carry | overflow, A = sum);
+            break;
+        }
+
+        case R_AND: P = lane_nz(P, A &= val); break;
+        case R_ORA: P = lane_nz(P, A |= val); break;
+        case R_EOR: P = lane_nz(P, A ^= val); break;
+        case R_LDA: P = lane_nz(P, A = val); break;
+        case R_LDX: P = lane_nz(P, X = val); break;
+        case R_LDY: P = lane_nz(P, Y = val); break;
+
+        case R_CMP: case R_CPX: case R_CPY: {
+            LaneVec reg = ins.op == R_CMP ? A : ins.op == R_CPX ? X : Y;
+
+            P = lane_nz((P & (byte)~F_C) | ((LaneVec)(reg >= val) & F_C), reg - val);
+            break;
+        }
+
+        case R_BIT:
+            P = (P & (byte)~(F_N | F_V | F_Z)) | (val & (F_N | F_V)) | ((LaneVec)((A & val) == 0) & F_Z);
+            break;
+
+        case R_ASL: P = lane_nz((P & (byte)~F_C) | val >> 7, res = val << 1); break;
+        case R_LSR: P = lane_nz((P & (byte)~F_C) | (val & 1), res = val >> 1); break;
+        case R_ROL: P = lane_nz((P & (byte)~F_C) | val >> 7, res = val << 1 | (P & F_C)); break;
+        case R_ROR: P = lane_nz((P & (byte)~F_C) | (val & 1), res = val >> 1 | (P & F_C) << 7); break;
+        case R_INC: P = lane_nz(P, res = val + 1); break;
+        case R_DEC: P = lane_nz(P, res = val - 1); break;
+
+        case R_STA: res = A; break;
+        case R_STX: res = X; break;
+        case R_STY: res = Y; break;
+
+        case R_INX: P = lane_nz(P, ++X); break;
+        case R_INY: P = lane_nz(P, ++Y); break;
+        case R_DEX: P = lane_nz(P, --X); break;
+        case R_DEY: P = lane_nz(P, --Y); break;
+        case R_TAX: P = lane_nz(P, X = A); break;
+        case R_TAY: P = lane_nz(P, Y = A); break;
+        case R_TXA: P = lane_nz(P, A = X); break;
+        case R_TYA: P = lane_nz(P, A = Y); break;
+        case R_TSX: P = lane_nz(P, X = S); break;
+        case R_TXS: S = X; break;
+
+        case R_CLC: P &= (byte)~F_C; break;
+        case R_SEC: P |= F_C; break;
+        case R_CLI: P &= (byte)~F_I; break;
+        case R_SEI: P |= F_I; break;
+        case R_CLD: P &= (byte)~F_D; break;
+        case R_SED: P |= F_D; break;
+        case R_CLV: P &= (byte)~F_V; break;
+        case R_NOP: break;
+
+        case R_BPL: taken = (LaneVec)((P & F_N) == 0); break;
+        case R_BMI: taken = (LaneVec)((P & F_N) != 0); break;
+        case R_BVC: taken = (LaneVec)((P & F_V) == 0); break;
+        case R_BVS: taken = (LaneVec)((P & F_V) != 0); break;
+        case R_BCC: taken = (LaneVec)((P & F_C) == 0); break;
+        case R_BCS: taken = (LaneVec)((P & F_C) != 0); break;
+        case R_BNE: taken = (LaneVec)((P & F_Z) == 0); break;
+        case R_BEQ: taken = (LaneVec)((P & F_Z) != 0); break;
+
+        case R_JMP: target = abs; break;
+
+        case R_RTS: {
+            byte lo = lane_byte(0x100 + (byte)(s0 + 1), lead), hi = lane_byte(0x100 + (byte)(s0 + 2), lead);
+
+            if (!lane_uniform(mask, S, s0) || !lane_uniform(mask, lane_mem[0x100 + (byte)(s0 + 1)], lo) || !lane_uniform(mask, lane_mem[0x100 + (byte)(s0 + 2)], hi)) return false;
+
+            S += 2;
+            target = (byte2)(lo + 0x100 * hi + 1);
+            break;
+        }
+
+        // The stack has to be at the same place in every lane
+        case R_PHA: case R_PHP: case R_PLA: case R_PLP: case R_JSR:
+            if (!lane_uniform(mask, S, s0)) return false;
+
+            if (ins.op == R_PHA || ins.op == R_PHP) {
+                write = 0x100 + s0;
+                res = ins.op == R_PHA ? A : P | 0b00110000;
+                S -= 1;
+            } else if (ins.op == R_JSR) {
+                lane_mem[0x100 + s0] = lane_blend(mask, (LaneVec){} + (byte)((at + 2) / 0x100), lane_mem[0x100 + s0]);
+                write = 0x100 + (byte)(s0 - 1);
+                res = (LaneVec){} + (byte)((at + 2) % 0x100);
+                S -= 2;
+                target = abs;
+            } else {
+                val = lane_mem[0x100 + (byte)(s0 + 1)];
+                S += 1;
+
+                if (ins.op == R_PLA) P = lane_nz(P, A = val);
+                else P = val | 0b00110000;
+            }
+            break;
+
+        default:
+            return false; // BRK, RTI and unknown opcodes
+    }
+
+    // Write back for the lanes in the group only
+    switch (ins.op) {
+        case R_ASL: case R_LSR: case R_ROL: case R_ROR: case R_INC: case R_DEC:
+            if (ins.mode == M_ACC) A = res;
+            else write = addr;
+            break;
+
+        case R_STA: case R_STX: case R_STY:
+            write = addr;
+            break;
+
+        default: break;
+    }
+
+    if (write >= 0) {
+        lane_mem[write] = lane_blend(mask, res, lane_mem[write]);
+
+        // Only store instructions print, as in ops.h
+        bool store = ins.op == R_STA || ins.op == R_STX || ins.op == R_STY;
+
+        if (store && print_out && write == print_ptr - memory) {
+            for (int lane = 0; lane < LANES; lane++) {
+                if (mask[lane]) lanes.out[lane] += (char)res[lane];
+            }
+        }
+    }
+
+    lanes.a = lane_blend(mask, A, lanes.a);
+    lanes.x = lane_blend(mask, X, lanes.x);
+    lanes.y = lane_blend(mask, Y, lanes.y);
+    lanes.sp = lane_blend(mask, S, lanes.sp);
+    lanes.p = lane_blend(mask, P, lanes.p);
+
+    LanePc mask16 = lane_mask16(mask);
+    LaneCount mask64 = lane_mask64(mask);
+    unsigned long long spent = op_cycles[opcode];
+
+    if (ins.mode == M_REL) {
+        // Taken branches go to the same place, costing one cycle more (two crossing a page)
+        byte2 next = at + 2, dest = next + (signed char)o1;
+        LaneVec took = taken & mask;
+
+        lanes.pc = lane_blend16(mask16, lane_blend16(lane_mask16(took), (LanePc){} + dest, (LanePc){} + next), lanes.pc);
+        lanes.cycles += lane_mask64(took) & ((next & 0xFF00) == (dest & 0xFF00) ? 1 : 2);
+    } else {
+        byte2 next = target >= 0 ? target : at + ref_lengths[ins.mode];
+
+        lanes.pc = lane_blend16(mask16, (LanePc){} + next, lanes.pc);
+    }
+
+    lanes.cycles += mask64 & spent;
+    lanes.count += mask64 & 1;
+
+    // Branches or jumps to themselves with interrupts disabled
+    if ((ins.mode == M_REL || target == at) && lane_any(mask & P & F_I)) {
+        for (int lane = 0; lane < LANES; lane++) {
+            if (mask[lane] && lanes.pc[lane] == at && lanes.p[lane] & F_I) lane_stop(lane, STOP_HANG);
+        }
+    }
+
+    return true;
+}
+
+// Run one instruction for the running lanes at the lowest pc, returns false once every lane has stopped
+bool lanes_step() {
+    int lead = -1;
+
+    for (int lane = 0; lane < LANES; lane++) {
+        if (lanes.running[lane] && (lead < 0 || lanes.pc[lane] < lanes.pc[lead])) lead = lane;
+    }
+
+    if (lead < 0) return false;
+
+    // Group lanes at the same pc and with the same instruction bytes as the lead lane
+    byte2 at = lanes.pc[lead];
+    LaneVec mask = lanes.running & (LaneVec)__builtin_convertvector((LaneMask16)(lanes.pc == at), LaneMask);
+
+    for (int i = 0; i < ref_lengths[ref_table[lane_byte(at, lead)].mode]; i++) {
+        mask &= (LaneVec)(lane_mem[(byte2)(at + i)] == lane_byte(at + i, lead));
+    }
+
+    if (lanes_vector(mask, lead, at)) {
+        lane_vector_ins += lane_count(mask);
+        return true;
+    }
+
+    for (int lane = 0; lane < LANES; lane++) {
+        if (mask[lane]) lanes_scalar(lane);
+    }
+
+    return true;
+}
+
+// Stop lanes that reached the instruction or cycle limit, returns the steps until one of the others can
+unsigned long long lanes_limit() {
+    unsigned long long block = BUDGET_BLOCK;
+
+    for (int lane = 0; lane < LANES; lane++) {
+        if (!lanes.running[lane]) continue;
+
+        if (max_instructions && lanes.count[lane] >= max_instructions) lane_stop(lane, STOP_INSTRUCTIONS);
+        else if (max_cycles && lanes.cycles[lane] >= max_cycles) lane_stop(lane, STOP_CYCLES);
+        else {
+            // Each step runs at most one instruction of a lane
+            if (max_instructions) block = std::min(block, max_instructions - lanes.count[lane]);
+            if (max_cycles) block = std::min(block, (max_cycles - lanes.cycles[lane] + BUDGET_MAX_CYCLES - 1) / BUDGET_MAX_CYCLES);
+        }
+    }
+
+    return block;
+}
+
+// Run every instance in batches of LANES and print how each one stopped, returns the amount that didn't stop on BRK
+int lanes_main() {
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    unsigned long long steps = 0;
+    int failed = 0;
+
+    printf("Instance  Stopped            A  X  Y  SP SR PC         Cycles  Instructions\n");
+
+    for (int first = 0; first < lane_instances; first += LANES) {
+        lanes_load(first);
+
+        unsigned long long next = steps + lanes_limit();
+
+        while (lanes_step()) {
+            if (++steps < next) continue;
+
+            next = steps + lanes_limit();
+
+            if (max_seconds && std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count() >= max_seconds) {
+                for (int lane = 0; lane < LANES; lane++) {
+                    if (lanes.running[lane]) lane_stop(lane, STOP_TIMEOUT);
+                }
+            }
+
+            if (broken) {
+                for (int lane = 0; lane < LANES; lane++) {
+                    if (lanes.running[lane]) lane_stop(lane, STOP_INTERRUPT);
+                }
+            }
+        }
+
+        for (int lane = 0; lane < LANES && first + lane < lane_instances; lane++) {
+            printf("%8d  %-17s  %02X %02X %02X %02X %02X %04X %12llu %13llu", first + lane, stop_names[lanes.reason[lane]],
+                lanes.a[lane], lanes.x[lane], lanes.y[lane], lanes.sp[lane], lanes.p[lane], lanes.pc[lane], lanes.cycles[lane], lanes.count[lane]);
+
+            if (!lanes.out[lane].empty()) {
+                printf("  \"");
+
+                for (char c : lanes.out[lane]) {
+                    if (c == '\n') printf("\\n");
+                    else if (c >= 0x20 && c <= 0x7E) putchar(c);
+                    else printf("\\x%02X", (byte)c);
+                }
+
+                printf("\"");
+            }
+
+            printf("\n");
+
+            failed += lanes.reason[lane] != STOP_BRK;
+        }
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    unsigned long long total = lane_vector_ins + lane_scalar_ins;
+
+    printf("\nRan %d instances on %d lanes in %.3f s: %llu instructions, %.1f%% together on vectors, %.2f Mins/s\n",
+        lane_instances, LANES, elapsed, total, total ? 100.0 * lane_vector_ins / total : 0.0, total / elapsed / 1e6);
+
+    return failed;
+}
+#else
+int lanes_main() {
+    printf("The lane engine needs a compiler with GCC vector extensions.\n");
+    return 1;
+}
+#endif
@@ -0,0 +1,319 @@
+#include <vector>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+/* multi.h
+  Contains the multi-CPU mode (-cp), running several 6502s that each have private memory plus shared regions (-sh).
+  Each CPU is a forked process on its own host core, as the core keeps one CPU's state in globals. Shared regions
+  are the same physical pages mapped into every CPU's memory, so they must be 4 KiB aligned.
+  CPUs run in quanta of cycles (-qt) and meet at every quantum boundary, so none gets more than a quantum ahead.
+  With --det the quanta are run one CPU at a time in CPU order, which makes every run the same.
+*/
+
+std::vector<string> multi_images;                  // Images of the CPUs after the first
+std::vector<std::pair<int, int>> multi_shared;     // Shared regions, start and end (exclusive)
+unsigned long long multi_quantum = 10000;
+bool multi_deterministic = false;
+
+#define MULTI_MAX 64
+#define MULTI_OUT 0x10000  // Printing address output kept per CPU
+#define MULTI_PAGE 0x1000
+
+// Parse a shared region ("0x8000-0x8FFF"), which has to cover whole 4 KiB pages
+bool add_shared(string arg) {
+    size_t dash = arg.find('-');
+    int start, end;
+
+    if (dash == string::npos || !parse_num(arg.substr(0, dash), start) || !parse_num(arg.substr(dash + 1), end)) return false;
+    if (start > end || end > 0xFFFF || start % MULTI_PAGE || (end + 1) % MULTI_PAGE) return false;
+
+    multi_shared.push_back({start, end + 1});
+    return true;
+}
+
+bool multi_is_shared(int addr) {
+    for (std::pair<int, int>& region : multi_shared) {
+        if (addr >= region.first && addr < region.second) return true;
+    }
+
+    return false;
+}
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <cerrno>
+
+struct MultiResult {
+    byte reason, a, x, y, sp, sr;
+    byte2 pc;
+    unsigned long long cycles, instructions;
+    unsigned int out_len;
+};
+
+// Kept in memory shared by every CPU process
+struct MultiShared {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int count;
+    int running;        // CPUs that haven't stopped
+    int arrived;        // CPUs waiting at the quantum boundary
+    int generation;     // Quantum boundaries passed
+    int turn;           // CPU running its quantum (with --det)
+    bool stopped[MULTI_MAX];
+    MultiResult results[MULTI_MAX];
+    char out[MULTI_MAX][MULTI_OUT];
+};
+
+MultiShared* multi;
+
+// Release the CPUs waiting at the boundary once every running CPU is there (lock held)
+void multi_release() {
+    if (multi->arrived < multi->running || !multi->arrived) return;
+
+    multi->arrived = 0;
+    multi->generation++;
+    pthread_cond_broadcast(&multi->cond);
+}
+
+// Next running CPU after one (lock held)
+int multi_next(int cpu) {
+    for (int i = 1; i <= multi->count; i++) {
+        int next = (cpu + i) % multi->count;
+
+        if (!multi->stopped[next]) return next;
+    }
+
+    return cpu;
+}
+
+// Wait until this CPU can run its next quantum
+void multi_wait(int cpu) {
+    pthread_mutex_lock(&multi->lock);
+
+    if (multi_deterministic) {
+        while (multi->turn != cpu) pthread_cond_wait(&multi->cond, &multi->lock);
+    } else {
+        int generation = multi->generation;
+
+        multi->arrived++;
+        multi_release();
+
+        while (multi->generation == generation) pthread_cond_wait(&multi->cond, &multi->lock);
+    }
+
+    pthread_mutex_unlock(&multi->lock);
+}
+
+// Pass the turn on after a quantum (with --det)
+void multi_done(int cpu) {
+    if (!multi_deterministic) return;
+
+    pthread_mutex_lock(&multi->lock);
+
+    multi->turn = multi_next(cpu);
+    pthread_cond_broadcast(&multi->cond);
+
+    pthread_mutex_unlock(&multi->lock);
+}
+
+void multi_stop(int cpu) {
+    pthread_mutex_lock(&multi->lock);
+
+    multi->stopped[cpu] = true;
+    multi->running--;
+
+    if (multi_deterministic) multi->turn = multi_next(cpu);
+    else multi_release();
+
+    pthread_cond_broadcast(&multi->cond);
+
+    pthread_mutex_unlock(&multi->lock);
+}
+
+// Run until the cycle count reaches a quantum boundary, returns false once stopped
+bool multi_run(unsigned long long until) {
+    while (cycles < until) {
+        if (broken) {
+            stop_reason = STOP_INTERRUPT;
+            return false;
+        }
+
+        byte2 at = pc;
+        byte opcode = memory[pc];
+        byte operands[2] = {memory[(byte2)(pc + 1)], memory[(byte2)(pc + 2)]};
+        byte mvbytes = instruction(opcode, operands);
+
+        cycles += op_cycles[opcode];
+
+        if (mvbytes == BRK_MOVE) {
+            pc = at;
+            stop_reason = opcode == 0x00 ? STOP_BRK : STOP_HALT;
+            return false;
+        }
+
+        pc += mvbytes;
+
+        if (pc == at && stuck(opcode)) {
+            stop_reason = STOP_HANG;
+            return false;
+        }
+
+        if (++instructions >= budget_next && !budget_check()) return false;
+    }
+
+    return true;
+}
+
+// One CPU process, loading its image at an address (the first CPU's is already loaded)
+void multi_cpu(int cpu, int load) {
+    if (cpu > 0) {
+        const string& image = multi_images[cpu - 1];
+
+        // Private memory starts clear, the shared regions keep what the first CPU loaded
+        for (int page = 0; page < 0x10000; page += MULTI_PAGE) {
+            if (!multi_is_shared(page)) memset(&memory[page], 0, MULTI_PAGE);
+        }
+
+        for (size_t i = 0; i < image.length(); i++) {
+            if (load + i < 0x10000 && !multi_is_shared(load + i)) memory[load + i] = image[i];
+        }
+    }
+
+    pc = 0x100 * memory[0xFFFD] + memory[0xFFFC];
+    budgeting = true;
+    budget_start();
+
+    for (unsigned long long until = multi_quantum; ; until += multi_quantum) {
+        multi_wait(cpu);
+
+        if (!multi_run(until)) break;
+
+        multi_done(cpu);
+    }
+
+    MultiResult& result = multi->results[cpu];
+
+    result = {(byte)stop_reason, a, x, y, sp, sr.val(), pc, cycles, instructions, (unsigned int)std::min((size_t)MULTI_OUT, endprint.length())};
+    memcpy(multi->out[cpu], endprint.data(), result.out_len);
+
+    multi_stop(cpu);
+    _exit(0);
+}
+
+// Run every CPU until all have stopped, returns the exit code (the first reason that isn't BRK, in CPU order)
+int multi_main(int load) {
+    int count = multi_images.size() + 1;
+
+    if (count > MULTI_MAX) {
+        printf("At most %d CPUs are supported.\n", MULTI_MAX);
+        return 1;
+    }
+
+    multi = (MultiShared*)mmap(NULL, sizeof(MultiShared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    if (multi == MAP_FAILED) {
+        printf("Unable to share memory between CPUs.\n");
+        return 1;
+    }
+
+    pthread_mutexattr_t lock_attr;
+    pthread_condattr_t cond_attr;
+
+    pthread_mutexattr_init(&lock_attr);
+    pthread_mutexattr_setpshared(&lock_attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutex_init(&multi->lock, &lock_attr);
+
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setpshared(&cond_attr, PTHREAD_PROCESS_SHARED);
+    pthread_cond_init(&multi->cond, &cond_attr);
+
+    multi->count = multi->running = count;
+
+    // Swap each shared region for shared pages holding the same bytes
+    for (std::pair<int, int>& region : multi_shared) {
+        int len = region.second - region.first;
+        string saved((const char*)&memory[region.first], len);
+
+        if (mmap(&memory[region.first], len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED) {
+            printf("Unable to share %04X-%04X between CPUs.\n", region.first, region.second - 1);
+            return 1;
+        }
+
+        memcpy(&memory[region.first], saved.data(), len);
+    }
+
+    // Output is kept to be printed with the results
+    ins_print = false;
+    mem_print = true;
+    fflush(stdout);
+
+    std::vector<pid_t> cpus;
+    int left = 0;
+
+    for (int cpu = 0; cpu < count; cpu++) {
+        pid_t pid = fork();
+
+        if (pid == 0) multi_cpu(cpu, load);
+
+        cpus.push_back(pid);
+
+        // A CPU that couldn't be started is stopped with an error, so the others don't wait on it
+        if (pid < 0) {
+            multi->results[cpu].reason = STOP_ERROR;
+            multi_stop(cpu);
+        } else {
+            left++;
+        }
+    }
+
+    // A CPU process that died without stopping is stopped for it, so the others don't wait on it
+    while (left > 0) {
+        int status;
+        pid_t pid = wait(&status);
+
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        for (int cpu = 0; cpu < count; cpu++) {
+            if (cpus[cpu] != pid) continue;
+
+            if (!multi->stopped[cpu]) {
+                multi->results[cpu].reason = STOP_ERROR;
+                multi_stop(cpu);
+            }
+
+            left--;
+        }
+    }
+
+    int code = STOP_BRK;
+
+    printf("CPU  Stopped            A  X  Y  SP SR PC         Cycles  Instructions\n");
+
+    for (int cpu = 0; cpu < count; cpu++) {
+        MultiResult& result = multi->results[cpu];
+
+        printf("%3d  %-17s  %02X %02X %02X %02X %02X %04X %12llu %13llu\n", cpu, stop_names[result.reason],
+            result.a, result.x, result.y, result.sp, result.sr, result.pc, result.cycles, result.instructions);
+
+        if (code == STOP_BRK) code = result.reason;
+    }
+
+    for (int cpu = 0; cpu < count; cpu++) {
+        if (multi->results[cpu].out_len) printf("\nCPU %d output:\n%.*s\n", cpu, multi->results[cpu].out_len, multi->out[cpu]);
+    }
+
+    return code;
+}
+#else
+int multi_main(int load) {
+    printf("Multiple CPUs are not supported on Windows.\n");
+    return 1;
+}
+#endif
@@ -1,9 +1,20 @@
 #include <stdio.h>
 
+#include "stats.h"
+
 /* ops.h
   Contains operations and register/memory values.
 */
 
+// CPU variant, chosen at build time by defining CPU_65C02 or CPU_2A03 (NMOS 6502 otherwise)
+#if defined(CPU_65C02)
+#define CPUSTRING "65C02"
+#elif defined(CPU_2A03)
+#define CPUSTRING "2A03"
+#else
+#define CPUSTRING "NMOS 6502"
+#endif
+
 bool broken = false;
 
 #ifdef _WIN32
@@ -39,8 +50,46 @@ void int_handler(int s) {
 
 using std::string;
 
-// Create memory and registers
-byte memory[0x10000] = {};
+#include "arena.h"
+
+// Create memory (the first in the arena, see arena.h) and registers
+byte* const memory = arena;
+
+// Zero page and stack, the most used parts of memory (the byte index wraps within the page)
+inline byte& zp(byte addr) {
+    return memory[addr];
+}
+
+inline byte& stack(byte offset) {
+    return memory[0x100 + offset];
+}
+
+// Pages written since the last reset (see pool.h), the zero page and stack aren't tracked as they are always reset
+bool page_dirty[0x100];
+
+inline void mark_dirty(byte* addr) {
+    uintptr_t at = (uintptr_t)addr - (uintptr_t)memory; // Registers passed by reference land outside
+
+    if (at < MEMORY_SIZE) page_dirty[at >> 8] = true;
+}
+
+// Pages holding device registers, whose reads and stores go to the device (see io.h)
+bool io_pages[0x100];
+
+void io_access(byte2 addr, byte opcode);
+bool io_write(byte2 addr, byte val);
+void io_schedule();
+
+// Store of a read-modify-write instruction, called once the value has changed (registers passed by reference land outside)
+inline void rmw_store(byte& addr) {
+    uintptr_t at = (uintptr_t)&addr - (uintptr_t)memory;
+
+    if (at >= MEMORY_SIZE) return;
+
+    page_dirty[at >> 8] = true;
+
+    if (io_pages[at >> 8]) io_write(at, addr);
+}
 
 // Accumulator, x and y registers
 byte a, x, y;
@@ -48,6 +97,18 @@ byte a, x, y;
 // Stack pointer
 byte sp = 0xFF;
 
+bool tracing = false;   // Recording a trace, which is told of every push (see trace.h)
+
+void trace_push(byte offset);
+
+inline void push(byte val) {
+    stack(sp) = val;
+
+    if (tracing) trace_push(sp);
+
+    sp--;
+}
+
 // Flags / Status Register
 struct StatusRegister {
     bool n = false; // Negative flag
@@ -73,6 +134,17 @@ struct StatusRegister {
 
         return out;
     }
+
+    void set(byte val) {
+        n = val & 0b10000000;
+        v = val & 0b01000000;
+        _ = val & 0b00100000;
+        b = val & 0b00010000;
+        d = val & 0b00001000;
+        i = val & 0b00000100;
+        z = val & 0b00000010;
+        c = val & 0b00000001;
+    }
 } sr;
 
 const byte BRK_MOVE = 0xFF; // Constant that represents a break when returned by an instruction
@@ -80,6 +152,58 @@ const byte BRK_MOVE = 0xFF; // Constant that represents a break when returned by
 // Program counter, current place in program
 byte2 pc;
 
+// Cycles executed since start
+unsigned long long cycles = 0;
+
+// Cycle count of the next scheduled device event or interrupt (none without devices, see io.h)
+unsigned long long next_event = ~0ull;
+
+// Devices pulling the IRQ line, a bit each
+byte irq_sources = 0;
+
+// Base cycle count of each opcode (page crossing penalties on indexed reads aren't counted)
+#if defined(CPU_65C02)
+constexpr byte op_cycles[0x100] = {
+//  0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F
+    7, 6, 2, 1, 5, 3, 5, 5, 3, 2, 2, 1, 6, 4, 6, 5, // 0
+    2, 5, 5, 1, 5, 4, 6, 5, 2, 4, 2, 1, 6, 4, 6, 5, // 1
+    6, 6, 2, 1, 3, 3, 5, 5, 4, 2, 2, 1, 4, 4, 6, 5, // 2
+    2, 5, 5, 1, 4, 4, 6, 5, 2, 4, 2, 1, 4, 4, 6, 5, // 3
+    6, 6, 2, 1, 3, 3, 5, 5, 3, 2, 2, 1, 3, 4, 6, 5, // 4
+    2, 5, 5, 1, 4, 4, 6, 5, 2, 4, 3, 1, 8, 4, 6, 5, // 5
+    6, 6, 2, 1, 3, 3, 5, 5, 4, 2, 2, 1, 6, 4, 6, 5, // 6
+    2, 5, 5, 1, 4, 4, 6, 5, 2, 4, 4, 1, 6, 4, 6, 5, // 7
+    3, 6, 2, 1, 3, 3, 3, 5, 2, 2, 2, 1, 4, 4, 4, 5, // 8
+    2, 6, 5, 1, 4, 4, 4, 5, 2, 5, 2, 1, 4, 5, 5, 5, // 9
+    2, 6, 2, 1, 3, 3, 3, 5, 2, 2, 2, 1, 4, 4, 4, 5, // A
+    2, 5, 5, 1, 4, 4, 4, 5, 2, 4, 2, 1, 4, 4, 4, 5, // B
+    2, 6, 2, 1, 3, 3, 5, 5, 2, 2, 2, 3, 4, 4, 6, 5, // C
+    2, 5, 5, 1, 4, 4, 6, 5, 2, 4, 3, 3, 4, 4, 7, 5, // D
+    2, 6, 2, 1, 3, 3, 5, 5, 2, 2, 2, 1, 4, 4, 6, 5, // E
+    2, 5, 5, 1, 4, 4, 6, 5, 2, 4, 4, 1, 4, 4, 7, 5  // F
+};
+#else
+constexpr byte op_cycles[0x100] = {
+//  0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F
+    7, 6, 0, 8, 3, 3, 5, 5, 3, 2, 2, 2, 4, 4, 6, 6, // 0
+    2, 5, 0, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7, // 1
+    6, 6, 0, 8, 3, 3, 5, 5, 4, 2, 2, 2, 4, 4, 6, 6, // 2
+    2, 5, 0, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7, // 3
+    6, 6, 0, 8, 3, 3, 5, 5, 3, 2, 2, 2, 3, 4, 6, 6, // 4
+    2, 5, 0, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7, // 5
+    6, 6, 0, 8, 3, 3, 5, 5, 4, 2, 2, 2, 5, 4, 6, 6, // 6
+    2, 5, 0, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7, // 7
+    2, 6, 2, 6, 3, 3, 3, 3, 2, 2, 2, 2, 4, 4, 4, 4, // 8
+    2, 6, 0, 6, 4, 4, 4, 4, 2, 5, 2, 5, 5, 5, 5, 5, // 9
+    2, 6, 2, 6, 3, 3, 3, 3, 2, 2, 2, 2, 4, 4, 4, 4, // A
+    2, 5, 0, 5, 4, 4, 4, 4, 2, 4, 2, 4, 4, 4, 4, 4, // B
+    2, 6, 2, 8, 3, 3, 5, 5, 2, 2, 2, 2, 4, 4, 6, 6, // C
+    2, 5, 0, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7, // D
+    2, 6, 2, 8, 3, 3, 5, 5, 2, 2, 2, 2, 4, 4, 6, 6, // E
+    2, 5, 0, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7  // F
+};
+#endif
+
 // Option flags
 // Printout of memory and instructions
 bool mem_print = true;
@@ -87,6 +211,8 @@ bool asc_print = true;
 bool ins_print = true;
 // Break when hitting a software break (BRK)
 bool brk_stop = false;
+// Report opcodes that halt the processor
+bool halt_print = true;
 // Print value if on printing address and enabled
 byte* print_ptr = &memory[0xFFF9];
 bool print_out = false;
@@ -94,15 +220,46 @@ bool print_out = false;
 string endprint = ""; // Printed out after program stops
 
 void st_print(byte* addr, int val) {
+    uintptr_t at = (uintptr_t)addr - (uintptr_t)memory;
+
+    mark_dirty(addr);
+
+    // A device's register (unless it is also the printing address) isn't a store to memory
+    if (at < MEMORY_SIZE && io_pages[at >> 8] && io_write(at, val) && (addr != print_ptr || !print_out)) return;
+
     if (addr == print_ptr && print_out) {
+        STAT(stat_io_hits++;)
+
         // Print at end if printing memory or instructions (so no overlap), otherwise, print now
         if (mem_print || ins_print) {
+            STAT(stat_out_buffered++;)
             endprint += (char)val;
             return;
         }
 
+        STAT(stat_out_direct++;)
         printf("%c", (char)val);
+        return;
+    }
+
+    STAT(stat_ram_stores++;)
+}
+
+// Print output of the program other than single bytes to the printing address (held until the end likewise)
+void print_text(const string& text) {
+    if (mem_print || ins_print) {
+        endprint += text;
+        return;
     }
+
+    fwrite(text.data(), 1, text.size(), stdout);
+}
+
+// Take a relative branch (one extra cycle, two if crossing a page)
+void branch(signed char val) {
+    cycles += ((pc + 2) & 0xFF00) == ((pc + 2 + val) & 0xFF00) ? 1 : 2;
+
+    pc += val;
 }
 
 // Set negative and zero flags based off of input value
@@ -111,35 +268,56 @@ void set_nz(byte val) {
     sr.z = !val;
 }
 
+#include "disasm.h"
+#include "debug.h"
+
 // Define addressing modes
 #define Accum (a);\
+    STAT_MODE(S_ACCUM, 0)\
     return 0x01;               // Accumulator as an argument
 #define IMM (ops[0]);\
+    STAT_MODE(S_IMM, 0)\
     return 0x02;               // Literal first value as an argument
-#define ABS (memory[ABS_ADDR]);\
+#define ABS (WATCH(memory[ABS_ADDR]));\
+    STAT_MODE(S_ABS, 1)\
     return 0x03;               // Value at address of next two bytes
-#define ZP (memory[ops[0]]);\
+#define ZP (WATCH(zp(ops[0])));\
+    STAT_MODE(S_ZP, 1)\
     return 0x02;               // Value at address of next byte with high byte (page) of 0
 #define ZP_X \
-  (memory[(byte)(ops[0] + x)]);\
+  (WATCH(zp(ops[0] + x)));\
+    STAT_MODE(S_ZP_X, 1)\
     return 0x02;               // Value at address of next byte with high byte 0, indexed to x
 #define ZP_Y \
-  (memory[(byte)(ops[0] + y)]);\
+  (WATCH(zp(ops[0] + y)));\
+    STAT_MODE(S_ZP_Y, 1)\
     return 0x02;               // ^, indexed to y
 #define ABS_X \
-  (memory[(byte2)(ABS_ADDR + x)]);\
+  (WATCH(memory[(byte2)(ABS_ADDR + x)]));\
+    STAT_MODE(S_ABS_X, 1)\
     return 0x03;               // Value at address of next two bytes, indexed to x
 #define ABS_Y \
-  (memory[(byte2)(ABS_ADDR + y)]);\
+  (WATCH(memory[(byte2)(ABS_ADDR + y)]));\
+    STAT_MODE(S_ABS_Y, 1)\
     return 0x03;               // ^, indexed to y
 #define Implied ();\
+    STAT_MODE(S_IMPLIED, 0)\
     return 0x01;               // No arguments (implied from instruction)
 #define Relative ((signed char)ops[0]);\
+    STAT_MODE(S_REL, 0)\
     return 0x02;               // First value as argument (interpreted as -128 to 127)
-#define IND_X (memory[memory[(byte)(ops[0] + x + 1)] * 0x100 + memory[(byte)(ops[0] + x)]]);\
+#define IND_X (WATCH(memory[zp(ops[0] + x + 1) * 0x100 + zp(ops[0] + x)]));\
+    STAT_MODE(S_IND_X, 3)\
     return 0x02;               // Value at indexed indirect x memory location
-#define IND_Y (memory[(byte2)(memory[(byte)(ops[0] + 1)] * 0x100 + y + memory[ops[0]])]);\
+#define IND_Y (WATCH(memory[(byte2)(zp(ops[0] + 1) * 0x100 + y + zp(ops[0]))]));\
+    STAT_MODE(S_IND_Y, 3)\
     return 0x02;               // Value at indirect indexed y memory location
+#define ZP_IND (WATCH(memory[zp(ops[0] + 1) * 0x100 + zp(ops[0])]));\
+    STAT_MODE(S_ZP_IND, 3)\
+    return 0x02;               // Value at indirect zero page memory location (65C02)
+#define ZP_Rel (WATCH(zp(ops[0])), (signed char)ops[1]);\
+    STAT_MODE(S_ZP, 1)\
+    return 0x03;               // Value at zero page address then relative branch (65C02)
 
 // Define instructions
 void ORA(byte val) {
@@ -150,15 +328,15 @@ void ASL(byte& addr) {
     sr.c = addr / 0x80;
 
     set_nz(addr = addr * 0b10);
+    rmw_store(addr);
 }
 
 void PHP() {
-    memory[0x100 + sp] = sr.val();
-    sp--;
+    push(sr.val() | 0b00110000); // Always pushed with break and unused set
 }
 
 void BPL(signed char val) {
-    if (!sr.n) pc += val;
+    if (!sr.n) branch(val);
 }
 
 void CLC() {
@@ -166,10 +344,8 @@ void CLC() {
 }
 
 void JSR(byte val) {
-    memory[0x100 + sp] = (pc + 2) / 0x100;
-    sp--;
-    memory[0x100 + sp] = (pc + 2) % 0x100;
-    sp--;
+    push((pc + 2) / 0x100);
+    push((pc + 2) % 0x100);
 
     pc = memory[pc + 2] * 0x100 + memory[pc + 1] - 3; // FIXME: Possibly not ideal
 }
@@ -178,6 +354,7 @@ void ROL(byte& addr) {
     bool bit = addr / 0x80;
 
     set_nz(addr = addr * 0b10 + sr.c);
+    rmw_store(addr);
 
     sr.c = bit;
 }
@@ -195,20 +372,13 @@ void BIT(byte val) {
 
 void PLP() {
     sp++;
-    byte val = memory[0x100 + sp];
+    sr.set(stack(sp) | 0b00110000); // Break and unused aren't real flags
 
-    sr.n = val & 0b10000000;
-    sr.v = val & 0b01000000;
-    sr._ = val & 0b00100000;
-    sr.b = val & 0b00010000;
-    sr.d = val & 0b00001000;
-    sr.i = val & 0b00000100;
-    sr.z = val & 0b00000010;
-    sr.c = val & 0b00000001;
+    if (irq_sources) next_event = 0; // A pending IRQ may be let through now
 }
 
 void BMI(signed char val) {
-    if (sr.n) pc += val;
+    if (sr.n) branch(val);
 }
 
 void SEC() {
@@ -219,13 +389,51 @@ void RTI() {
     PLP();
 
     sp++;
-    byte2 val = memory[0x100 + sp];
+    byte2 val = stack(sp);
     sp++;
-    val += 0x100 * memory[0x100 + sp];
+    val += 0x100 * stack(sp);
 
     pc = val - 1;
 }
 
+// Take an IRQ between instructions (like BRK, but pushing the next instruction with break clear)
+void interrupt() {
+    push(pc / 0x100);
+    push(pc % 0x100);
+    push((sr.val() | 0b00100000) & ~0b00010000);
+
+    sr.i = true;
+    #if defined(CPU_65C02)
+    sr.d = false;
+    #endif
+
+    pc = memory[0xFFFF] * 0x100 + memory[0xFFFE];
+    cycles += 7;
+}
+
+// Wait for an IRQ (65C02), moving the cycle count on to each device event until one pulls the line. Returns false if
+// no event is scheduled, so nothing will ever wake it
+bool WAI() {
+    while (!irq_sources) {
+        if (next_event == ~0ull) return false;
+        if (next_event > cycles) cycles = next_event;
+
+        io_schedule();
+    }
+
+    return true;
+}
+
+// Whether an instruction that stayed on itself will never move on: a branch or jump to itself with interrupts
+// disabled, or a WAI with nothing left to wake it
+inline bool stuck(byte opcode) {
+    #if defined(CPU_65C02)
+    if (opcode == 0xCB) return true;
+    #endif
+
+    return sr.i;
+}
+
 void EOR(byte val) {
     set_nz(a = a ^ val);
 }
@@ -234,54 +442,81 @@ void LSR(byte& addr) {
     sr.c = addr % 0b10;
 
     set_nz(addr = addr / 0b10);
+    rmw_store(addr);
 }
 
 void PHA() {
-    memory[0x100 + sp] = a;
-    sp--;
+    push(a);
 }
 
 void BVC(signed char val) {
-    if (!sr.v) pc += val;
+    if (!sr.v) branch(val);
 }
 
 void CLI() {
     sr.i = false;
+
+    if (irq_sources) next_event = 0;
 }
 
 void RTS() {
     sp++;
-    byte2 val = memory[0x100 + sp];
+    byte2 val = stack(sp);
     sp++;
-    val += 0x100 * memory[0x100 + sp];
+    val += 0x100 * stack(sp);
 
     pc = val;
 }
 
 void ADC(byte val) {
-    short sum = (signed char)a + (signed char)val;
+    short sum = a + val + sr.c;
 
-    set_nz(a = a + val + sr.c);
-    
-    sr.c = (val + sr.c > a);
-    sr.v = sum < -0x80 || sum >= 0x80;
+    #if !defined(CPU_2A03)
+    if (sr.d) {
+        // Add each decimal digit (N and V come from the result before the high digit is adjusted, Z from the binary sum)
+        short low = (a & 0x0F) + (val & 0x0F) + sr.c;
+        if (low >= 0x0A) low = ((low + 0x06) & 0x0F) + 0x10;
+
+        short dec = (a & 0xF0) + (val & 0xF0) + low;
+        short sig = (signed char)(a & 0xF0) + (signed char)(val & 0xF0) + low;
+
+        sr.z = !(byte)sum;
+        sr.n = sig & 0x80;
+        sr.v = sig < -0x80 || sig >= 0x80;
+
+        if (dec >= 0xA0) dec += 0x60;
+
+        sr.c = dec >= 0x100;
+        a = dec;
+        #if defined(CPU_65C02)
+        set_nz(a); // 65C02 sets N and Z from the decimal result
+        #endif
+        return;
+    }
+    #endif
+
+    sr.v = ~(a ^ val) & (a ^ sum) & 0x80; // Operands with the same sign giving a result with a different one
+    sr.c = sum > 0xFF;
+
+    set_nz(a = sum);
 }
 
 void ROR(byte& addr) {
     bool bit = addr % 0b10;
 
     set_nz(addr = 0x80 * sr.c + addr / 0b10);
+    rmw_store(addr);
 
     sr.c = bit;
 }
 
 void PLA() {
     sp++;
-    set_nz(a = memory[0x100 + sp]);
+    set_nz(a = stack(sp));
 }
 
 void BVS(signed char val) {
-    if (sr.v) pc += val;
+    if (sr.v) branch(val);
 }
 
 void SEI() {
@@ -315,7 +550,7 @@ void TXA() {
 }
 
 void BCC(signed char val) {
-    if (!sr.c) pc += val;
+    if (!sr.c) branch(val);
 }
 
 void TYA() {
@@ -347,7 +582,7 @@ void TAX() {
 }
 
 void BCS(signed char val) {
-    if (sr.c) pc += val;
+    if (sr.c) branch(val);
 }
 
 void CLV() {
@@ -370,6 +605,7 @@ void CMP(byte val) {
 
 void DEC(byte& addr) {
     set_nz(--addr);
+    rmw_store(addr);
 }
 
 void INY() {
@@ -381,7 +617,7 @@ void DEX() {
 }
 
 void BNE(signed char val) {
-    if (!sr.z) pc += val;
+    if (!sr.z) branch(val);
 }
 
 void CLD() {
@@ -394,17 +630,44 @@ void CPX(byte val) {
 }
 
 void SBC(byte val) {
-    short dif = (signed char)a - (signed char)val;
-    byte preval = a;
-    sr.v = dif < -0x80 || dif >= 0x80;
+    short dif = a - val - !sr.c;
+
+    #if !defined(CPU_2A03)
+    if (sr.d) {
+        // Subtract each decimal digit (flags are the same as in binary)
+        short low = (a & 0x0F) - (val & 0x0F) - !sr.c;
+
+        #if defined(CPU_65C02)
+        // 65C02 adjusts the binary difference instead, which only differs for digits over 9
+        short dec = dif - (dif < 0 ? 0x60 : 0) - (low < 0 ? 0x06 : 0);
+        #else
+        if (low < 0) low = ((low - 0x06) & 0x0F) - 0x10;
+
+        short dec = (a & 0xF0) - (val & 0xF0) + low;
+        if (dec < 0) dec -= 0x60;
+        #endif
+
+        sr.v = (a ^ val) & (a ^ dif) & 0x80;
+        sr.c = dif >= 0;
+        set_nz(dif);
+
+        a = dec;
+        #if defined(CPU_65C02)
+        set_nz(a);
+        #endif
+        return;
+    }
+    #endif
 
-    set_nz(a = a - val - !sr.c);
+    sr.v = (a ^ val) & (a ^ dif) & 0x80; // Operands with different signs giving a result with the sign of val
+    sr.c = dif >= 0;
 
-    sr.c = (preval >= val + !sr.c);
+    set_nz(a = dif);
 }
 
 void INC(byte& addr) {
     set_nz(++addr);
+    rmw_store(addr);
 }
 
 void INX() {
@@ -415,31 +678,218 @@ void NOP() {
     
 }
 
+void NOP(byte val) {
+    // Undocumented NOPs still read their operand
+}
+
 void BEQ(signed char val) {
-    if (sr.z) pc += val;
+    if (sr.z) branch(val);
 }
 
 void SED() {
     sr.d = true;
 }
 
+#if defined(CPU_65C02)
+// Define 65C02 instructions
+void BRA(signed char val) {
+    branch(val);
+}
+
+void PHX() {
+    push(x);
+}
+
+void PHY() {
+    push(y);
+}
+
+void PLX() {
+    sp++;
+    set_nz(x = stack(sp));
+}
+
+void PLY() {
+    sp++;
+    set_nz(y = stack(sp));
+}
+
+void STZ(byte& addr) {
+    st_print(&addr, 0);
+
+    addr = 0;
+}
+
+void TSB(byte& addr) {
+    sr.z = !(addr & a);
+
+    addr |= a;
+    rmw_store(addr);
+}
+
+void TRB(byte& addr) {
+    sr.z = !(addr & a);
+
+    addr &= ~a;
+    rmw_store(addr);
+}
+
+void BIT_IMM(byte val) {
+    sr.z = !(a & val); // Immediate BIT only sets zero
+}
+
+template <int bit>
+void RMB(byte& addr) {
+    addr &= ~(1 << bit);
+    rmw_store(addr);
+}
+
+template <int bit>
+void SMB(byte& addr) {
+    addr |= 1 << bit;
+    rmw_store(addr);
+}
+
+template <int bit>
+void BBR(byte val, signed char rel) {
+    if (!(val & 1 << bit)) branch(rel);
+}
+
+template <int bit>
+void BBS(byte val, signed char rel) {
+    if (val & 1 << bit) branch(rel);
+}
+#else
+// Define undocumented NMOS instructions (combinations of the ones above)
+void SLO(byte& addr) {
+    ASL(addr);
+    ORA(addr);
+}
+
+void RLA(byte& addr) {
+    ROL(addr);
+    AND(addr);
+}
+
+void SRE(byte& addr) {
+    LSR(addr);
+    EOR(addr);
+}
+
+void RRA(byte& addr) {
+    ROR(addr);
+    ADC(addr);
+}
+
+void SAX(byte& addr) {
+    st_print(&addr, a & x);
+
+    addr = a & x;
+}
+
+void LAX(byte val) {
+    set_nz(a = x = val);
+}
+
+void LXA(byte val) {
+    set_nz(a = x = (a | 0xEE) & val);
+}
+
+void DCP(byte& addr) {
+    addr--;
+    rmw_store(addr);
+    CMP(addr);
+}
+
+void ISC(byte& addr) {
+    addr++;
+    rmw_store(addr);
+    SBC(addr);
+}
+
+void ANC(byte val) {
+    AND(val);
+    sr.c = sr.n;
+}
+
+void ALR(byte val) {
+    a &= val;
+    LSR(a);
+}
+
+void ARR(byte val) {
+    a &= val;
+    set_nz(a = 0x80 * sr.c + a / 0b10);
+
+    sr.c = a & 0b01000000;
+    sr.v = (a >> 6 ^ a >> 5) & 1;
+}
+
+void XAA(byte val) {
+    set_nz(a = (a | 0xEE) & x & val);
+}
+
+void AXS(byte val) {
+    byte ax = a & x;
+    sr.c = ax >= val;
+
+    set_nz(x = ax - val);
+}
+
+// High byte of the address + 1, which the unstable stores "AND" with
+byte high_mask(byte& addr) {
+    return ((&addr - memory) >> 8) + 1;
+}
+
+void SHA(byte& addr) {
+    byte val = a & x & high_mask(addr);
+    st_print(&addr, val);
+
+    addr = val;
+}
+
+void SHX(byte& addr) {
+    byte val = x & high_mask(addr);
+    st_print(&addr, val);
+
+    addr = val;
+}
+
+void SHY(byte& addr) {
+    byte val = y & high_mask(addr);
+    st_print(&addr, val);
+
+    addr = val;
+}
+
+void TAS(byte& addr) {
+    sp = a & x;
+    SHA(addr);
+}
+
+void LAS(byte val) {
+    set_nz(a = x = sp = val & sp);
+}
+#endif
+
 // Function that executes instructions and returns the amount to change pc by
 /* TODO:
     Properly set values on routines
-    Implement decimal mode
 */
 static byte instruction(byte opcode, byte ops[]) {
     switch (opcode) {
         case 0x00: // BRK (Force Break) Implied
-            memory[0x100 + sp] = (pc + 2) / 0x100;
-            sp--;
-            memory[0x100 + sp] = (pc + 2) % 0x100;
-            sp--;
+            push((pc + 2) / 0x100);
+            push((pc + 2) % 0x100);
 
             PHP();
             sr.i = true;
+            #if defined(CPU_65C02)
+            sr.d = false;
+            #endif
 
             pc = 0x100 * memory[0xFFFF] + memory[0xFFFE];
+            STAT_MODE(S_IMPLIED, 0)
 
             return brk_stop ? 0x00 : BRK_MOVE;
 
@@ -571,6 +1021,7 @@ static byte instruction(byte opcode, byte ops[]) {
 
         case 0x4C: // JMP (Jump to New Location) ABS
             pc = ABS_ADDR;
+            STAT_MODE(S_ABS, 0)
             return 0x00;
 
         case 0x4D: // EOR ("Exclusive-OR" Memory with Accumulator) ABS
@@ -625,7 +1076,12 @@ static byte instruction(byte opcode, byte ops[]) {
             ROR Accum
 
         case 0x6C: // JMP (Jump to New Location) Indirect
-            pc = memory[ABS_ADDR] + 0x100 * memory[ops[1] * 0x100 + (byte)(ops[0] + 1)];
+            #if defined(CPU_65C02)
+            pc = memory[ABS_ADDR] + 0x100 * memory[(byte2)(ABS_ADDR + 1)];
+            #else
+            pc = memory[ABS_ADDR] + 0x100 * memory[ops[1] * 0x100 + (byte)(ops[0] + 1)]; // High byte read from the same page
+            #endif
+            STAT_MODE(S_IND, 2)
             return 0x00;
 
         case 0x6D: // ADC (Add Memory to Accumulator with Carry) ABS
@@ -894,10 +1350,613 @@ static byte instruction(byte opcode, byte ops[]) {
 
         case 0xFE: // INC (Increment Memory by One) ABS, X
             INC ABS_X
+
+        #if defined(CPU_65C02)
+        // 65C02 opcodes
+        case 0x02: // NOP (No Operation) IMM
+            NOP IMM
+
+        case 0x03: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0x04: // TSB (Test and Set Bits in Memory with Accumulator) ZP
+            TSB ZP
+
+        case 0x07: // RMB0 (Reset Memory Bit 0) ZP
+            RMB<0> ZP
+
+        case 0x0B: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0x0C: // TSB (Test and Set Bits in Memory with Accumulator) ABS
+            TSB ABS
+
+        case 0x0F: // BBR0 (Branch on Bit 0 Reset) ZP, Relative
+            BBR<0> ZP_Rel
+
+        case 0x12: // ORA ("OR" Memory with Accumulator) (ZP)
+            ORA ZP_IND
+
+        case 0x13: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0x14: // TRB (Test and Reset Bits in Memory with Accumulator) ZP
+            TRB ZP
+
+        case 0x17: // RMB1 (Reset Memory Bit 1) ZP
+            RMB<1> ZP
+
+        case 0x1A: // INC (Increment by One) Accum
+            INC Accum
+
+        case 0x1B: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0x1C: // TRB (Test and Reset Bits in Memory with Accumulator) ABS
+            TRB ABS
+
+        case 0x1F: // BBR1 (Branch on Bit 1 Reset) ZP, Relative
+            BBR<1> ZP_Rel
+
+        case 0x22: // NOP (No Operation) IMM
+            NOP IMM
+
+        case 0x23: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0x27: // RMB2 (Reset Memory Bit 2) ZP
+            RMB<2> ZP
+
+        case 0x2B: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0x2F: // BBR2 (Branch on Bit 2 Reset) ZP, Relative
+            BBR<2> ZP_Rel
+
+        case 0x32: // AND ("AND" Memory with Accumulator) (ZP)
+            AND ZP_IND
+
+        case 0x33: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0x34: // BIT (Test Bits in Memory with Accumulator) ZP, X
+            BIT ZP_X
+
+        case 0x37: // RMB3 (Reset Memory Bit 3) ZP
+            RMB<3> ZP
+
+        case 0x3A: // DEC (Decrement by One) Accum
+            DEC Accum
+
+        case 0x3B: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0x3C: // BIT (Test Bits in Memory with Accumulator) ABS, X
+            BIT ABS_X
+
+        case 0x3F: // BBR3 (Branch on Bit 3 Reset) ZP, Relative
+            BBR<3> ZP_Rel
+
+        case 0x42: // NOP (No Operation) IMM
+            NOP IMM
+
+        case 0x43: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0x44: // NOP (No Operation) ZP
+            NOP ZP
+
+        case 0x47: // RMB4 (Reset Memory Bit 4) ZP
+            RMB<4> ZP
+
+        case 0x4B: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0x4F: // BBR4 (Branch on Bit 4 Reset) ZP, Relative
+            BBR<4> ZP_Rel
+
+        case 0x52: // EOR ("Exclusive-OR" Memory with Accumulator) (ZP)
+            EOR ZP_IND
+
+        case 0x53: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0x54: // NOP (No Operation) ZP, X
+            NOP ZP_X
+
+        case 0x57: // RMB5 (Reset Memory Bit 5) ZP
+            RMB<5> ZP
+
+        case 0x5A: // PHY (Push Index Y on Stack) Implied
+            PHY Implied
+
+        case 0x5B: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0x5C: // NOP (No Operation) ABS
+            NOP ABS
+
+        case 0x5F: // BBR5 (Branch on Bit 5 Reset) ZP, Relative
+            BBR<5> ZP_Rel
+
+        case 0x62: // NOP (No Operation) IMM
+            NOP IMM
+
+        case 0x63: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0x64: // STZ (Store Zero in Memory) ZP
+            STZ ZP
+
+        case 0x67: // RMB6 (Reset Memory Bit 6) ZP
+            RMB<6> ZP
+
+        case 0x6B: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0x6F: // BBR6 (Branch on Bit 6 Reset) ZP, Relative
+            BBR<6> ZP_Rel
+
+        case 0x72: // ADC (Add Memory to Accumulator with Carry) (ZP)
+            ADC ZP_IND
+
+        case 0x73: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0x74: // STZ (Store Zero in Memory) ZP, X
+            STZ ZP_X
+
+        case 0x77: // RMB7 (Reset Memory Bit 7) ZP
+            RMB<7> ZP
+
+        case 0x7A: // PLY (Pull Index Y from Stack) Implied
+            PLY Implied
+
+        case 0x7B: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0x7C: // JMP (Jump to New Location) (ABS, X)
+            pc = memory[(byte2)(ABS_ADDR + x)] + 0x100 * memory[(byte2)(ABS_ADDR + x + 1)];
+            STAT_MODE(S_IND, 2)
+            return 0x00;
+
+        case 0x7F: // BBR7 (Branch on Bit 7 Reset) ZP, Relative
+            BBR<7> ZP_Rel
+
+        case 0x80: // BRA (Branch Always) Relative
+            BRA Relative
+
+        case 0x82: // NOP (No Operation) IMM
+            NOP IMM
+
+        case 0x83: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0x87: // SMB0 (Set Memory Bit 0) ZP
+            SMB<0> ZP
+
+        case 0x89: // BIT (Test Bits in Memory with Accumulator) IMM
+            BIT_IMM IMM
+
+        case 0x8B: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0x8F: // BBS0 (Branch on Bit 0 Set) ZP, Relative
+            BBS<0> ZP_Rel
+
+        case 0x92: // STA (Store Accumulator in Memory) (ZP)
+            STA ZP_IND
+
+        case 0x93: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0x97: // SMB1 (Set Memory Bit 1) ZP
+            SMB<1> ZP
+
+        case 0x9B: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0x9C: // STZ (Store Zero in Memory) ABS
+            STZ ABS
+
+        case 0x9E: // STZ (Store Zero in Memory) ABS, X
+            STZ ABS_X
+
+        case 0x9F: // BBS1 (Branch on Bit 1 Set) ZP, Relative
+            BBS<1> ZP_Rel
+
+        case 0xA3: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0xA7: // SMB2 (Set Memory Bit 2) ZP
+            SMB<2> ZP
+
+        case 0xAB: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0xAF: // BBS2 (Branch on Bit 2 Set) ZP, Relative
+            BBS<2> ZP_Rel
+
+        case 0xB2: // LDA (Load Accumulator with Memory) (ZP)
+            LDA ZP_IND
+
+        case 0xB3: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0xB7: // SMB3 (Set Memory Bit 3) ZP
+            SMB<3> ZP
+
+        case 0xBB: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0xBF: // BBS3 (Branch on Bit 3 Set) ZP, Relative
+            BBS<3> ZP_Rel
+
+        case 0xC2: // NOP (No Operation) IMM
+            NOP IMM
+
+        case 0xC3: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0xC7: // SMB4 (Set Memory Bit 4) ZP
+            SMB<4> ZP
+
+        case 0xCB: // WAI (Wait for Interrupt) Implied
+            STAT_MODE(S_IMPLIED, 0)
+            return WAI() ? 0x01 : 0x00; // Stays on itself when nothing will wake it, which stops as a hang
+
+        case 0xCF: // BBS4 (Branch on Bit 4 Set) ZP, Relative
+            BBS<4> ZP_Rel
+
+        case 0xD2: // CMP (Compare Memory and Accumulator) (ZP)
+            CMP ZP_IND
+
+        case 0xD3: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0xD4: // NOP (No Operation) ZP, X
+            NOP ZP_X
+
+        case 0xD7: // SMB5 (Set Memory Bit 5) ZP
+            SMB<5> ZP
+
+        case 0xDA: // PHX (Push Index X on Stack) Implied
+            PHX Implied
+
+        case 0xDB: // STP (Stop the Processor) Implied
+            STAT_MODE(S_IMPLIED, 0)
+            return BRK_MOVE;
+
+        case 0xDC: // NOP (No Operation) ABS
+            NOP ABS
+
+        case 0xDF: // BBS5 (Branch on Bit 5 Set) ZP, Relative
+            BBS<5> ZP_Rel
+
+        case 0xE2: // NOP (No Operation) IMM
+            NOP IMM
+
+        case 0xE3: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0xE7: // SMB6 (Set Memory Bit 6) ZP
+            SMB<6> ZP
+
+        case 0xEB: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0xEF: // BBS6 (Branch on Bit 6 Set) ZP, Relative
+            BBS<6> ZP_Rel
+
+        case 0xF2: // SBC (Subtract Memory from Accumulator with Borrow) (ZP)
+            SBC ZP_IND
+
+        case 0xF3: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0xF4: // NOP (No Operation) ZP, X
+            NOP ZP_X
+
+        case 0xF7: // SMB7 (Set Memory Bit 7) ZP
+            SMB<7> ZP
+
+        case 0xFA: // PLX (Pull Index X from Stack) Implied
+            PLX Implied
+
+        case 0xFB: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0xFC: // NOP (No Operation) ABS
+            NOP ABS
+
+        case 0xFF: // BBS7 (Branch on Bit 7 Set) ZP, Relative
+            BBS<7> ZP_Rel
+        #else
+        // Undocumented NMOS opcodes (the 12 that halt the processor break below)
+        case 0x03: // SLO (Shift Left One Bit then "OR" with Accumulator) (IND, X)
+            SLO IND_X
+
+        case 0x04: // NOP (No Operation) ZP
+            NOP ZP
+
+        case 0x07: // SLO (Shift Left One Bit then "OR" with Accumulator) ZP
+            SLO ZP
+
+        case 0x0B: // ANC ("AND" Memory with Accumulator then Copy Negative to Carry) IMM
+            ANC IMM
+
+        case 0x0C: // NOP (No Operation) ABS
+            NOP ABS
+
+        case 0x0F: // SLO (Shift Left One Bit then "OR" with Accumulator) ABS
+            SLO ABS
+
+        case 0x13: // SLO (Shift Left One Bit then "OR" with Accumulator) (IND), Y
+            SLO IND_Y
+
+        case 0x14: // NOP (No Operation) ZP, X
+            NOP ZP_X
+
+        case 0x17: // SLO (Shift Left One Bit then "OR" with Accumulator) ZP, X
+            SLO ZP_X
+
+        case 0x1A: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0x1B: // SLO (Shift Left One Bit then "OR" with Accumulator) ABS, Y
+            SLO ABS_Y
+
+        case 0x1C: // NOP (No Operation) ABS, X
+            NOP ABS_X
+
+        case 0x1F: // SLO (Shift Left One Bit then "OR" with Accumulator) ABS, X
+            SLO ABS_X
+
+        case 0x23: // RLA (Rotate One Bit Left then "AND" with Accumulator) (IND, X)
+            RLA IND_X
+
+        case 0x27: // RLA (Rotate One Bit Left then "AND" with Accumulator) ZP
+            RLA ZP
+
+        case 0x2B: // ANC ("AND" Memory with Accumulator then Copy Negative to Carry) IMM
+            ANC IMM
+
+        case 0x2F: // RLA (Rotate One Bit Left then "AND" with Accumulator) ABS
+            RLA ABS
+
+        case 0x33: // RLA (Rotate One Bit Left then "AND" with Accumulator) (IND), Y
+            RLA IND_Y
+
+        case 0x34: // NOP (No Operation) ZP, X
+            NOP ZP_X
+
+        case 0x37: // RLA (Rotate One Bit Left then "AND" with Accumulator) ZP, X
+            RLA ZP_X
+
+        case 0x3A: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0x3B: // RLA (Rotate One Bit Left then "AND" with Accumulator) ABS, Y
+            RLA ABS_Y
+
+        case 0x3C: // NOP (No Operation) ABS, X
+            NOP ABS_X
+
+        case 0x3F: // RLA (Rotate One Bit Left then "AND" with Accumulator) ABS, X
+            RLA ABS_X
+
+        case 0x43: // SRE (Shift One Bit Right then "Exclusive-OR" with Accumulator) (IND, X)
+            SRE IND_X
+
+        case 0x44: // NOP (No Operation) ZP
+            NOP ZP
+
+        case 0x47: // SRE (Shift One Bit Right then "Exclusive-OR" with Accumulator) ZP
+            SRE ZP
+
+        case 0x4B: // ALR ("AND" Memory with Accumulator then Shift Right) IMM
+            ALR IMM
+
+        case 0x4F: // SRE (Shift One Bit Right then "Exclusive-OR" with Accumulator) ABS
+            SRE ABS
+
+        case 0x53: // SRE (Shift One Bit Right then "Exclusive-OR" with Accumulator) (IND), Y
+            SRE IND_Y
+
+        case 0x54: // NOP (No Operation) ZP, X
+            NOP ZP_X
+
+        case 0x57: // SRE (Shift One Bit Right then "Exclusive-OR" with Accumulator) ZP, X
+            SRE ZP_X
+
+        case 0x5A: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0x5B: // SRE (Shift One Bit Right then "Exclusive-OR" with Accumulator) ABS, Y
+            SRE ABS_Y
+
+        case 0x5C: // NOP (No Operation) ABS, X
+            NOP ABS_X
+
+        case 0x5F: // SRE (Shift One Bit Right then "Exclusive-OR" with Accumulator) ABS, X
+            SRE ABS_X
+
+        case 0x63: // RRA (Rotate One Bit Right then Add to Accumulator with Carry) (IND, X)
+            RRA IND_X
+
+        case 0x64: // NOP (No Operation) ZP
+            NOP ZP
+
+        case 0x67: // RRA (Rotate One Bit Right then Add to Accumulator with Carry) ZP
+            RRA ZP
+
+        case 0x6B: // ARR ("AND" Memory with Accumulator then Rotate Right) IMM
+            ARR IMM
+
+        case 0x6F: // RRA (Rotate One Bit Right then Add to Accumulator with Carry) ABS
+            RRA ABS
+
+        case 0x73: // RRA (Rotate One Bit Right then Add to Accumulator with Carry) (IND), Y
+            RRA IND_Y
+
+        case 0x74: // NOP (No Operation) ZP, X
+            NOP ZP_X
+
+        case 0x77: // RRA (Rotate One Bit Right then Add to Accumulator with Carry) ZP, X
+            RRA ZP_X
+
+        case 0x7A: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0x7B: // RRA (Rotate One Bit Right then Add to Accumulator with Carry) ABS, Y
+            RRA ABS_Y
+
+        case 0x7C: // NOP (No Operation) ABS, X
+            NOP ABS_X
+
+        case 0x7F: // RRA (Rotate One Bit Right then Add to Accumulator with Carry) ABS, X
+            RRA ABS_X
+
+        case 0x80: // NOP (No Operation) IMM
+            NOP IMM
+
+        case 0x82: // NOP (No Operation) IMM
+            NOP IMM
+
+        case 0x83: // SAX (Store Accumulator "AND" Index X in Memory) (IND, X)
+            SAX IND_X
+
+        case 0x87: // SAX (Store Accumulator "AND" Index X in Memory) ZP
+            SAX ZP
+
+        case 0x89: // NOP (No Operation) IMM
+            NOP IMM
+
+        case 0x8B: // XAA (Transfer Index X "AND" Memory to Accumulator, unstable) IMM
+            XAA IMM
+
+        case 0x8F: // SAX (Store Accumulator "AND" Index X in Memory) ABS
+            SAX ABS
+
+        case 0x93: // SHA (Store Accumulator "AND" Index X "AND" High Address Byte + 1) (IND), Y
+            SHA IND_Y
+
+        case 0x97: // SAX (Store Accumulator "AND" Index X in Memory) ZP, Y
+            SAX ZP_Y
+
+        case 0x9B: // TAS (Transfer Accumulator "AND" Index X to Stack then Store with High Address Byte + 1) ABS, Y
+            TAS ABS_Y
+
+        case 0x9C: // SHY (Store Index Y "AND" High Address Byte + 1) ABS, X
+            SHY ABS_X
+
+        case 0x9E: // SHX (Store Index X "AND" High Address Byte + 1) ABS, Y
+            SHX ABS_Y
+
+        case 0x9F: // SHA (Store Accumulator "AND" Index X "AND" High Address Byte + 1) ABS, Y
+            SHA ABS_Y
+
+        case 0xA3: // LAX (Load Accumulator and Index X with Memory) (IND, X)
+            LAX IND_X
+
+        case 0xA7: // LAX (Load Accumulator and Index X with Memory) ZP
+            LAX ZP
+
+        case 0xAB: // LXA (Load Accumulator and Index X with Memory, unstable) IMM
+            LXA IMM
+
+        case 0xAF: // LAX (Load Accumulator and Index X with Memory) ABS
+            LAX ABS
+
+        case 0xB3: // LAX (Load Accumulator and Index X with Memory) (IND), Y
+            LAX IND_Y
+
+        case 0xB7: // LAX (Load Accumulator and Index X with Memory) ZP, Y
+            LAX ZP_Y
+
+        case 0xBB: // LAS (Load Accumulator, Index X and Stack with Memory "AND" Stack) ABS, Y
+            LAS ABS_Y
+
+        case 0xBF: // LAX (Load Accumulator and Index X with Memory) ABS, Y
+            LAX ABS_Y
+
+        case 0xC2: // NOP (No Operation) IMM
+            NOP IMM
+
+        case 0xC3: // DCP (Decrement Memory then Compare with Accumulator) (IND, X)
+            DCP IND_X
+
+        case 0xC7: // DCP (Decrement Memory then Compare with Accumulator) ZP
+            DCP ZP
+
+        case 0xCB: // AXS (Accumulator "AND" Index X minus Memory to Index X) IMM
+            AXS IMM
+
+        case 0xCF: // DCP (Decrement Memory then Compare with Accumulator) ABS
+            DCP ABS
+
+        case 0xD3: // DCP (Decrement Memory then Compare with Accumulator) (IND), Y
+            DCP IND_Y
+
+        case 0xD4: // NOP (No Operation) ZP, X
+            NOP ZP_X
+
+        case 0xD7: // DCP (Decrement Memory then Compare with Accumulator) ZP, X
+            DCP ZP_X
+
+        case 0xDA: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0xDB: // DCP (Decrement Memory then Compare with Accumulator) ABS, Y
+            DCP ABS_Y
+
+        case 0xDC: // NOP (No Operation) ABS, X
+            NOP ABS_X
+
+        case 0xDF: // DCP (Decrement Memory then Compare with Accumulator) ABS, X
+            DCP ABS_X
+
+        case 0xE2: // NOP (No Operation) IMM
+            NOP IMM
+
+        case 0xE3: // ISC (Increment Memory then Subtract from Accumulator with Borrow) (IND, X)
+            ISC IND_X
+
+        case 0xE7: // ISC (Increment Memory then Subtract from Accumulator with Borrow) ZP
+            ISC ZP
+
+        case 0xEB: // SBC (Subtract Memory from Accumulator with Borrow, duplicate) IMM
+            SBC IMM
+
+        case 0xEF: // ISC (Increment Memory then Subtract from Accumulator with Borrow) ABS
+            ISC ABS
+
+        case 0xF3: // ISC (Increment Memory then Subtract from Accumulator with Borrow) (IND), Y
+            ISC IND_Y
+
+        case 0xF4: // NOP (No Operation) ZP, X
+            NOP ZP_X
+
+        case 0xF7: // ISC (Increment Memory then Subtract from Accumulator with Borrow) ZP, X
+            ISC ZP_X
+
+        case 0xFA: // NOP (No Operation) Implied
+            NOP Implied
+
+        case 0xFB: // ISC (Increment Memory then Subtract from Accumulator with Borrow) ABS, Y
+            ISC ABS_Y
+
+        case 0xFC: // NOP (No Operation) ABS, X
+            NOP ABS_X
+
+        case 0xFF: // ISC (Increment Memory then Subtract from Accumulator with Borrow) ABS, X
+            ISC ABS_X
+        #endif
     }
 
     // Break if not returned
-    printf("Broke on opcode %02X\n", opcode);
+    STAT_MODE(S_UNKNOWN, 0)
+    if (halt_print) printf("Broke on opcode %02X\n", opcode);
 
     return BRK_MOVE;
 }
@@ -0,0 +1,64 @@
+#include <cstring>
+
+/* pool.h
+  Contains the machine reset used to recycle the machine between jobs (--serve) and inputs (--fuzz).
+  Instead of clearing or copying all 64 KiB, only the pages written since the last reset (page_dirty in ops.h)
+  are copied back from a pristine image, so a reset costs what the job touched rather than the address space.
+*/
+
+byte* const pristine = arena_pristine; // Next to the main memory (see arena.h)
+
+struct MachineRegs {
+    byte a, x, y, sp, sr;
+    byte2 pc;
+} pristine_regs;
+
+// Take the machine as it is now as the state to reset to
+void machine_snapshot() {
+    memcpy(pristine, memory, MEMORY_SIZE);
+    memset(page_dirty, 0, sizeof(page_dirty));
+
+    pristine_regs = {a, x, y, sp, sr.val(), pc};
+}
+
+// Copy bytes into memory, marking the pages written
+void machine_write(byte2 addr, const void* data, int len) {
+    if (len <= 0) return;
+
+    memcpy(&memory[addr], data, len);
+
+    if (tracing) trace_bulk(addr, len);
+
+    for (int page = addr >> 8; page <= (addr + len - 1) >> 8; page++) {
+        page_dirty[page] = true;
+    }
+}
+
+// Put the machine back to the snapshot, copying only the pages written since
+void machine_reset() {
+    unsigned long long words[0x100 / 8];
+
+    page_dirty[0] = page_dirty[1] = true;
+    memcpy(words, page_dirty, sizeof(page_dirty));
+
+    // Skip eight clean pages at a time
+    for (int word = 0; word < 0x100 / 8; word++) {
+        if (!words[word]) continue;
+
+        for (int page = word * 8; page < word * 8 + 8; page++) {
+            if (!page_dirty[page]) continue;
+
+            memcpy(&memory[page << 8], &pristine[page << 8], 0x100);
+        }
+    }
+
+    memset(page_dirty, 0, sizeof(page_dirty));
+
+    a = pristine_regs.a;
+    x = pristine_regs.x;
+    y = pristine_regs.y;
+    sp = pristine_regs.sp;
+    sr.set(pristine_regs.sr);
+    pc = pristine_regs.pc;
+    cycles = 0;
+}
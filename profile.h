@@ -0,0 +1,198 @@
+#include <vector>
+#include <map>
+#include <algorithm>
+
+/* profile.h
+  Contains the guest code profiler (hot PCs, opcodes and JSR/RTS call graph).
+*/
+
+bool profiling = false;
+string profile_file = "profile.folded"; // Collapsed stacks output (for flamegraph tools)
+
+// Flat counters indexed by program counter and opcode
+unsigned long long pc_hits[0x10000] = {};
+unsigned long long pc_cycles[0x10000] = {};
+unsigned long long op_hits[0x100] = {};
+unsigned long long pair_hits[0x10000] = {};  // Opcode after opcode, indexed by first * 0x100 + second (candidates for fuse.h)
+
+int prof_last_op = -1;                         // Opcode of the instruction before, if it went on to the next one
+
+// Node of the call tree, one for each distinct call stack
+struct ProfileNode {
+    byte2 addr;                   // Subroutine address
+    int parent;                   // Index of calling node (-1 for root)
+    unsigned long long self = 0;  // Cycles spent in this stack (exclusive)
+};
+
+std::vector<ProfileNode> prof_nodes;
+std::map<std::pair<int, byte2>, int> prof_children;
+
+// Currently open subroutine calls
+struct ProfileFrame {
+    int node;
+    byte sp;                      // Stack pointer before the JSR (restored by the matching RTS)
+    unsigned long long start;     // Cycle count on entry
+};
+
+std::vector<ProfileFrame> prof_stack;
+int prof_cur = 0;
+
+// Totals per subroutine address
+struct ProfileSub {
+    unsigned long long calls = 0;
+    unsigned long long incl = 0;
+    unsigned long long excl = 0;
+};
+
+std::map<byte2, ProfileSub> prof_subs;
+std::map<byte2, int> prof_open;   // Open calls per subroutine, so a recursive one adds its inclusive time once
+
+
+void profile_start(byte2 entry) {
+    prof_nodes.push_back({entry, -1});
+    prof_subs[entry].calls++;
+    prof_open[entry] = 1;         // Open until the report adds it
+    prof_cur = 0;
+}
+
+// Close the innermost open call and add its time to its subroutine
+void profile_pop() {
+    ProfileFrame frame = prof_stack.back();
+    prof_stack.pop_back();
+
+    byte2 addr = prof_nodes[frame.node].addr;
+
+    // Only the outermost open call counts, the time of the ones inside it is already part of it
+    if (--prof_open[addr] == 0) prof_subs[addr].incl += cycles - frame.start;
+
+    prof_cur = prof_stack.empty() ? 0 : prof_stack.back().node;
+}
+
+// Record an executed instruction (called after pc has been moved)
+void profile_step(byte2 at, byte opcode, unsigned long long spent) {
+    pc_hits[at]++;
+    pc_cycles[at] += spent;
+    op_hits[opcode]++;
+
+    if (prof_last_op >= 0) pair_hits[prof_last_op * 0x100 + opcode]++;
+
+    prof_last_op = pc == (byte2)(at + op_info[opcode].length) ? opcode : -1;
+
+    prof_nodes[prof_cur].self += spent;
+
+    if (opcode == 0x20) { // JSR
+        std::pair<int, byte2> key(prof_cur, pc);
+        auto found = prof_children.find(key);
+
+        if (found == prof_children.end()) {
+            found = prof_children.emplace(key, prof_nodes.size()).first;
+            prof_nodes.push_back({pc, prof_cur});
+        }
+
+        prof_cur = found->second;
+        prof_stack.push_back({prof_cur, (byte)(sp + 2), cycles});
+        prof_subs[pc].calls++;
+        prof_open[pc]++;
+    }
+
+    else if (opcode == 0x60) { // RTS (also closes calls whose return address was discarded)
+        while (!prof_stack.empty() && prof_stack.back().sp <= sp) {
+            profile_pop();
+        }
+    }
+}
+
+// Get the collapsed stack name of a call tree node
+string profile_path(int node) {
+    char name[10];
+    snprintf(name, sizeof(name), "sub_%04X", prof_nodes[node].addr);
+
+    if (prof_nodes[node].parent == -1) return name;
+
+    return profile_path(prof_nodes[node].parent) + ";" + name;
+}
+
+void profile_report(size_t count = 20) {
+    // Count calls still open when execution stopped
+    while (!prof_stack.empty()) {
+        profile_pop();
+    }
+
+    prof_subs[prof_nodes[0].addr].incl += cycles;
+
+    for (ProfileNode& node : prof_nodes) {
+        prof_subs[node.addr].excl += node.self;
+    }
+
+    unsigned long long total = 0;
+    std::vector<byte2> pcs;
+
+    for (int i = 0; i < 0x10000; i++) {
+        total += pc_hits[i];
+
+        if (pc_hits[i]) pcs.push_back(i);
+    }
+
+    std::sort(pcs.begin(), pcs.end(), [](byte2 l, byte2 r) { return pc_cycles[l] > pc_cycles[r]; });
+
+    printf("\nProfile: %llu instructions, %llu cycles\n", total, cycles);
+
+    char text[DISASM_MAX];
+
+    printf("\n  Hot PCs                          Count       Cycles       %%\n");
+    for (size_t i = 0; i < count && i < pcs.size(); i++) {
+        disasm(pcs[i], text);
+        printf("    %04X %02X %-14s  %12llu %12llu  %5.1f%%\n", pcs[i], memory[pcs[i]], text, pc_hits[pcs[i]], pc_cycles[pcs[i]], 100.0 * pc_cycles[pcs[i]] / cycles);
+    }
+
+    std::vector<byte> ops;
+
+    for (int i = 0; i < 0x100; i++) {
+        if (op_hits[i]) ops.push_back(i);
+    }
+
+    std::sort(ops.begin(), ops.end(), [](byte l, byte r) { return op_hits[l] > op_hits[r]; });
+
+    printf("\n  Opcodes           Count       %%\n");
+    for (size_t i = 0; i < count && i < ops.size(); i++) {
+        printf("    %02X %-4s  %12llu  %5.1f%%\n", ops[i], op_info[ops[i]].name, op_hits[ops[i]], 100.0 * op_hits[ops[i]] / total);
+    }
+
+    std::vector<int> pairs;
+
+    for (int i = 0; i < 0x10000; i++) {
+        if (pair_hits[i]) pairs.push_back(i);
+    }
+
+    std::sort(pairs.begin(), pairs.end(), [](int l, int r) { return pair_hits[l] > pair_hits[r]; });
+
+    printf("\n  Opcode pairs              Count       %%\n");
+    for (size_t i = 0; i < count && i < pairs.size(); i++) {
+        printf("    %02X %02X %-4s %-4s  %12llu  %5.1f%%\n", pairs[i] >> 8, pairs[i] & 0xFF, op_info[pairs[i] >> 8].name, op_info[pairs[i] & 0xFF].name, pair_hits[pairs[i]], 100.0 * pair_hits[pairs[i]] / total);
+    }
+
+    std::vector<std::pair<byte2, ProfileSub>> subs(prof_subs.begin(), prof_subs.end());
+
+    std::sort(subs.begin(), subs.end(), [](const std::pair<byte2, ProfileSub>& l, const std::pair<byte2, ProfileSub>& r) { return l.second.incl > r.second.incl; });
+
+    printf("\n  Subroutines       Calls    Inclusive    Exclusive\n");
+    for (size_t i = 0; i < count && i < subs.size(); i++) {
+        printf("    sub_%04X %12llu %12llu %12llu\n", subs[i].first, subs[i].second.calls, subs[i].second.incl, subs[i].second.excl);
+    }
+
+    // Write collapsed stacks ("sub_1000;sub_1017 123" per line)
+    FILE* out = fopen(profile_file.c_str(), "w");
+
+    if (out == NULL) {
+        printf("\nUnable to write profile stacks to \"%s\".\n", profile_file.c_str());
+        return;
+    }
+
+    for (size_t i = 0; i < prof_nodes.size(); i++) {
+        if (prof_nodes[i].self) fprintf(out, "%s %llu\n", profile_path(i).c_str(), prof_nodes[i].self);
+    }
+
+    fclose(out);
+
+    printf("\nWrote collapsed stacks to \"%s\".\n", profile_file.c_str());
+}
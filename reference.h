@@ -0,0 +1,419 @@
+#include <vector>
+#include <cstring>
+
+/* reference.h
+  Contains a table-driven reference model of the documented 6502 opcodes, run in lockstep with instruction() by -lk.
+*/
+
+// Operations and addressing modes of the reference table
+enum RefOp {
+    R_XXX, R_ADC, R_AND, R_ASL, R_BCC, R_BCS, R_BEQ, R_BIT, R_BMI, R_BNE, R_BPL, R_BRK, R_BVC, R_BVS, R_CLC, R_CLD,
+    R_CLI, R_CLV, R_CMP, R_CPX, R_CPY, R_DEC, R_DEX, R_DEY, R_EOR, R_INC, R_INX, R_INY, R_JMP, R_JSR, R_LDA, R_LDX,
+    R_LDY, R_LSR, R_NOP, R_ORA, R_PHA, R_PHP, R_PLA, R_PLP, R_ROL, R_ROR, R_RTI, R_RTS, R_SBC, R_SEC, R_SED, R_SEI,
+    R_STA, R_STX, R_STY, R_TAX, R_TAY, R_TSX, R_TXA, R_TXS, R_TYA
+};
+
+// Names of the operations, which are also the names of their functions in ops.h
+const char* ref_names[] = {
+    "XXX", "ADC", "AND", "ASL", "BCC", "BCS", "BEQ", "BIT", "BMI", "BNE", "BPL", "BRK", "BVC", "BVS", "CLC", "CLD",
+    "CLI", "CLV", "CMP", "CPX", "CPY", "DEC", "DEX", "DEY", "EOR", "INC", "INX", "INY", "JMP", "JSR", "LDA", "LDX",
+    "LDY", "LSR", "NOP", "ORA", "PHA", "PHP", "PLA", "PLP", "ROL", "ROR", "RTI", "RTS", "SBC", "SEC", "SED", "SEI",
+    "STA", "STX", "STY", "TAX", "TAY", "TSX", "TXA", "TXS", "TYA"
+};
+
+enum RefMode { M_IMP, M_ACC, M_IMM, M_REL, M_ZP, M_ZPX, M_ZPY, M_ABS, M_ABX, M_ABY, M_IND, M_IZX, M_IZY };
+
+struct RefEntry {
+    RefOp op;
+    RefMode mode;
+};
+
+const RefEntry ref_table[0x100] = {
+    {R_BRK, M_IMP}, {R_ORA, M_IZX}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_ORA, M_ZP}, {R_ASL, M_ZP}, {R_XXX, M_IMP}, // 00
+    {R_PHP, M_IMP}, {R_ORA, M_IMM}, {R_ASL, M_ACC}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_ORA, M_ABS}, {R_ASL, M_ABS}, {R_XXX, M_IMP}, // 08
+    {R_BPL, M_REL}, {R_ORA, M_IZY}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_ORA, M_ZPX}, {R_ASL, M_ZPX}, {R_XXX, M_IMP}, // 10
+    {R_CLC, M_IMP}, {R_ORA, M_ABY}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_ORA, M_ABX}, {R_ASL, M_ABX}, {R_XXX, M_IMP}, // 18
+    {R_JSR, M_ABS}, {R_AND, M_IZX}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_BIT, M_ZP}, {R_AND, M_ZP}, {R_ROL, M_ZP}, {R_XXX, M_IMP}, // 20
+    {R_PLP, M_IMP}, {R_AND, M_IMM}, {R_ROL, M_ACC}, {R_XXX, M_IMP}, {R_BIT, M_ABS}, {R_AND, M_ABS}, {R_ROL, M_ABS}, {R_XXX, M_IMP}, // 28
+    {R_BMI, M_REL}, {R_AND, M_IZY}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_AND, M_ZPX}, {R_ROL, M_ZPX}, {R_XXX, M_IMP}, // 30
+    {R_SEC, M_IMP}, {R_AND, M_ABY}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_AND, M_ABX}, {R_ROL, M_ABX}, {R_XXX, M_IMP}, // 38
+    {R_RTI, M_IMP}, {R_EOR, M_IZX}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_EOR, M_ZP}, {R_LSR, M_ZP}, {R_XXX, M_IMP}, // 40
+    {R_PHA, M_IMP}, {R_EOR, M_IMM}, {R_LSR, M_ACC}, {R_XXX, M_IMP}, {R_JMP, M_ABS}, {R_EOR, M_ABS}, {R_LSR, M_ABS}, {R_XXX, M_IMP}, // 48
+    {R_BVC, M_REL}, {R_EOR, M_IZY}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_EOR, M_ZPX}, {R_LSR, M_ZPX}, {R_XXX, M_IMP}, // 50
+    {R_CLI, M_IMP}, {R_EOR, M_ABY}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_EOR, M_ABX}, {R_LSR, M_ABX}, {R_XXX, M_IMP}, // 58
+    {R_RTS, M_IMP}, {R_ADC, M_IZX}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_ADC, M_ZP}, {R_ROR, M_ZP}, {R_XXX, M_IMP}, // 60
+    {R_PLA, M_IMP}, {R_ADC, M_IMM}, {R_ROR, M_ACC}, {R_XXX, M_IMP}, {R_JMP, M_IND}, {R_ADC, M_ABS}, {R_ROR, M_ABS}, {R_XXX, M_IMP}, // 68
+    {R_BVS, M_REL}, {R_ADC, M_IZY}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_ADC, M_ZPX}, {R_ROR, M_ZPX}, {R_XXX, M_IMP}, // 70
+    {R_SEI, M_IMP}, {R_ADC, M_ABY}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_ADC, M_ABX}, {R_ROR, M_ABX}, {R_XXX, M_IMP}, // 78
+    {R_XXX, M_IMP}, {R_STA, M_IZX}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_STY, M_ZP}, {R_STA, M_ZP}, {R_STX, M_ZP}, {R_XXX, M_IMP}, // 80
+    {R_DEY, M_IMP}, {R_XXX, M_IMP}, {R_TXA, M_IMP}, {R_XXX, M_IMP}, {R_STY, M_ABS}, {R_STA, M_ABS}, {R_STX, M_ABS}, {R_XXX, M_IMP}, // 88
+    {R_BCC, M_REL}, {R_STA, M_IZY}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_STY, M_ZPX}, {R_STA, M_ZPX}, {R_STX, M_ZPY}, {R_XXX, M_IMP}, // 90
+    {R_TYA, M_IMP}, {R_STA, M_ABY}, {R_TXS, M_IMP}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_STA, M_ABX}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, // 98
+    {R_LDY, M_IMM}, {R_LDA, M_IZX}, {R_LDX, M_IMM}, {R_XXX, M_IMP}, {R_LDY, M_ZP}, {R_LDA, M_ZP}, {R_LDX, M_ZP}, {R_XXX, M_IMP}, // A0
+    {R_TAY, M_IMP}, {R_LDA, M_IMM}, {R_TAX, M_IMP}, {R_XXX, M_IMP}, {R_LDY, M_ABS}, {R_LDA, M_ABS}, {R_LDX, M_ABS}, {R_XXX, M_IMP}, // A8
+    {R_BCS, M_REL}, {R_LDA, M_IZY}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_LDY, M_ZPX}, {R_LDA, M_ZPX}, {R_LDX, M_ZPY}, {R_XXX, M_IMP}, // B0
+    {R_CLV, M_IMP}, {R_LDA, M_ABY}, {R_TSX, M_IMP}, {R_XXX, M_IMP}, {R_LDY, M_ABX}, {R_LDA, M_ABX}, {R_LDX, M_ABY}, {R_XXX, M_IMP}, // B8
+    {R_CPY, M_IMM}, {R_CMP, M_IZX}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_CPY, M_ZP}, {R_CMP, M_ZP}, {R_DEC, M_ZP}, {R_XXX, M_IMP}, // C0
+    {R_INY, M_IMP}, {R_CMP, M_IMM}, {R_DEX, M_IMP}, {R_XXX, M_IMP}, {R_CPY, M_ABS}, {R_CMP, M_ABS}, {R_DEC, M_ABS}, {R_XXX, M_IMP}, // C8
+    {R_BNE, M_REL}, {R_CMP, M_IZY}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_CMP, M_ZPX}, {R_DEC, M_ZPX}, {R_XXX, M_IMP}, // D0
+    {R_CLD, M_IMP}, {R_CMP, M_ABY}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_CMP, M_ABX}, {R_DEC, M_ABX}, {R_XXX, M_IMP}, // D8
+    {R_CPX, M_IMM}, {R_SBC, M_IZX}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_CPX, M_ZP}, {R_SBC, M_ZP}, {R_INC, M_ZP}, {R_XXX, M_IMP}, // E0
+    {R_INX, M_IMP}, {R_SBC, M_IMM}, {R_NOP, M_IMP}, {R_XXX, M_IMP}, {R_CPX, M_ABS}, {R_SBC, M_ABS}, {R_INC, M_ABS}, {R_XXX, M_IMP}, // E8
+    {R_BEQ, M_REL}, {R_SBC, M_IZY}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_SBC, M_ZPX}, {R_INC, M_ZPX}, {R_XXX, M_IMP}, // F0
+    {R_SED, M_IMP}, {R_SBC, M_ABY}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_XXX, M_IMP}, {R_SBC, M_ABX}, {R_INC, M_ABX}, {R_XXX, M_IMP}  // F8
+};
+
+const byte ref_lengths[] = {1, 1, 2, 2, 2, 2, 2, 3, 3, 3, 3, 2, 2}; // Instruction length per RefMode
+
+struct Reference {
+    byte mem[0x10000];
+    byte a, x, y, sp, p;
+    byte2 pc;
+
+    std::vector<byte2> writes; // Addresses written since the last check
+
+    void write(byte2 addr, byte val) {
+        mem[addr] = val;
+        writes.push_back(addr);
+    }
+
+    void push(byte val) {
+        write(0x100 + sp--, val);
+    }
+
+    byte pull() {
+        return mem[0x100 + ++sp];
+    }
+
+    void flag(byte bit, bool set) {
+        p = set ? p | bit : p & ~bit;
+    }
+
+    byte nz(byte val) {
+        flag(F_N, val & 0x80);
+        flag(F_Z, !val);
+
+        return val;
+    }
+
+    byte2 word(byte2 addr) {
+        return mem[addr] + 0x100 * mem[(byte2)(addr + 1)];
+    }
+
+    // Get the effective address of an instruction
+    byte2 address(RefMode mode) {
+        byte lo = mem[(byte2)(pc + 1)];
+        byte2 abs = word(pc + 1);
+
+        switch (mode) {
+            case M_IMM: return pc + 1;
+            case M_ZP: return lo;
+            case M_ZPX: return (byte)(lo + x);
+            case M_ZPY: return (byte)(lo + y);
+            case M_ABS: return abs;
+            case M_ABX: return abs + x;
+            case M_ABY: return abs + y;
+            #if defined(CPU_65C02)
+            case M_IND: return mem[abs] + 0x100 * mem[(byte2)(abs + 1)];
+            #else
+            case M_IND: return mem[abs] + 0x100 * mem[(abs & 0xFF00) | (byte)(abs + 1)]; // Page wrap of the pointer
+            #endif
+            case M_IZX: return mem[(byte)(lo + x)] + 0x100 * mem[(byte)(lo + x + 1)];
+            case M_IZY: return (byte2)(mem[lo] + 0x100 * mem[(byte)(lo + 1)] + y);
+            default: return 0;
+        }
+    }
+
+    // Decimal mode works a digit at a time, as described for the chips rather than following ops.h, so -lk can check it
+    void adc_decimal(byte val, int c) {
+        int lo = (a & 0x0F) + (val & 0x0F) + c;
+        bool half = lo > 9;
+
+        if (half) lo = (lo + 6) & 0x0F;
+
+        int hi = (a >> 4) + (val >> 4) + half;
+        int signed_hi = ((a >> 4) ^ 8) - 8 + ((val >> 4) ^ 8) - 8 + half;
+
+        // N and V from the high digit before it is adjusted, Z from the binary sum
+        flag(F_N, hi & 8);
+        flag(F_V, signed_hi < -8 || signed_hi > 7);
+        flag(F_Z, !(byte)(a + val + c));
+        flag(F_C, hi > 9);
+
+        if (hi > 9) hi += 6;
+
+        a = (hi & 0x0F) * 0x10 + lo;
+        #if defined(CPU_65C02)
+        nz(a);
+        #endif
+    }
+
+    // Flags are the binary ones (set by sbc)
+    void sbc_decimal(byte val, int borrow) {
+        int lo = (a & 0x0F) - (val & 0x0F) - borrow;
+        int hi = (a >> 4) - (val >> 4) - (lo < 0);
+
+        #if defined(CPU_65C02)
+        // The binary difference, less 6 for each digit that borrowed (so a low digit's adjustment can carry into the high one)
+        a = a - val - borrow - (hi < 0 ? 0x60 : 0) - (lo < 0 ? 0x06 : 0);
+        nz(a);
+        #else
+        // Each digit on its own
+        if (lo < 0) lo = (lo - 6) & 0x0F;
+        if (hi < 0) hi = (hi - 6) & 0x0F;
+
+        a = hi * 0x10 + lo;
+        #endif
+    }
+
+    void adc(byte val) {
+        int c = p & F_C;
+        int sum = a + val + c;
+
+        #if !defined(CPU_2A03)
+        if (p & F_D) {
+            adc_decimal(val, c);
+            return;
+        }
+        #endif
+
+        flag(F_V, ~(a ^ val) & (a ^ sum) & 0x80);
+        flag(F_C, sum > 0xFF);
+        a = nz(sum);
+    }
+
+    void sbc(byte val) {
+        int borrow = !(p & F_C);
+        int dif = a - val - borrow;
+
+        flag(F_V, (a ^ val) & (a ^ dif) & 0x80);
+        flag(F_C, dif >= 0);
+        nz(dif);
+
+        #if !defined(CPU_2A03)
+        if (p & F_D) {
+            sbc_decimal(val, borrow);
+            return;
+        }
+        #endif
+
+        a = dif;
+    }
+
+    void compare(byte reg, byte val) {
+        flag(F_C, reg >= val);
+        nz(reg - val);
+    }
+
+    void branch(bool taken) {
+        if (taken) pc += (signed char)mem[(byte2)(pc + 1)];
+    }
+
+    // Execute the instruction at pc, returns false for unknown opcodes
+    bool step() {
+        const RefEntry& ins = ref_table[mem[pc]];
+
+        byte2 addr = address(ins.mode);
+        byte val = ins.mode == M_ACC ? a : mem[addr];
+        byte out = 0;
+
+        switch (ins.op) {
+            case R_XXX: return false;
+
+            case R_ADC: adc(val); break;
+            case R_SBC: sbc(val); break;
+            case R_AND: a = nz(a & val); break;
+            case R_ORA: a = nz(a | val); break;
+            case R_EOR: a = nz(a ^ val); break;
+
+            case R_ASL: case R_LSR: case R_ROL: case R_ROR:
+                if (ins.op == R_ASL) out = val << 1;
+                if (ins.op == R_LSR) out = val >> 1;
+                if (ins.op == R_ROL) out = val << 1 | (p & F_C);
+                if (ins.op == R_ROR) out = val >> 1 | (p & F_C) << 7;
+
+                flag(F_C, ins.op == R_ASL || ins.op == R_ROL ? val & 0x80 : val & 0x01);
+                nz(out);
+
+                if (ins.mode == M_ACC) a = out;
+                else write(addr, out);
+                break;
+
+            case R_INC: write(addr, nz(val + 1)); break;
+            case R_DEC: write(addr, nz(val - 1)); break;
+
+            case R_BIT:
+                flag(F_N, val & 0x80);
+                flag(F_V, val & 0x40);
+                flag(F_Z, !(a & val));
+                break;
+
+            case R_BPL: branch(!(p & F_N)); break;
+            case R_BMI: branch(p & F_N); break;
+            case R_BVC: branch(!(p & F_V)); break;
+            case R_BVS: branch(p & F_V); break;
+            case R_BCC: branch(!(p & F_C)); break;
+            case R_BCS: branch(p & F_C); break;
+            case R_BNE: branch(!(p & F_Z)); break;
+            case R_BEQ: branch(p & F_Z); break;
+
+            case R_BRK:
+                push((pc + 2) / 0x100);
+                push((pc + 2) % 0x100);
+                push(p | F_B | F_U);
+                p |= F_I;
+                #if defined(CPU_65C02)
+                p &= ~F_D;
+                #endif
+                pc = word(0xFFFE);
+                return true;
+
+            case R_JMP: pc = addr; return true;
+
+            case R_JSR:
+                push((pc + 2) / 0x100);
+                push((pc + 2) % 0x100);
+                pc = addr;
+                return true;
+
+            case R_RTS:
+                pc = pull();
+                pc += 0x100 * pull() + 1;
+                return true;
+
+            case R_RTI:
+                p = pull() | F_B | F_U;
+                pc = pull();
+                pc += 0x100 * pull();
+                return true;
+
+            case R_CLC: p &= ~F_C; break;
+            case R_CLD: p &= ~F_D; break;
+            case R_CLI: p &= ~F_I; break;
+            case R_CLV: p &= ~F_V; break;
+            case R_SEC: p |= F_C; break;
+            case R_SED: p |= F_D; break;
+            case R_SEI: p |= F_I; break;
+
+            case R_CMP: compare(a, val); break;
+            case R_CPX: compare(x, val); break;
+            case R_CPY: compare(y, val); break;
+
+            case R_LDA: a = nz(val); break;
+            case R_LDX: x = nz(val); break;
+            case R_LDY: y = nz(val); break;
+            case R_STA: write(addr, a); break;
+            case R_STX: write(addr, x); break;
+            case R_STY: write(addr, y); break;
+
+            case R_TAX: x = nz(a); break;
+            case R_TAY: y = nz(a); break;
+            case R_TXA: a = nz(x); break;
+            case R_TYA: a = nz(y); break;
+            case R_TSX: x = nz(sp); break;
+            case R_TXS: sp = x; break;
+            case R_INX: x = nz(x + 1); break;
+            case R_INY: y = nz(y + 1); break;
+            case R_DEX: x = nz(x - 1); break;
+            case R_DEY: y = nz(y - 1); break;
+
+            case R_PHA: push(a); break;
+            case R_PHP: push(p | F_B | F_U); break;
+            case R_PLA: a = nz(pull()); break;
+            case R_PLP: p = pull() | F_B | F_U; break;
+
+            case R_NOP: break;
+        }
+
+        pc += ref_lengths[ins.mode];
+        return true;
+    }
+};
+
+// Lockstep options
+bool lockstep = false;
+int lockstep_interval = 1; // Instructions between comparisons
+
+Reference ref;
+unsigned long long lock_count = 0;
+unsigned long long lock_checks = 0;
+
+// Copy the current machine into the reference model
+void lockstep_start() {
+    memcpy(ref.mem, memory, 0x10000);
+
+    ref.a = a;
+    ref.x = x;
+    ref.y = y;
+    ref.sp = sp;
+    ref.p = sr.val();
+    ref.pc = pc;
+}
+
+// Compare registers, memory written by the reference and (if full) all of memory
+bool lockstep_check(byte2 at, bool full) {
+    byte status = sr.val();
+    bool same = a == ref.a && x == ref.x && y == ref.y && sp == ref.sp && status == ref.p && pc == ref.pc;
+    std::vector<byte2> diffs;
+
+    for (byte2 addr : ref.writes) {
+        if (memory[addr] != ref.mem[addr]) diffs.push_back(addr);
+    }
+
+    if (full && memcmp(memory, ref.mem, 0x10000)) {
+        diffs.clear();
+
+        for (int addr = 0; addr < 0x10000; addr++) {
+            if (memory[addr] != ref.mem[addr]) diffs.push_back(addr);
+        }
+    }
+
+    ref.writes.clear();
+
+    if (same && diffs.empty()) return true;
+
+    printf("Lockstep divergence after %llu instructions, last at %04X (%02X %02X %02X)%s:\n", lock_count, at, memory[at], memory[(byte2)(at + 1)], memory[(byte2)(at + 2)],
+        lockstep_interval > 1 ? " or in the instructions before it" : "");
+
+    printf("         A  X  Y  S  SR/NV-BDIZC  PC\n");
+    printf("  main   %02X %02X %02X %02X %02X [%d%d%d%d%d%d%d%d] %04X\n", a, x, y, sp, status, sr.n, sr.v, sr._, sr.b, sr.d, sr.i, sr.z, sr.c, pc);
+    printf("  ref    %02X %02X %02X %02X %02X [", ref.a, ref.x, ref.y, ref.sp, ref.p);
+    for (int bit = 7; bit >= 0; bit--) {
+        printf("%d", ref.p >> bit & 1);
+    }
+    printf("] %04X\n", ref.pc);
+
+    for (size_t i = 0; i < diffs.size() && i < 16; i++) {
+        printf("  %04X   main %02X ref %02X\n", diffs[i], memory[diffs[i]], ref.mem[diffs[i]]);
+    }
+
+    if (diffs.size() > 16) printf("  ... %d more memory differences\n", (int)diffs.size() - 16);
+
+    return false;
+}
+
+// Compare everything once stopped (a stopping BRK moves pc past the vector, so that isn't compared)
+void lockstep_finish(byte2 at, bool brk) {
+    if (brk) {
+        ref.step();
+        ref.pc = pc;
+    }
+
+    lockstep_check(at, true);
+}
+
+// Step the reference after instruction() ran the instruction at "at", returns false on divergence
+bool lockstep_step(byte2 at) {
+    if (!ref.step()) {
+        // Undocumented and 65C02 opcodes aren't modelled, so stop comparing from here on
+        printf("Lockstep stopped: the reference core doesn't model opcode %02X at %04X.\n", memory[at], at);
+        lockstep = false;
+        return true;
+    }
+
+    if (++lock_count % lockstep_interval) return true;
+
+    lock_checks++;
+
+    return lockstep_check(at, lock_checks % (0x1000 / lockstep_interval + 1) == 0);
+}
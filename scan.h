@@ -0,0 +1,253 @@
+#include <vector>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/* scan.h
+  Contains the memory dump formatting, diff and search routines (--dump, --diff, --find).
+  They use AVX2 or SSE2 when the build targets them (e.g. -mavx2), otherwise plain loops.
+*/
+
+string dump_file;   // Write memory here once stopped
+string diff_file;   // Compare memory with this image once stopped
+string diff_image;
+string find_bytes;  // Search memory for these once stopped
+
+// Hex digits of every byte value ("00 " to "FF ")
+struct HexTable {
+    char digits[0x100][3];
+
+    HexTable() {
+        for (int i = 0; i < 0x100; i++) {
+            digits[i][0] = "0123456789ABCDEF"[i >> 4];
+            digits[i][1] = "0123456789ABCDEF"[i & 0x0F];
+            digits[i][2] = ' ';
+        }
+    }
+} hex_table;
+
+// Format bytes as "XX " each (3 chars per byte)
+void dump_hex(const byte* src, int len, char* out) {
+    int i = 0;
+
+    #if defined(__SSE2__)
+    const __m128i low = _mm_set1_epi8(0x0F);
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i letter = _mm_set1_epi8('A' - '0' - 10);
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i val = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i nibbles[2] = {_mm_and_si128(_mm_srli_epi16(val, 4), low), _mm_and_si128(val, low)};
+
+        // Digits, moved up to letters past 9
+        for (__m128i& n : nibbles) {
+            n = _mm_add_epi8(_mm_add_epi8(n, zero), _mm_and_si128(_mm_cmpgt_epi8(n, nine), letter));
+        }
+
+        char digits[32];
+        _mm_storeu_si128((__m128i*)digits, _mm_unpacklo_epi8(nibbles[0], nibbles[1]));
+        _mm_storeu_si128((__m128i*)(digits + 16), _mm_unpackhi_epi8(nibbles[0], nibbles[1]));
+
+        for (int j = 0; j < 16; j++) {
+            out[3 * (i + j)] = digits[2 * j];
+            out[3 * (i + j) + 1] = digits[2 * j + 1];
+            out[3 * (i + j) + 2] = ' ';
+        }
+    }
+    #endif
+
+    for (; i < len; i++) {
+        memcpy(out + 3 * i, hex_table.digits[src[i]], 3);
+    }
+}
+
+// Copy bytes, replacing the ones outside space to tilde with a period
+void dump_ascii(const byte* src, int len, char* out) {
+    int i = 0;
+
+    #if defined(__AVX2__)
+    for (; i + 32 <= len; i += 32) {
+        __m256i val = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i keep = _mm256_and_si256(_mm256_cmpgt_epi8(val, _mm256_set1_epi8(0x1F)), _mm256_cmpgt_epi8(_mm256_set1_epi8(0x7F), val));
+
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_blendv_epi8(_mm256_set1_epi8('.'), val, keep));
+    }
+    #elif defined(__SSE2__)
+    for (; i + 16 <= len; i += 16) {
+        __m128i val = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i keep = _mm_and_si128(_mm_cmpgt_epi8(val, _mm_set1_epi8(0x1F)), _mm_cmplt_epi8(val, _mm_set1_epi8(0x7F)));
+
+        _mm_storeu_si128((__m128i*)(out + i), _mm_or_si128(_mm_and_si128(keep, val), _mm_andnot_si128(keep, _mm_set1_epi8('.'))));
+    }
+    #endif
+
+    for (; i < len; i++) {
+        out[i] = src[i] >= 0x20 && src[i] <= 0x7E ? src[i] : '.';
+    }
+}
+
+// Index of the first byte from "from" where the two ranges differ (same is false) or match (same is true), len if none
+int scan_compare(const byte* l, const byte* r, int from, int len, bool same) {
+    int i = from;
+
+    #if defined(__AVX2__)
+    for (; i + 32 <= len; i += 32) {
+        unsigned int equal = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(l + i)), _mm256_loadu_si256((const __m256i*)(r + i))));
+        unsigned int found = same ? equal : ~equal;
+
+        if (found) return i + __builtin_ctz(found);
+    }
+    #elif defined(__SSE2__)
+    for (; i + 16 <= len; i += 16) {
+        unsigned int equal = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(l + i)), _mm_loadu_si128((const __m128i*)(r + i))));
+        unsigned int found = (same ? equal : ~equal) & 0xFFFF;
+
+        if (found) return i + __builtin_ctz(found);
+    }
+    #endif
+
+    for (; i < len; i++) {
+        if ((l[i] == r[i]) == same) return i;
+    }
+
+    return len;
+}
+
+// Index of the next match of a pattern from "from", len if none
+int scan_find(const byte* src, int len, const byte* pat, int plen, int from) {
+    int last = len - plen; // Last index a match can start at
+    int i = from;
+
+    if (plen == 0 || last < from) return len;
+
+    #if defined(__AVX2__)
+    __m256i first = _mm256_set1_epi8(pat[0]);
+
+    for (; i + 32 <= last + 1; i += 32) {
+        unsigned int found = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(src + i)), first));
+
+        for (; found; found &= found - 1) {
+            int at = i + __builtin_ctz(found);
+
+            if (!memcmp(src + at, pat, plen)) return at;
+        }
+    }
+    #elif defined(__SSE2__)
+    __m128i first = _mm_set1_epi8(pat[0]);
+
+    for (; i + 16 <= last + 1; i += 16) {
+        unsigned int found = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(src + i)), first));
+
+        for (; found; found &= found - 1) {
+            int at = i + __builtin_ctz(found);
+
+            if (!memcmp(src + at, pat, plen)) return at;
+        }
+    }
+    #endif
+
+    for (; i <= last; i++) {
+        if (src[i] == pat[0] && !memcmp(src + i, pat, plen)) return i;
+    }
+
+    return len;
+}
+
+// Print rows of memory ("0200: A9 00 ... | ascii"), each as one write
+void dump_rows(int start, int rows, int rowsize, bool ascii) {
+    std::vector<char> line(10 + 4 * rowsize);
+
+    for (int i = 0; i < rows && rowsize * (1 + i) + start <= 0x10000; i++) {
+        int addr = rowsize * i + start;
+        char* at = line.data();
+
+        at += snprintf(at, 8, "\n%04X: ", addr);
+
+        dump_hex(&memory[addr], rowsize, at);
+        at += 3 * rowsize;
+
+        if (ascii) {
+            memcpy(at, "| ", 2);
+            dump_ascii(&memory[addr], rowsize, at + 2);
+            at += 2 + rowsize;
+        }
+
+        fwrite(line.data(), 1, at - line.data(), stdout);
+    }
+}
+
+// Parse hex bytes ("A9 00", "A900" or "0xA900")
+bool parse_hex(string str, string& out) {
+    string digits;
+
+    if (str.substr(0, 2) == "0x") str = str.substr(2);
+
+    for (char c : str) {
+        if (c == ' ' || c == ',') continue;
+        if (!isxdigit(c)) return false;
+
+        digits += c;
+    }
+
+    if (digits.empty() || digits.length() % 2) return false;
+
+    out.clear();
+
+    for (size_t i = 0; i < digits.length(); i += 2) {
+        out += (char)std::stoul(digits.substr(i, 2), nullptr, 16);
+    }
+
+    return true;
+}
+
+// Print the ranges where memory differs from an image loaded at 0x0000, returns the amount of differing bytes
+int diff_report(const string& name, const string& golden) {
+    const byte* other = (const byte*)golden.data();
+    int len = std::min((int)golden.length(), 0x10000);
+    int total = 0, ranges = 0;
+
+    printf("\nDifferences from \"%s\":\n", name.c_str());
+
+    for (int at = scan_compare(memory, other, 0, len, false); at < len; at = scan_compare(memory, other, at, len, false)) {
+        int end = scan_compare(memory, other, at, len, true);
+        int shown = std::min(end - at, 16);
+        char hex[3 * 16];
+
+        total += end - at;
+        ranges++;
+
+        printf("  %04X-%04X (%d bytes)\n", at, end - 1, end - at);
+
+        dump_hex(&memory[at], shown, hex);
+        printf("    memory  %.*s%s\n", 3 * shown - 1, hex, end - at > shown ? " ..." : "");
+
+        dump_hex(&other[at], shown, hex);
+        printf("    golden  %.*s%s\n", 3 * shown - 1, hex, end - at > shown ? " ..." : "");
+
+        at = end;
+    }
+
+    if (golden.length() != 0x10000) printf("  (the image covers %04X-%04X only)\n", 0, len - 1);
+
+    printf("  %d bytes differ in %d ranges.\n", total, ranges);
+
+    return total;
+}
+
+// Print every address the bytes are found at
+void find_report(const string& pat) {
+    const byte* bytes = (const byte*)pat.data();
+    int count = 0;
+
+    printf("\nFound");
+
+    for (int at = scan_find(memory, 0x10000, bytes, pat.length(), 0); at < 0x10000; at = scan_find(memory, 0x10000, bytes, pat.length(), at + 1)) {
+        printf(count % 16 ? " %04X" : "\n  %04X", at);
+        count++;
+    }
+
+    printf("%s%d matches.\n", count ? "\n  " : " ", count);
+}
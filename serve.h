@@ -0,0 +1,337 @@
+#include <vector>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+/* serve.h
+  Contains the job server (--serve), which keeps pre-forked worker processes waiting on a Unix socket.
+  Every message is a frame of a type byte, a 32 bit length then the payload (all numbers little endian). Frames
+  sent to the server are at most SERVE_FRAME_MAX bytes, a longer one gets an 'E' reply and the connection is closed.
+
+  Job ('J'), any number per connection:
+    u8 flags (1 image is a file path, 2 enable the printing address, 4 continue on BRK, 8 start at entry instead of the reset vector)
+    u16 load address, u16 entry, u16 printing address
+    u64 max instructions, u64 max cycles, u32 timeout in ms (0 for none, the server's own limits apply first)
+    u16 dump start, u32 dump length (memory returned once stopped)
+    then the image bytes (or path) up to the end of the frame
+  Replies:
+    'O' output from the printing address, sent as it builds up
+    'R' u8 stop reason (exit code), u8 a, x, y, sp, sr, u16 pc, u64 cycles, u64 instructions, then the dumped memory
+    'E' error message, the job didn't run
+*/
+
+int serve_workers = 0; // 0 for one per hardware thread
+
+// Server wide limits, jobs can only lower them
+unsigned long long serve_max_instructions = 0;
+unsigned long long serve_max_cycles = 0;
+double serve_max_seconds = 0;
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+
+// Flush the buffered output once it passes this size
+#define SERVE_CHUNK 0x1000
+
+// Largest payload taken from a client (a full 64 KiB image and the job fields, with room to spare)
+#define SERVE_FRAME_MAX 0x20000
+
+bool serve_read(int fd, void* data, size_t len) {
+    byte* at = (byte*)data;
+
+    while (len) {
+        ssize_t got = recv(fd, at, len, 0);
+
+        if (got <= 0) return false;
+
+        at += got;
+        len -= got;
+    }
+
+    return true;
+}
+
+bool serve_send(int fd, char type, const string& payload) {
+    string frame(5, type);
+    unsigned int len = payload.length();
+
+    memcpy(&frame[1], &len, 4);
+    frame += payload;
+
+    const char* at = frame.data();
+    size_t left = frame.length();
+
+    while (left) {
+        ssize_t sent = send(fd, at, left, MSG_NOSIGNAL);
+
+        if (sent <= 0) return false;
+
+        at += sent;
+        left -= sent;
+    }
+
+    return true;
+}
+
+template <typename T>
+T serve_field(const string& payload, size_t& at) {
+    T val = 0;
+
+    if (at + sizeof(T) <= payload.length()) memcpy(&val, &payload[at], sizeof(T));
+
+    at += sizeof(T);
+    return val;
+}
+
+template <typename T>
+void serve_put(string& out, T val) {
+    out.append((const char*)&val, sizeof(T));
+}
+
+// Lower limit of the two, where 0 means none
+template <typename T>
+T serve_limit(T server, T job) {
+    if (!server) return job;
+    if (!job) return server;
+
+    return std::min(server, job);
+}
+
+// Send the output so far
+bool serve_flush(int fd) {
+    if (endprint.empty()) return true;
+
+    bool sent = serve_send(fd, 'O', endprint);
+    endprint.clear();
+
+    return sent;
+}
+
+// Put the machine back to power on state (only the pages the last job wrote, see pool.h)
+void serve_reset() {
+    machine_reset();
+
+    instructions = 0;
+    stop_reason = STOP_BRK;
+    endprint.clear();
+}
+
+// Run the loaded job (without any of the debugging or pacing of the main loop)
+StopReason serve_run(int fd) {
+    budget_start();
+
+    while (!broken) {
+        byte2 at = pc;
+        byte opcode = memory[pc];
+        byte operands[2] = {memory[(byte2)(pc + 1)], memory[(byte2)(pc + 2)]};
+        byte mvbytes = instruction(opcode, operands);
+
+        cycles += op_cycles[opcode];
+
+        if (mvbytes == BRK_MOVE) {
+            pc = at;
+            return opcode == 0x00 ? STOP_BRK : STOP_HALT;
+        }
+
+        pc += mvbytes;
+
+        if (pc == at && stuck(opcode)) return STOP_HANG;
+
+        if (++instructions >= budget_next) {
+            if (endprint.length() >= SERVE_CHUNK && !serve_flush(fd)) return STOP_INTERRUPT;
+            if (!budget_check()) return stop_reason;
+        }
+    }
+
+    return STOP_INTERRUPT;
+}
+
+// Handle one job frame, returns false if the connection should be dropped
+bool serve_job(int fd, const string& payload) {
+    size_t at = 0;
+
+    byte flags = serve_field<byte>(payload, at);
+    byte2 load = serve_field<byte2>(payload, at);
+    byte2 entry = serve_field<byte2>(payload, at);
+    byte2 print = serve_field<byte2>(payload, at);
+    unsigned long long job_instructions = serve_field<unsigned long long>(payload, at);
+    unsigned long long job_cycles = serve_field<unsigned long long>(payload, at);
+    unsigned int job_ms = serve_field<unsigned int>(payload, at);
+    byte2 dump_start = serve_field<byte2>(payload, at);
+    unsigned int dump_len = serve_field<unsigned int>(payload, at);
+
+    if (at > payload.length()) return serve_send(fd, 'E', "Job frame too short.");
+
+    string image = payload.substr(at);
+
+    if (flags & 1) {
+        std::ifstream file(image, std::ios::binary);
+
+        if (!file.good()) return serve_send(fd, 'E', "File \"" + image + "\" not found.");
+
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+
+        image = buffer.str();
+    }
+
+    if (load + image.length() > 0x10000) return serve_send(fd, 'E', "The image goes past the maximum memory address (0xFFFF).");
+    if (dump_len > 0x10000u - dump_start) return serve_send(fd, 'E', "The dump goes past the maximum memory address (0xFFFF).");
+
+    serve_reset();
+    machine_write(load, image.data(), image.length());
+
+    print_ptr = &memory[print];
+    print_out = flags & 2;
+    brk_stop = flags & 4;
+    pc = flags & 8 ? entry : 0x100 * memory[0xFFFD] + memory[0xFFFC];
+
+    max_instructions = serve_limit(serve_max_instructions, job_instructions);
+    max_cycles = serve_limit(serve_max_cycles, job_cycles);
+    max_seconds = serve_limit(serve_max_seconds, job_ms / 1000.0);
+
+    StopReason reason = serve_run(fd);
+
+    if (!serve_flush(fd)) return false;
+
+    string result;
+
+    serve_put<byte>(result, reason);
+    serve_put<byte>(result, a);
+    serve_put<byte>(result, x);
+    serve_put<byte>(result, y);
+    serve_put<byte>(result, sp);
+    serve_put<byte>(result, sr.val());
+    serve_put<byte2>(result, pc);
+    serve_put<unsigned long long>(result, cycles);
+    serve_put<unsigned long long>(result, instructions);
+    result.append((const char*)&memory[dump_start], dump_len);
+
+    return serve_send(fd, 'R', result);
+}
+
+// Worker process, taking connections until interrupted
+void serve_worker(int listener) {
+    // Output is collected into endprint and sent back instead
+    ins_print = false;
+    mem_print = true;
+    budgeting = true;
+
+    // Keep the power on state to reset to, and touch the memory and code once so the first job doesn't pay for it
+    machine_snapshot();
+    serve_reset();
+
+    while (!broken) {
+        int fd = accept(listener, NULL, NULL);
+
+        if (fd < 0) continue;
+
+        char header[5];
+        unsigned int len;
+
+        while (!broken && serve_read(fd, header, 5)) {
+            memcpy(&len, &header[1], 4);
+
+            // The rest of the frame can't be skipped reliably, so the connection goes too
+            if (len > SERVE_FRAME_MAX) {
+                serve_send(fd, 'E', "Frame too long.");
+                break;
+            }
+
+            string payload(len, '\0');
+
+            if (!serve_read(fd, &payload[0], len)) break;
+
+            if (header[0] != 'J') {
+                if (!serve_send(fd, 'E', "Unknown frame type.")) break;
+
+                continue;
+            }
+
+            if (!serve_job(fd, payload)) break;
+        }
+
+        close(fd);
+    }
+
+    _exit(0);
+}
+
+// Start a worker, returns its pid (or -1 if it couldn't be started)
+pid_t serve_spawn(int listener) {
+    pid_t pid = fork();
+
+    if (pid == 0) serve_worker(listener);
+    if (pid < 0) printf("Unable to start a worker: %s.\n", strerror(errno));
+
+    return pid;
+}
+
+// Listen on a Unix socket path and keep the workers running until interrupted, returns the exit code
+int serve(string path) {
+    sockaddr_un addr = {};
+
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    unlink(path.c_str());
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (listener < 0 || bind(listener, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listener, 64) < 0) {
+        printf("Unable to listen on \"%s\".\n", path.c_str());
+        return 1;
+    }
+
+    serve_max_instructions = max_instructions;
+    serve_max_cycles = max_cycles;
+    serve_max_seconds = max_seconds;
+
+    int count = serve_workers ? serve_workers : std::max(1u, std::thread::hardware_concurrency());
+    std::vector<pid_t> workers;
+
+    for (int i = 0; i < count; i++) {
+        workers.push_back(serve_spawn(listener));
+    }
+
+    printf("Serving jobs on \"%s\" with %d workers.\n", path.c_str(), count);
+    fflush(stdout);
+
+    // Replace workers that die until interrupted (or none are left)
+    while (!broken) {
+        pid_t pid = wait(NULL);
+
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+
+            printf("No workers left.\n");
+            break;
+        }
+
+        if (broken) continue;
+
+        for (pid_t& worker : workers) {
+            if (worker == pid) worker = serve_spawn(listener);
+        }
+    }
+
+    for (pid_t worker : workers) {
+        if (worker > 0) kill(worker, SIGINT);
+    }
+
+    while (wait(NULL) > 0) {}
+
+    close(listener);
+    unlink(path.c_str());
+
+    return 0;
+}
+#else
+int serve(string path) {
+    printf("The job server is not supported on Windows.\n");
+    return 1;
+}
+#endif
@@ -0,0 +1,96 @@
+/* stats.h
+  Contains host-side counters for the emulator itself (build with -DHOST_STATS to enable).
+*/
+
+#ifdef HOST_STATS
+#include <chrono>
+
+// Addressing modes (or instruction shapes) used to dispatch
+enum StatMode {
+    S_IMPLIED, S_ACCUM, S_IMM, S_REL, S_ZP, S_ZP_X, S_ZP_Y, S_ABS, S_ABS_X, S_ABS_Y, S_IND, S_IND_X, S_IND_Y, S_ZP_IND, S_UNKNOWN, S_COUNT
+};
+
+const char* stat_names[S_COUNT] = {
+    "Implied", "Accum", "IMM", "Relative", "ZP", "ZP_X", "ZP_Y", "ABS", "ABS_X", "ABS_Y", "IND", "IND_X", "IND_Y", "ZP_IND", "Unknown"
+};
+
+unsigned long long stat_ins[S_COUNT] = {}; // Instructions dispatched per mode
+unsigned long long stat_mem[S_COUNT] = {}; // Memory bytes accessed per mode (including pointer fetches)
+
+unsigned long long stat_io_hits = 0;       // Stores to the printing address, and device register reads and writes
+unsigned long long stat_ram_stores = 0;    // Stores going straight to memory
+
+unsigned long long stat_out_direct = 0;    // Characters printed as they were stored
+unsigned long long stat_out_buffered = 0;  // Characters held back until the end
+
+unsigned long long stat_fused = 0;         // Instructions run straight after another (see fuse.h)
+
+unsigned long long stat_sleeps = 0;        // Pacing sleeps for -mf
+unsigned long long stat_behind = 0;        // Pacing checks that were already late
+long long stat_sleep_ns = 0;               // Time asked to sleep
+long long stat_slept_ns = 0;               // Time actually slept
+
+// Print a statistics line every stats_interval seconds (0 for none)
+double stats_interval = 0;
+unsigned long stat_tick = 0;
+std::chrono::steady_clock::time_point stat_begin = std::chrono::steady_clock::now();
+std::chrono::steady_clock::time_point stat_last = stat_begin;
+unsigned long long stat_last_ins = 0;
+
+#define STAT_MODE(mode, bytes) stat_ins[mode]++; stat_mem[mode] += bytes;
+#define STAT(x) x
+
+unsigned long long stat_total() {
+    unsigned long long total = 0;
+
+    for (int i = 0; i < S_COUNT; i++) {
+        total += stat_ins[i];
+    }
+
+    return total;
+}
+
+// Print the periodic line if the interval has passed (checked every 0x10000 instructions)
+void stats_line() {
+    if (++stat_tick & 0xFFFF) return;
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - stat_last).count();
+
+    if (elapsed < stats_interval) return;
+
+    unsigned long long total = stat_total();
+
+    fprintf(stderr, "[stats] %.3f Mins/s, %llu ins, %llu IO hits, %llu sleeps (%.3f ms over), %llu characters output\n",
+        (total - stat_last_ins) / elapsed / 1e6, total, stat_io_hits,
+        stat_sleeps, (stat_slept_ns - stat_sleep_ns) / 1e6, stat_out_direct + stat_out_buffered);
+
+    stat_last = now;
+    stat_last_ins = total;
+}
+
+void stats_report(unsigned long long cycles) {
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - stat_begin).count();
+    double paced = stat_slept_ns / 1e9;
+    unsigned long long total = stat_total();
+
+    printf("\nHost statistics: %llu instructions, %llu cycles in %.3f s (%.3f s pacing)\n", total, cycles, elapsed, paced);
+
+    if (total && elapsed > paced) {
+        printf("  %.2f ns/instruction, %.2f ns/cycle excluding pacing\n", 1e9 * (elapsed - paced) / total, 1e9 * (elapsed - paced) / cycles);
+    }
+
+    printf("\n  Mode            Instructions    Mem bytes\n");
+    for (int i = 0; i < S_COUNT; i++) {
+        if (stat_ins[i]) printf("    %-10s %15llu %12llu\n", stat_names[i], stat_ins[i], stat_mem[i]);
+    }
+
+    printf("\n  Fused: %llu instructions run straight after another\n", stat_fused);
+    printf("  IO: %llu hits (printing address stores, device register reads and writes), %llu stores to RAM\n", stat_io_hits, stat_ram_stores);
+    printf("  Output: %llu direct, %llu buffered\n", stat_out_direct, stat_out_buffered);
+    printf("  Pacing: %llu sleeps, %llu behind, %.3f ms asked, %.3f ms oversleep\n", stat_sleeps, stat_behind, stat_sleep_ns / 1e6, (stat_slept_ns - stat_sleep_ns) / 1e6);
+}
+#else
+#define STAT_MODE(mode, bytes)
+#define STAT(x)
+#endif
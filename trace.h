@@ -0,0 +1,528 @@
+#include <vector>
+#include <fstream>
+#include <algorithm>
+
+/* trace.h
+  Contains the compressed trace (-tr), a record of every instruction run that can be read from any instruction
+  (-ti). Each record holds only what changed: the registers that changed, the step the program counter took (the
+  instruction's length for most), the cycles if not the opcode's base cycles and the bytes written (found through
+  the addressing modes, pushes and DMA). The records are kept in chunks of -tc instructions, each starting
+  with a keyframe (every register and all of memory) and compressed on its own, so a chunk can be read without
+  any other. An index at the end of the file holds each chunk's first instruction, offset and the pages of the
+  instructions in it, so reading from instruction N unpacks one chunk, and filtering by address skips the chunks
+  that never ran there.
+
+  File: "TR65", version (32 bits), chunks, index, then the index offset and chunk count (64 bits each) and "TRIX".
+  Chunk: unpacked and packed size (32 bits each) and the packed bytes (see trace_pack).
+  Unpacked chunk: keyframe (first instruction and cycles (64 bits each), A, X, Y, SP, SR, PC (16 bits), memory),
+  then a record per instruction:
+
+    Flags: bits 0-4 A, X, Y, SP and SR changed (their values follow in that order), bits 5-6 the program counter
+      moved 1-3 bytes past the instruction (0: a zigzag varint of the move follows), bit 7 an extra byte follows:
+      bit 0 writes, bit 1 cycles (varint) and bit 2 the instruction isn't where the last one left the program
+      counter (its address follows)
+    Writes: a varint count of runs, each an address (16 bits), a varint length and the bytes
+
+  All numbers are little endian.
+*/
+
+string trace_file;                      // Written while running
+unsigned long long trace_chunk = 65536; // Instructions per chunk
+
+string trace_input;                     // Read instead of running
+unsigned long long trace_start = 0;     // First instruction printed
+unsigned long long trace_limit = 20;    // Instructions printed (0 for all)
+int trace_lo = 0, trace_hi = 0xFFFF;    // Addresses printed
+
+#define TRACE_VERSION 1
+
+struct TraceChunk {
+    unsigned long long first, count, offset;
+    byte pages[32];                     // Pages of the instructions run (a bit each)
+};
+
+std::ofstream trace_out;
+std::vector<TraceChunk> trace_chunks;
+TraceChunk trace_cur;
+string trace_buf;                       // Unpacked chunk being recorded
+
+byte trace_regs[5];                     // A, X, Y, SP and SR after the last instruction
+byte2 trace_pc;
+unsigned long long trace_cycles, trace_count = 0;
+
+std::vector<byte2> trace_writes;                      // Addresses written by the instruction
+std::vector<std::pair<byte2, int>> trace_bulk_writes; // Runs pushed or copied into memory during it
+
+void trace_put(string& out, unsigned long long val, int bytes) {
+    for (int i = 0; i < bytes; i++) out += (char)(val >> i * 8);
+}
+
+// Returns the bytes written (up to 10)
+int trace_varint(byte* out, unsigned long long val) {
+    int len = 0;
+
+    for (; val >= 0x80; val >>= 7) out[len++] = val | 0x80;
+    out[len++] = val;
+
+    return len;
+}
+
+void trace_varint(string& out, unsigned long long val) {
+    byte bytes[10];
+
+    out.append((const char*)bytes, trace_varint(bytes, val));
+}
+
+// A run of bytes written: address, length, then the bytes
+void trace_run(byte2 addr, int len) {
+    byte head[12] = {(byte)(addr & 0xFF), (byte)(addr >> 8)};
+
+    trace_buf.append((const char*)head, 2 + trace_varint(&head[2], len));
+    trace_buf.append((const char*)&memory[addr], len);
+}
+
+// Compress a chunk with a small LZ77 (the LZ4 block format): each token holds a count of literals and a match
+// length (15 meaning more follow in bytes up to 255), with the literals and the match's offset back between them.
+// As LZ4 requires, the last match starts at least 12 bytes before the end and the last 5 bytes are literals
+#define TRACE_MATCH_END 12
+#define TRACE_LAST_LITERALS 5
+
+string trace_pack(const string& in) {
+    string out;
+    std::vector<int> table(1 << 14, -1);
+    size_t lit = 0, i = 0;
+
+    auto put_len = [&out](size_t len) {
+        for (; len >= 255; len -= 255) out += (char)255;
+        out += (char)len;
+    };
+
+    auto put_token = [&](size_t literals, size_t match) {
+        out += (char)(std::min<size_t>(literals, 15) << 4 | std::min<size_t>(match, 15));
+
+        if (literals >= 15) put_len(literals - 15);
+
+        out.append(in, lit, literals);
+    };
+
+    size_t match_end = in.size() > TRACE_MATCH_END ? in.size() - TRACE_MATCH_END : 0;
+
+    while (i < match_end) {
+        uint32_t seq;
+        memcpy(&seq, &in[i], 4);
+
+        int& slot = table[(seq * 2654435761u) >> 18];
+        int cand = slot;
+
+        slot = i;
+
+        if (cand < 0 || i - cand > 0xFFFF || memcmp(&in[cand], &in[i], 4)) {
+            i++;
+            continue;
+        }
+
+        size_t len = 4;
+
+        while (i + len < in.size() - TRACE_LAST_LITERALS && in[cand + len] == in[i + len]) len++;
+
+        put_token(i - lit, len - 4);
+        out += (char)((i - cand) & 0xFF);
+        out += (char)((i - cand) >> 8);
+
+        if (len - 4 >= 15) put_len(len - 4 - 15);
+
+        i += len;
+        lit = i;
+    }
+
+    put_token(in.size() - lit, 0);
+
+    return out;
+}
+
+// Decompress a chunk, returns false if it is corrupt
+bool trace_unpack(const string& in, string& out, size_t size) {
+    size_t i = 0;
+
+    auto get_len = [&](size_t len) {
+        if (len < 15) return len;
+
+        while (i < in.size() && (byte)in[i] == 255) len += (byte)in[i++];
+
+        return i < in.size() ? len + (byte)in[i++] : ~(size_t)0;
+    };
+
+    out.clear();
+
+    while (i < in.size()) {
+        byte token = in[i++];
+        size_t literals = get_len(token >> 4);
+
+        if (literals > in.size() - i || out.size() + literals > size) return false;
+
+        out.append(in, i, literals);
+        i += literals;
+
+        if (i == in.size()) break;
+        if (i + 2 > in.size()) return false;
+
+        size_t offset = (byte)in[i] | (byte)in[i + 1] << 8;
+        i += 2;
+
+        size_t match = get_len(token & 0xF) + 4;
+
+        if (offset == 0 || offset > out.size() || out.size() + match > size) return false;
+
+        for (size_t from = out.size() - offset; match > 0; match--) out += out[from++];
+    }
+
+    return out.size() == size;
+}
+
+void trace_keyframe() {
+    trace_cur = {trace_count, 0, 0, {}};
+
+    trace_buf.clear();
+    trace_put(trace_buf, trace_count, 8);
+    trace_put(trace_buf, cycles, 8);
+    trace_buf += {(char)a, (char)x, (char)y, (char)sp, (char)sr.val()};
+    trace_put(trace_buf, pc, 2);
+    trace_buf.append((const char*)memory, 0x10000);
+
+    trace_regs[0] = a; trace_regs[1] = x; trace_regs[2] = y; trace_regs[3] = sp; trace_regs[4] = sr.val();
+    trace_pc = pc;
+    trace_cycles = cycles;
+}
+
+void trace_flush() {
+    string packed = trace_pack(trace_buf);
+
+    trace_cur.offset = trace_out.tellp();
+    trace_chunks.push_back(trace_cur);
+
+    string head;
+    trace_put(head, trace_buf.size(), 4);
+    trace_put(head, packed.size(), 4);
+
+    trace_out << head << packed;
+}
+
+// Open the file and take the first keyframe, returns false if it can't be written
+bool trace_open() {
+    trace_out.open(trace_file, std::ios::binary);
+
+    if (!trace_out) {
+        printf("Unable to write a trace to \"%s\".\n", trace_file.c_str());
+        return false;
+    }
+
+    string head = "TR65";
+    trace_put(head, TRACE_VERSION, 4);
+    trace_out << head;
+
+    tracing = watching = watchpoints = true;
+    trace_keyframe();
+
+    return true;
+}
+
+// Note a write made through an addressing mode (called from watch_check)
+void trace_access(byte2 addr, byte opcode) {
+    AccessKind kind = access_kind(opcode);
+
+    if (kind == ACCESS_WRITE || kind == ACCESS_MODIFY) trace_writes.push_back(addr);
+}
+
+// Note bytes copied into memory by a device (called from machine_write)
+void trace_bulk(byte2 addr, int len) {
+    trace_bulk_writes.push_back({addr, len});
+}
+
+// Note a push (called from push in ops.h), joining the run of the push before it
+void trace_push(byte offset) {
+    byte2 addr = 0x100 + offset;
+
+    if (!trace_bulk_writes.empty() && trace_bulk_writes.back().first == addr + 1) {
+        trace_bulk_writes.back().first = addr;
+        trace_bulk_writes.back().second++;
+    } else {
+        trace_bulk_writes.push_back({addr, 1});
+    }
+}
+
+// Record the instruction just run at at, with any interrupt taken after it
+void trace_step(byte2 at, byte opcode) {
+    byte regs[5] = {a, x, y, sp, sr.val()};
+    byte head[32];          // Flags, ext, then the fields before the writes
+    int len = 2;
+    byte flags = 0, ext = 0;
+
+    if (at != trace_pc) {
+        ext |= 0x04;
+        head[len++] = at & 0xFF;
+        head[len++] = at >> 8;
+    }
+
+    int move = (short)(byte2)(pc - at);
+
+    if (move >= 1 && move <= 3) {
+        flags |= move << 5;
+    } else {
+        len += trace_varint(&head[len], move < 0 ? -2 * move - 1 : 2 * move);
+    }
+
+    for (int i = 0; i < 5; i++) {
+        if (regs[i] == trace_regs[i]) continue;
+
+        flags |= 1 << i;
+        head[len++] = regs[i];
+    }
+
+    if (cycles - trace_cycles != op_cycles[opcode]) {
+        ext |= 0x02;
+        len += trace_varint(&head[len], cycles - trace_cycles);
+    }
+
+    size_t runs = trace_writes.size() + trace_bulk_writes.size();
+
+    if (runs) ext |= 0x01;
+
+    if (ext) {
+        head[0] = flags | 0x80;
+        head[1] = ext;
+        trace_buf.append((const char*)head, len);
+    } else {
+        head[1] = flags;
+        trace_buf.append((const char*)head + 1, len - 1);
+    }
+
+    // Writes through the addressing modes, then pushes and copies
+    if (runs) {
+        trace_varint(trace_buf, runs);
+
+        for (byte2 addr : trace_writes) trace_run(addr, 1);
+        for (std::pair<byte2, int>& run : trace_bulk_writes) trace_run(run.first, run.second);
+    }
+
+    trace_writes.clear();
+    trace_bulk_writes.clear();
+
+    memcpy(trace_regs, regs, 5);
+    trace_pc = pc;
+    trace_cycles = cycles;
+    trace_cur.pages[at >> 11] |= 1 << (at >> 8 & 7);
+    trace_cur.count++;
+
+    if (++trace_count % trace_chunk == 0) {
+        trace_flush();
+        trace_keyframe();
+    }
+}
+
+// Write the last chunk and the index
+void trace_finish() {
+    trace_flush();
+
+    unsigned long long index = trace_out.tellp();
+    string tail;
+
+    for (TraceChunk& chunk : trace_chunks) {
+        trace_put(tail, chunk.first, 8);
+        trace_put(tail, chunk.count, 8);
+        trace_put(tail, chunk.offset, 8);
+        tail.append((const char*)chunk.pages, 32);
+    }
+
+    trace_put(tail, index, 8);
+    trace_put(tail, trace_chunks.size(), 8);
+    tail += "TRIX";
+
+    trace_out << tail;
+    trace_out.close();
+}
+
+// Parse the address range to print ("0x0600" or "0x0600-0x06FF")
+bool trace_parse_range(string str) {
+    size_t dash = str.find('-');
+
+    if (!parse_num(str.substr(0, dash), trace_lo)) return false;
+
+    if (dash == string::npos) trace_hi = trace_lo;
+    else if (!parse_num(str.substr(dash + 1), trace_hi)) return false;
+
+    return trace_lo <= trace_hi && trace_hi <= 0xFFFF;
+}
+
+// Bytes of an unpacked chunk, read from the start
+struct TraceReader {
+    const string& data;
+    size_t at;
+
+    bool more() {
+        return at < data.size();
+    }
+
+    unsigned long long get(int bytes) {
+        unsigned long long val = 0;
+
+        for (int i = 0; i < bytes; i++) val |= (unsigned long long)(byte)(at < data.size() ? data[at++] : 0) << i * 8;
+
+        return val;
+    }
+
+    unsigned long long varint() {
+        unsigned long long val = 0;
+
+        for (int shift = 0; at < data.size() && shift < 64; shift += 7) {
+            byte part = data[at++];
+            val |= (unsigned long long)(part & 0x7F) << shift;
+
+            if (!(part & 0x80)) break;
+        }
+
+        return val;
+    }
+};
+
+bool trace_pages_hit(const TraceChunk& chunk) {
+    for (int page = trace_lo >> 8; page <= trace_hi >> 8; page++) {
+        if (chunk.pages[page >> 3] >> (page & 7) & 1) return true;
+    }
+
+    return false;
+}
+
+// Print the instructions of a trace asked for by -tn, -tl and -tp, returns the exit code
+int trace_main() {
+    std::ifstream in(trace_input, std::ios::binary);
+    char head[8] = {}, tail[20] = {};
+
+    in.read(head, 8);
+    in.seekg(0, std::ios::end);
+
+    unsigned long long size = in.tellg();
+
+    in.seekg(-20, std::ios::end);
+    in.read(tail, 20);
+
+    if (!in || memcmp(head, "TR65", 4) || memcmp(&tail[16], "TRIX", 4)) {
+        printf("\"%s\" isn't a trace, or wasn't finished.\n", trace_input.c_str());
+        return 1;
+    }
+
+    string trailer(tail, 16);
+    TraceReader end = {trailer, 0};
+    unsigned long long index = end.get(8), count = end.get(8);
+
+    // The index runs from its offset up to the trailer, 56 bytes a chunk
+    if (index < 8 || index > size - 20 || count != (size - 20 - index) / 56 || (size - 20 - index) % 56) {
+        printf("\"%s\" has a corrupt index.\n", trace_input.c_str());
+        return 1;
+    }
+
+    std::vector<TraceChunk> chunks(count);
+    string entries(count * 56, 0);
+
+    in.seekg(index);
+    in.read(&entries[0], entries.size());
+
+    TraceReader entry = {entries, 0};
+
+    for (TraceChunk& chunk : chunks) {
+        chunk.first = entry.get(8);
+        chunk.count = entry.get(8);
+        chunk.offset = entry.get(8);
+
+        for (byte& bits : chunk.pages) bits = entry.get(1);
+    }
+
+    // The chunk holding the first instruction asked for
+    size_t first = std::upper_bound(chunks.begin(), chunks.end(), trace_start, [](unsigned long long n, const TraceChunk& chunk) { return n < chunk.first; }) - chunks.begin();
+    unsigned long long printed = 0;
+    char text[DISASM_MAX];
+    string packed, data;
+
+    for (size_t c = first ? first - 1 : 0; c < chunks.size(); c++) {
+        if (!trace_pages_hit(chunks[c])) continue;
+
+        char sizes[8];
+
+        in.seekg(chunks[c].offset);
+        in.read(sizes, 8);
+
+        string size_bytes(sizes, 8);
+        TraceReader size = {size_bytes, 0};
+        unsigned long long unpacked = size.get(4);
+
+        packed.resize(size.get(4));
+        in.read(&packed[0], packed.size());
+
+        if (!in || !trace_unpack(packed, data, unpacked) || unpacked < 23 + 0x10000) {
+            printf("Chunk %zu of \"%s\" is corrupt.\n", c, trace_input.c_str());
+            return 1;
+        }
+
+        TraceReader rec = {data, 0};
+        unsigned long long n = rec.get(8);
+
+        cycles = rec.get(8);
+        a = rec.get(1); x = rec.get(1); y = rec.get(1); sp = rec.get(1); sr.set(rec.get(1));
+        pc = rec.get(2);
+        memcpy(memory, &data[rec.at], 0x10000);
+        rec.at += 0x10000;
+
+        for (; rec.more(); n++) {
+            byte flags = rec.get(1);
+            byte ext = flags & 0x80 ? rec.get(1) : 0;
+
+            if (ext & 0x04) pc = rec.get(2);
+
+            byte2 at = pc;
+            byte opcode = memory[at];
+
+            disasm(at, text); // Before this instruction's writes
+
+            if (flags & 0x60) {
+                pc = at + (flags >> 5 & 3);
+            } else {
+                unsigned long long move = rec.varint();
+                pc = at + (move & 1 ? -(int)(move / 2) - 1 : (int)(move / 2));
+            }
+
+            byte* regs[5] = {&a, &x, &y, &sp, NULL};
+
+            for (int i = 0; i < 5; i++) {
+                if (!(flags >> i & 1)) continue;
+
+                if (regs[i] != NULL) *regs[i] = rec.get(1);
+                else sr.set(rec.get(1));
+            }
+
+            cycles += ext & 0x02 ? rec.varint() : op_cycles[opcode];
+
+            if (ext & 0x01) {
+                for (unsigned long long runs = rec.varint(); runs > 0; runs--) {
+                    byte2 addr = rec.get(2);
+                    unsigned long long len = rec.varint();
+
+                    if (addr + len > 0x10000 || len > data.size() - rec.at) {
+                        printf("Chunk %zu of \"%s\" is corrupt.\n", c, trace_input.c_str());
+                        return 1;
+                    }
+
+                    memcpy(&memory[addr], &data[rec.at], len);
+                    rec.at += len;
+                }
+            }
+
+            if (n < trace_start || at < trace_lo || at > trace_hi) continue;
+
+            printf("%10llu  %04X %02X %-14s - A: %02X X: %02X Y: %02X S: %02X SR/NV-BDIZC: [%d%d%d%d%d%d%d%d] cycles=%llu\n",
+                n, at, opcode, text, a, x, y, sp, sr.n, sr.v, sr._, sr.b, sr.d, sr.i, sr.z, sr.c, cycles);
+
+            if (++printed == trace_limit) return 0;
+        }
+    }
+
+    return 0;
+}
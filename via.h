@@ -0,0 +1,285 @@
+/* via.h
+  Contains a 6522 VIA (-vi) with two 16 bit timers, a shift register and two ports, as registers 0-F repeated through
+  its range. Nothing ticks: each timer keeps the cycle it last held a known count, reads work the count out from the
+  cycle count, and the cycle it next runs out is its event (as is the shift register finishing), which sets the
+  interrupt flag and pulls the IRQ line if enabled. The port pins and CB2 are pulled up and nothing drives the
+  handshake lines, so only the timers and shift register set flags, and T2 has no pulses to count.
+*/
+
+int via_start = -1, via_end;  // Range (end exclusive)
+
+#define VIA_IRQ 0x01          // Bit in irq_sources
+
+enum ViaFlag { VIA_CA2 = 0x01, VIA_CA1 = 0x02, VIA_SR = 0x04, VIA_CB2 = 0x08, VIA_CB1 = 0x10, VIA_T2 = 0x20, VIA_T1 = 0x40 };
+
+// A counter that held value at cycle base, and next runs out at cycle next (~0 if it won't set its flag)
+struct ViaTimer {
+    unsigned long long base, next;
+    unsigned int value;
+    bool armed;               // Loaded and not yet run out (one-shot mode)
+};
+
+struct Via {
+    byte orb, ora, ddrb, ddra, acr, pcr, ifr, ier, shift;
+    byte t1_latch_lo, t1_latch_hi, t2_latch_lo;
+    ViaTimer t1, t2;
+    bool pb7;                 // PB7 level at t1.base (with T1 driving it)
+    unsigned long long shift_done;
+} via;
+
+// Parse "0x9000" (one set of registers) or a range they repeat through ("0x9000-0x90FF")
+bool via_parse(string arg) {
+    size_t dash = arg.find('-');
+    int start, end;
+
+    if (!parse_num(arg.substr(0, dash), start)) return false;
+
+    if (dash == string::npos) end = start + 0xF;
+    else if (!parse_num(arg.substr(dash + 1), end)) return false;
+
+    // The zero page and stack are used without going through the addressing modes
+    if (start < 0x200 || start > end || end > 0xFFFF || (end + 1 - start) % 0x10) return false;
+
+    via_start = start;
+    via_end = end + 1;
+
+    return true;
+}
+
+inline bool via_continuous() {
+    return via.acr & 0x40;
+}
+
+inline unsigned int via_t1_latch() {
+    return via.t1_latch_hi * 0x100 + via.t1_latch_lo;
+}
+
+// Counter at a cycle: it runs out one cycle after 0 (reading FFFF), then reloads from the latch when continuous
+unsigned int via_t1_count(unsigned long long now) {
+    unsigned long long elapsed = now - via.t1.base;
+
+    if (elapsed <= via.t1.value) return via.t1.value - elapsed;
+    if (!via_continuous()) return (via.t1.value - elapsed) & 0xFFFF;
+    if (elapsed == via.t1.value + 1) return 0xFFFF;
+
+    return (via_t1_latch() - (elapsed - via.t1.value - 2) % (via_t1_latch() + 2)) & 0xFFFF;
+}
+
+// Times T1 has run out since its base
+unsigned long long via_t1_timeouts(unsigned long long now) {
+    unsigned long long first = via.t1.base + via.t1.value + 1;
+
+    if (now < first) return 0;
+
+    return via_continuous() ? 1 + (now - first) / (via_t1_latch() + 2) : 1;
+}
+
+// Next time T1 runs out after a cycle
+unsigned long long via_t1_after(unsigned long long now) {
+    unsigned long long first = via.t1.base + via.t1.value + 1, period = via_t1_latch() + 2;
+
+    if (now < first) return first;
+
+    return via_continuous() ? first + ((now - first) / period + 1) * period : ~0ull;
+}
+
+bool via_pb7(unsigned long long now) {
+    return via_continuous() ? via.pb7 ^ (via_t1_timeouts(now) & 1) : via.pb7;
+}
+
+unsigned int via_t2_count(unsigned long long now) {
+    if (via.acr & 0x20) return via.t2.value; // Pulse counting
+
+    return (via.t2.value - (now - via.t2.base)) & 0xFFFF;
+}
+
+// Restart the counts from now, for a change of latch or mode
+void via_rebase(unsigned long long now) {
+    via.pb7 = via_pb7(now);
+    via.t1.value = via_t1_count(now);
+    via.t2.value = via_t2_count(now);
+    via.t1.base = via.t2.base = now;
+}
+
+void via_schedule(unsigned long long now) {
+    via.t1.next = !(via.ifr & VIA_T1) && (via_continuous() || via.t1.armed) ? via_t1_after(now) : ~0ull;
+    via.t2.next = !(via.ifr & VIA_T2) && !(via.acr & 0x20) && via.t2.armed ? via.t2.base + via.t2.value + 1 : ~0ull;
+}
+
+// Start shifting 8 bits, under T2 or the system clock (others wait on CB1, which nothing drives, or run free)
+void via_shift_start(unsigned long long now) {
+    int mode = via.acr >> 2 & 7;
+
+    via.ifr &= ~VIA_SR;
+
+    if (mode == 1 || mode == 5) via.shift_done = now + 8 * 2 * (via.t2_latch_lo + 2);
+    else if (mode == 2 || mode == 6) via.shift_done = now + 8 * 2;
+    else via.shift_done = ~0ull;
+}
+
+void via_irq() {
+    if (via.ifr & via.ier & 0x7F) irq_sources |= VIA_IRQ;
+    else irq_sources &= ~VIA_IRQ;
+}
+
+// Set the flags of whatever has happened by a cycle
+void via_update(unsigned long long now) {
+    if (via.t1.next <= now) {
+        via.ifr |= VIA_T1;
+        via.t1.next = ~0ull;
+
+        if (!via_continuous()) {
+            via.t1.armed = false;
+            via.pb7 = true;
+        }
+    }
+
+    if (via.t2.next <= now) {
+        via.ifr |= VIA_T2;
+        via.t2.next = ~0ull;
+        via.t2.armed = false;
+    }
+
+    if (via.shift_done <= now) {
+        via.ifr |= VIA_SR;
+        via.shift_done = ~0ull;
+
+        if (!(via.acr & 0x10)) via.shift = 0xFF; // Shifted in from CB2
+    }
+
+    via_irq();
+}
+
+void via_clear(byte flags, unsigned long long now) {
+    via.ifr &= ~flags;
+    via_schedule(now);
+}
+
+void via_read(byte2 addr) {
+    unsigned long long now = cycles;
+    byte val = 0;
+
+    via_update(now);
+
+    switch ((addr - via_start) & 0xF) {
+        case 0x0:
+            val = (via.orb & via.ddrb) | ~via.ddrb;
+            if (via.acr & 0x80) val = (val & 0x7F) | via_pb7(now) << 7;
+            break;
+
+        case 0x1: case 0xF: val = (via.ora & via.ddra) | ~via.ddra; break;
+        case 0x2: val = via.ddrb; break;
+        case 0x3: val = via.ddra; break;
+
+        case 0x4:
+            val = via_t1_count(now) & 0xFF;
+            via_clear(VIA_T1, now);
+            break;
+
+        case 0x5: val = via_t1_count(now) >> 8; break;
+        case 0x6: val = via.t1_latch_lo; break;
+        case 0x7: val = via.t1_latch_hi; break;
+
+        case 0x8:
+            val = via_t2_count(now) & 0xFF;
+            via_clear(VIA_T2, now);
+            break;
+
+        case 0x9: val = via_t2_count(now) >> 8; break;
+
+        case 0xA:
+            val = via.shift;
+            via_shift_start(now);
+            break;
+
+        case 0xB: val = via.acr; break;
+        case 0xC: val = via.pcr; break;
+        case 0xD: val = via.ifr | (via.ifr & via.ier & 0x7F ? 0x80 : 0); break;
+        case 0xE: val = via.ier | 0x80; break;
+    }
+
+    memory[addr] = val;
+    via_irq();
+}
+
+void via_write(byte2 addr, byte val) {
+    unsigned long long now = cycles;
+
+    via_update(now);
+
+    switch ((addr - via_start) & 0xF) {
+        case 0x0: via.orb = val; break;
+        case 0x1: case 0xF: via.ora = val; break;
+        case 0x2: via.ddrb = val; break;
+        case 0x3: via.ddra = val; break;
+
+        case 0x4: case 0x6:
+            via_rebase(now);
+            via.t1_latch_lo = val;
+            break;
+
+        case 0x5: // Load and start T1
+            via.t1_latch_hi = val;
+            via.t1 = {now, 0, via_t1_latch(), true};
+            via.pb7 = false;
+            via_clear(VIA_T1, now);
+            break;
+
+        case 0x7:
+            via_rebase(now);
+            via.t1_latch_hi = val;
+            via_clear(VIA_T1, now);
+            break;
+
+        case 0x8: via.t2_latch_lo = val; break;
+
+        case 0x9: // Load and start T2
+            via.t2 = {now, 0, via.t2_latch_lo + val * 0x100u, true};
+            via_clear(VIA_T2, now);
+            break;
+
+        case 0xA:
+            via.shift = val;
+            via_shift_start(now);
+            break;
+
+        case 0xB:
+            via_rebase(now);
+            via.acr = val;
+            via_schedule(now);
+            if (!(via.acr >> 2 & 3) || (via.acr >> 2 & 3) == 3) via.shift_done = ~0ull; // Not shifting on its own
+            break;
+
+        case 0xC: via.pcr = val; break;
+        case 0xD: via_clear(val & 0x7F, now); break;
+
+        case 0xE:
+            if (val & 0x80) via.ier |= val & 0x7F;
+            else via.ier &= ~val;
+            break;
+    }
+
+    via_irq();
+}
+
+// The counters change every cycle and reading them or the shift register clears flags or starts shifting
+bool via_stable(byte2 addr) {
+    switch ((addr - via_start) & 0xF) {
+        case 0x0: return !(via.acr & 0x80);
+        case 0x4: case 0x5: case 0x8: case 0x9: case 0xA: return false;
+        default: return true;
+    }
+}
+
+unsigned long long via_event() {
+    via_update(cycles);
+
+    return std::min({via.t1.next, via.t2.next, via.shift_done});
+}
+
+void via_attach() {
+    via = {};
+    via.t1.next = via.t2.next = via.shift_done = ~0ull;
+
+    io_attach({via_start, via_end, via_read, via_write, via_stable, via_event});
+}